@@ -0,0 +1,234 @@
+/*
+   OrionBenchmark.cpp - Microbenchmarks for the Orion WSPR Beacon hot functions
+
+   The "bench" serial monitor command runs each of the functions that dominate the CPU time of a transmit
+   cycle on the target, reporting the average number of processor cycles per call and the stack used by one call.
+   "bench save" stores the results in EEPROM as the baseline, after which "bench" flags any function that is more
+   than BENCH_THRESHOLD_PCT slower, or deeper, than the baseline. Flash size per function comes from the ELF file,
+   see tools/orion_flash_report.py. tools/host/orion_bench_host.cpp runs the same benchmarks on the host against a
+   committed baseline, as a regression test of the host build.
+
+   Timing uses micros() around a loop of calls, so interrupts (Timer0, the GPS serial port) are included in the
+   figures, as they are in flight. The stack measurement paints the stack below the current stack pointer with
+   STACK_CANARY and finds the deepest byte that was overwritten, so it includes any interrupt that happened
+   during the call. Run the benchmarks with the GPS disconnected for the most repeatable numbers.
+
+   This is only built when ORION_BENCHMARK_SUPPORTED is defined in OrionXConfig.h, it is not intended for flight.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+#include "OrionBoardConfig.h"
+#include "OrionBenchmark.h"
+
+#if defined (ORION_BENCHMARK_SUPPORTED)
+
+#include "OrionSi5351.h"
+#include "OrionTelemetry.h"
+#include "OrionPerfCounters.h"
+#include "OrionHal.h"
+
+// Results are written here so that the compiler can't optimize the calls away
+static volatile uint8_t bench_sink;
+
+static void bench_calc_msynth() {
+  uint8_t vals[8];
+
+  si5351bx_calc_msynth(1409701000ULL, vals);
+  bench_sink = vals[7];
+}
+
+// The calibration clock is normally off, so we can set its frequency without any effect on the RF output
+static void bench_setfreq() {
+  si5351bx_setfreq(SI5351A_CAL_CLK_NUM, 1409701000ULL, SI5351_CLK_OFF);
+}
+
+static void bench_encode_temperature() {
+  bench_sink = encode_temperature(-42);
+}
+
+static void bench_encode_voltage() {
+  bench_sink = encode_voltage(33);
+}
+
+static void bench_encode_altitude() {
+  bench_sink = encode_altitude(12345);
+}
+
+static void bench_encode_gridloc() {
+  bench_sink = encode_gridloc_char5_char6('D', 'G');
+}
+
+static void bench_read_voltage() {
+  bench_sink = read_voltage_v_x10();
+}
+
+const char bench_name_calc_msynth[] PROGMEM = "si5351bx_calc_msynth";
+const char bench_name_setfreq[] PROGMEM = "si5351bx_setfreq";
+const char bench_name_wspr_encode[] PROGMEM = "wspr_encode";
+const char bench_name_gridsquare[] PROGMEM = "calculate_gridsquare_6char";
+const char bench_name_encode_temperature[] PROGMEM = "encode_temperature";
+const char bench_name_encode_voltage[] PROGMEM = "encode_voltage";
+const char bench_name_encode_altitude[] PROGMEM = "encode_altitude";
+const char bench_name_encode_gridloc[] PROGMEM = "encode_gridloc_char5_char6";
+const char bench_name_read_voltage[] PROGMEM = "read_voltage_v_x10";
+const char bench_name_nmea_parse[] PROGMEM = "nmea_parse (GGA sentence)";
+
+const struct OrionBenchmark bench_table[] PROGMEM = {
+  {bench_name_calc_msynth,        bench_calc_msynth,        100},
+  {bench_name_setfreq,            bench_setfreq,            20},
+  {bench_name_wspr_encode,        bench_wspr_encode,        5},
+  {bench_name_gridsquare,         bench_gridsquare,         100},
+  {bench_name_encode_temperature, bench_encode_temperature, 1000},
+  {bench_name_encode_voltage,     bench_encode_voltage,     1000},
+  {bench_name_encode_altitude,    bench_encode_altitude,    1000},
+  {bench_name_encode_gridloc,     bench_encode_gridloc,     1000},
+  {bench_name_read_voltage,       bench_read_voltage,       20},
+  {bench_name_nmea_parse,         bench_nmea_parse,         20},
+};
+
+#define NUM_BENCHMARKS (sizeof(bench_table) / sizeof(bench_table[0]))
+
+uint8_t bench_count() {
+  return NUM_BENCHMARKS;
+}
+
+void bench_get(uint8_t index, struct OrionBenchmark *bench) {
+  memcpy_P(bench, &bench_table[index], sizeof(*bench));
+}
+
+struct OrionBenchResult {
+  uint32_t cycles;               // Processor cycles per call
+  uint16_t stack_bytes;          // Stack used by one call, including the return address
+};
+
+// The baseline saved in EEPROM by "bench save"
+struct OrionBenchBaseline {
+  uint16_t magic;                // BENCH_BASELINE_MAGIC
+  uint8_t count;                 // NUM_BENCHMARKS when the baseline was saved
+  struct OrionBenchResult results[NUM_BENCHMARKS];
+};
+
+static uint32_t bench_cycles_per_call(void (*fn)(), uint16_t iterations) {
+  unsigned long start_us;
+  unsigned long elapsed_us;
+
+  fn(); // Warm up, e.g. the first call of some functions does one time initialization
+
+  start_us = micros();
+  for (uint16_t i = 0; i < iterations; i++) fn();
+  elapsed_us = micros() - start_us;
+
+  return (elapsed_us * (F_CPU / 1000000UL)) / iterations;
+}
+
+static uint16_t bench_stack_bytes(void (*fn)()) {
+#if defined(__AVR__)
+  extern uint8_t _end;
+  extern char *__brkval;
+  uint8_t *sp = (uint8_t *)SP;
+  uint8_t *heap_end = (__brkval == 0) ? &_end : (uint8_t *)__brkval;
+  uint8_t *low;
+  uint8_t *p;
+
+  // Leave a little room above the heap in case the function under test calls malloc()
+  low = sp - BENCH_STACK_PAINT_BYTES;
+  if (low < heap_end + 16) low = heap_end + 16;
+
+  for (p = low; p < sp; p++) *p = STACK_CANARY;
+
+  fn();
+
+  for (p = low; (p < sp) && (*p == STACK_CANARY); p++);
+  return (uint16_t)(sp - p);
+#else
+  fn();
+  return 0;
+#endif
+}
+
+// True if result is more than BENCH_THRESHOLD_PCT worse than baseline
+static bool bench_exceeds(uint32_t result, uint32_t baseline) {
+  return (result * 100UL) > (baseline * (100UL + BENCH_THRESHOLD_PCT));
+}
+
+bool bench_run_all(Print &port, bool save_baseline) {
+  struct OrionBenchmark bench;
+  struct OrionBenchResult result;
+  struct OrionBenchResult base;
+  struct OrionBenchBaseline hdr;
+  bool have_baseline;
+  bool failed;
+  bool all_passed = true;
+  char name[32];
+
+  hal_eeprom_read(EEPROM_BENCH_ADDR, &hdr, offsetof(struct OrionBenchBaseline, results));
+  have_baseline = (hdr.magic == BENCH_BASELINE_MAGIC) && (hdr.count == NUM_BENCHMARKS) && !save_baseline;
+
+  port.println(F("function                      cycles/call  stack  baseline cycles/stack"));
+
+  for (byte i = 0; i < NUM_BENCHMARKS; i++) {
+    bench_get(i, &bench);
+    strncpy_P(name, bench.name, sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+
+    result.cycles = bench_cycles_per_call(bench.fn, bench.iterations);
+    result.stack_bytes = bench_stack_bytes(bench.fn);
+
+    port.print(name);
+    for (byte pad = strlen(name); pad < 30; pad++) port.print(' ');
+    port.print(result.cycles);
+    port.print(F("  "));
+    port.print(result.stack_bytes);
+
+    if (save_baseline) {
+      hal_eeprom_update(EEPROM_BENCH_ADDR + offsetof(struct OrionBenchBaseline, results) + (i * sizeof(result)),
+                        &result, sizeof(result));
+    }
+    else if (have_baseline) {
+      hal_eeprom_read(EEPROM_BENCH_ADDR + offsetof(struct OrionBenchBaseline, results) + (i * sizeof(base)),
+                      &base, sizeof(base));
+      failed = bench_exceeds(result.cycles, base.cycles) || bench_exceeds(result.stack_bytes, base.stack_bytes);
+      if (failed) all_passed = false;
+
+      port.print(F("  "));
+      port.print(base.cycles);
+      port.print('/');
+      port.print(base.stack_bytes);
+      if (failed) port.print(F("  FAIL"));
+    }
+    port.println();
+  }
+
+  if (save_baseline) {
+    hdr.magic = BENCH_BASELINE_MAGIC;
+    hdr.count = NUM_BENCHMARKS;
+    hal_eeprom_update(EEPROM_BENCH_ADDR, &hdr, offsetof(struct OrionBenchBaseline, results));
+    port.println(F("Baseline saved to EEPROM"));
+  }
+  else if (!have_baseline) {
+    port.println(F("No baseline saved, use bench save"));
+  }
+  else {
+    port.print(F("Threshold "));
+    port.print(BENCH_THRESHOLD_PCT);
+    port.println(all_passed ? F("% : PASS") : F("% : FAIL"));
+  }
+
+  return all_passed;
+}
+
+#endif // ORION_BENCHMARK_SUPPORTED
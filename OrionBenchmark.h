@@ -0,0 +1,55 @@
+#ifndef ORIONBENCHMARK_H
+#define ORIONBENCHMARK_H
+/*
+    OrionBenchmark.h - Definitions for the Orion microbenchmarks
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+
+#if defined (ORION_BENCHMARK_SUPPORTED)
+
+// The baseline saved by "bench save" follows the runtime parameters in EEPROM (see OrionParameters.h)
+#define EEPROM_BENCH_ADDR        128
+#define BENCH_BASELINE_MAGIC     0x4F42U     // "OB"
+
+// A benchmark fails if it takes more than this percentage longer, or uses more stack, than the saved baseline
+#define BENCH_THRESHOLD_PCT      10
+
+// Stack below the current stack pointer that is painted before each stack measurement
+#define BENCH_STACK_PAINT_BYTES  384
+
+struct OrionBenchmark {
+  const char *name;              // In PROGMEM
+  void (*fn)();
+  uint16_t iterations;           // Calls per timing run, enough for the run to take tens of milliseconds
+};
+
+// Run every benchmark and print the results, returns false if any of them exceeded the baseline threshold
+bool bench_run_all(Print &port, bool save_baseline);
+
+// The benchmarks, for the host benchmark (tools/host/orion_bench_host.cpp) to run the same ones
+uint8_t bench_count();
+void bench_get(uint8_t index, struct OrionBenchmark *bench);
+
+// Benchmark bodies defined in OrionWspr.ino, because they use objects that belong to the sketch
+void bench_wspr_encode();
+void bench_gridsquare();
+void bench_nmea_parse();
+
+#endif // ORION_BENCHMARK_SUPPORTED
+
+#endif
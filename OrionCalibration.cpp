@@ -16,6 +16,14 @@
    After each 10 second sample a frequency correction factor is applied using a Huff&Puff algorithm.
    Each calibration cycle samples and corrects for 24 iterations so takes approximately 4 minutes.
 
+   With SI5351_CAL_ON_TX_PATH defined in the board config the TX multisynth itself is calibrated, at the fixfreq frequency,
+   and the CAL clock output divides it by a power of two with its R divider so that Timer1 can count it
+   (e.g. 14.097 Mhz / 8 = 1.762 Mhz). This removes any difference between the CAL and TX outputs from the correction.
+
+   With the txmon parameter on, Timer1 also counts the calibration clock while a WSPR message is sent (the symbols are timed
+   by Timer2) and the correction is updated after each 10 second gate, so the frequency keeps following the crystal through
+   the whole transmission. See tx_monitor_start().
+
    Copyright 2019 Michael Babineau, VE3WMB <mbabineau.ve3wmb@gmail.com>
 
 
@@ -35,6 +43,10 @@
 #include "OrionSi5351.h"
 #include "OrionCalibration.h"
 #include "OrionSerialMonitor.h"
+#include "OrionPerfCounters.h"
+#include "OrionHal.h"
+#include "OrionParameters.h"
+#include "OrionOscModel.h"
 #include <Chrono.h>
 
 
@@ -49,6 +61,49 @@ volatile unsigned int gpsPPScounter = 0;
 volatile bool g_calibration_proceed = false;
 volatile bool is_PPS_rising_edge = false;
 
+// TX frequency monitor
+volatile bool g_tx_monitor_on = false;
+volatile bool tx_monitor_gate_done = false;
+volatile uint32_t tx_monitor_gate_start;  // Calibration clock count at the PPS that opened the current gate
+volatile uint32_t tx_monitor_gate_count;  // Calibration clock count over the last 10 second gate
+uint8_t tx_monitor_gates;                 // Gates completed during this transmission
+uint8_t tx_monitor_corrections;           // Correction factor changes during this transmission
+
+#if defined (SI5351_CAL_ON_TX_PATH)
+#if (SI5351A_CAL_CLK_NUM != SI5351A_WSPRTX_CLK_NUM) && (SI5351A_WSPRTX_CLK_NUM != 0)
+#error "SI5351_CAL_ON_TX_PATH routes multisynth 0 to the CAL clock, so SI5351A_WSPRTX_CLK_NUM must be 0"
+#endif
+uint64_t cal_ms_freq;  // TX multisynth frequency during calibration, hundredths of Hz
+uint8_t cal_rdiv;      // The CAL clock output is cal_ms_freq / 2**cal_rdiv, which is target_freq
+
+// Pick the smallest R divider that brings fixfreq below SI5351_CAL_TARGET_FREQ. target_freq is rounded down to a whole
+// number of 0.1 Hz (the resolution of a 10 second count) and the TX multisynth runs at exactly 2**cal_rdiv times that.
+static void set_calibration_target() {
+  uint64_t max_freq = SI5351_CAL_TARGET_FREQ
+  uint64_t freq = g_params.fixed_beacon_freq_hz * 100ULL;
+
+  cal_rdiv = 0;
+  while ((freq >> cal_rdiv) > max_freq) cal_rdiv++;
+  target_freq = ((freq >> cal_rdiv) / 10ULL) * 10ULL;
+  cal_ms_freq = target_freq << cal_rdiv;
+}
+#endif
+
+// Start the Calibration clock on target_freq, or restart it after a change of correction factor
+static void start_calibration_clock() {
+#if defined (SI5351_CAL_ON_TX_PATH) && (SI5351A_CAL_CLK_NUM == SI5351A_WSPRTX_CLK_NUM)
+  si5351bx_rdiv = cal_rdiv; // No spare output, the TX output itself is divided down and fed back to D5
+  si5351bx_setfreq(SI5351A_WSPRTX_CLK_NUM, cal_ms_freq, SI5351_CLK_ON);
+  si5351bx_rdiv = 0;
+#elif defined (SI5351_CAL_ON_TX_PATH)
+  static_assert((SI5351A_CAL_CLK_NUM == 1) || (SI5351A_CAL_CLK_NUM == 2), "SI5351A_CAL_CLK_NUM must be CLK1 or CLK2");
+  si5351bx_setfreq(SI5351A_WSPRTX_CLK_NUM, cal_ms_freq, SI5351_CLK_OFF); // The TX output stays off, only its multisynth runs
+  si5351bx_clk_from_ms0(SI5351A_CAL_CLK_NUM, cal_rdiv, SI5351_CLK_ON);
+#else
+  si5351bx_setfreq(SI5351A_CAL_CLK_NUM, target_freq, SI5351_CLK_ON);
+#endif
+}
+
 // Timer1 is our counter
 // 16-bit counter overflows after 65536 counts
 // overflowCounter will keep track of how many times we overflow
@@ -58,6 +113,33 @@ volatile bool is_PPS_rising_edge = false;
 ISR(TIMER1_OVF_vect) // Interrupt handler for Timer1 overflow. This is invoked when TCNT1 overflows and TOV1 is set.
 {
   overflowCounter++;
+  g_isr_counts.timer1_ovf++;
+}
+
+// PPS handling while the TX frequency monitor is on. Timer1 is never cleared as that would lose counts, the count is
+// taken on the fly at each PPS and a gate is the difference between two counts ten seconds apart.
+static inline void tx_monitor_pps() {
+  uint16_t count = hal_timer1_read();
+  uint16_t overflows = overflowCounter;
+  uint32_t total;
+
+  // Timer1 may have overflowed since this ISR started, before ISR(TIMER1_OVF_vect) can run. If the count we read is
+  // small the overflow came before it and has to be included.
+  if (hal_timer1_overflow_pending() && (count < 0x8000)) overflows++;
+  total = ((uint32_t)overflows << 16) | count;  // Wraps around, but the difference over a gate is still right
+
+  gpsPPScounter++;
+  if (gpsPPScounter == 1) {
+    tx_monitor_gate_start = total;
+    HAL_PROBE_HIGH(PROBE_BIT_CAL); // Counting gate open
+  }
+  else if (gpsPPScounter == 11) {
+    tx_monitor_gate_count = total - tx_monitor_gate_start;
+    tx_monitor_gate_start = total; // The next gate starts here
+    tx_monitor_gate_done = true;
+    gpsPPScounter = 1;
+    HAL_PROBE_TOGGLE(PROBE_BIT_CAL);
+  }
 }
 
 // Conditional compilation for GPS PPS interrupt handler
@@ -65,19 +147,27 @@ ISR(TIMER1_OVF_vect) // Interrupt handler for Timer1 overflow. This is invoked w
 // Interrupt Handler for GPS PPS signal using External Interrupts on D2 or D3
 void PPSinterruptISR()
 {
+  g_isr_counts.pps++;
+
+  if (g_tx_monitor_on) {
+    tx_monitor_pps();
+    return;
+  }
+
   gpsPPScounter++;
 
   if (gpsPPScounter == 1 ) {
     // First PPS pulse received after interrupt enabled
     // enable Frequency counting
-    TCNT1  = 0; // Initialize Timer1 counter to 0.
-    TIFR1 = (1 << TOV1); //Clear overlow flag in case it is set
+    hal_timer1_clear(); // Initialize Timer1 counter to 0 and clear the overflow flag in case it is set
     overflowCounter = 0;
+    HAL_PROBE_HIGH(PROBE_BIT_CAL); // Counting gate open
   }
 
   if (gpsPPScounter == 11) { // Ten seconds of counting
-    EIMSK = (0 << INT0); // Disable GPS PPS external interrupt (INT1 on PIN D3)- CHANGE THIS to "INT0" IF USING PIN D2
-    TCCR1B = 0; // Disable Timer1 Counter
+    hal_pps_irq_enable(false); // Disable GPS PPS external interrupt
+    hal_timer1_stop(); // Disable Timer1 Counter
+    HAL_PROBE_LOW(PROBE_BIT_CAL); // Counting gate closed
 
     // We have completed 10 seconds of sampling, this triggers the frequency calculation on RTI
     g_calibration_proceed = true;
@@ -104,19 +194,27 @@ ISR (PCINT1_vect) // handle pin change interrupt for A0 to A5 here. This will ne
 
   if (is_PPS_rising_edge == true ) {
 
+    g_isr_counts.pps++;
+
+    if (g_tx_monitor_on) {
+      tx_monitor_pps();
+      return;
+    }
+
     gpsPPScounter++;
 
     if (gpsPPScounter == 1 ) {
       // First PPS pulse received after interrupt enabled
       // enable Frequency counting
-      TCNT1  = 0; // Initialize Timer1 counter to 0.
-      TIFR1 = (1 << TOV1); //Clear TImer1 overlow flag in case it is set
+      hal_timer1_clear(); // Initialize Timer1 counter to 0 and clear the overflow flag in case it is set
       overflowCounter = 0;
+      HAL_PROBE_HIGH(PROBE_BIT_CAL); // Counting gate open
     }
 
     if (gpsPPScounter == 11) { // Ten seconds of counting
-      PCMSK1 = (0 << PCINT13); // Disable PinChangeInterrupts (GPS PPS interrupt PCINT13 on A5)
-      TCCR1B = 0; // Disable Timer1 Counter
+      hal_pps_irq_enable(false); // Disable PinChangeInterrupts (GPS PPS interrupt PCINT13 on A5)
+      hal_timer1_stop(); // Disable Timer1 Counter
+      HAL_PROBE_LOW(PROBE_BIT_CAL); // Counting gate closed
       is_PPS_rising_edge = false;
 
       // We have completed 10 seconds of sampling, this triggers the frequency calculation on RTI
@@ -130,6 +228,15 @@ ISR (PCINT1_vect) // handle pin change interrupt for A0 to A5 here. This will ne
 
 
 // This resets the Timer1 interrupt
+// Replace the current correction factor, e.g. from the saved parameters at boot or a "set corr" command.
+// Self-calibration continues from this value.
+void set_calibration_correction(int32_t corr) {
+  old_cal_factor = corr;
+  cal_factor = corr;
+  si5351bx_set_correction(corr);
+  osc_model_reset(corr);
+}
+
 void reset_for_calibration()
 {
 
@@ -140,55 +247,32 @@ void reset_for_calibration()
   noInterrupts();
   // Select Normal mode, TCNT1 increments to a max of 0XFFFF, overflows to zero and sets TOV1 (Timer1 overflow flag)
   // Note that the TOV1 flag is automatically reset to 0 by the Timer1 ISR
-  TCCR1A = 0;
-
-  TCNT1  = 0; // Initialize Timer1 counter to 0.
+  hal_timer1_clear(); // Initialize Timer1 counter to 0.
 
-  // TCCR1B CS12 =1, CS11=1, CS10=1 means select external clock source on T1 PIN (D5), trigger on rising edge
-  // of Si5351 Calibration CLK signal
-  TCCR1B = (1 << CS12) | (1 << CS11) | (1 << CS10);
-
-  // Enable Timer1 overflow interrupt - will jump into ISR(TIMER1_OVF_vect) when TOV1 is set
-  TIMSK1 = (1 << TOIE1); // Enable Timer1 Overflow Interrupt for now
+  // Count the Si5351 Calibration CLK signal on the T1 PIN (D5), rising edge, with the overflow interrupt
+  // enabled - will jump into ISR(TIMER1_OVF_vect) when TOV1 is set
+  hal_timer1_start_counter();
   interrupts();
 
   // Turn off the PARK clock
-  si5351bx_enable_clk(SI5351A_PARK_CLK_NUM, SI5351_CLK_OFF);
+  si5351bx_park(SI5351_CLK_OFF);
 
   // Start Calibration clock on target frequency
-  si5351bx_setfreq(SI5351A_CAL_CLK_NUM, target_freq, SI5351_CLK_ON);
+#if defined (SI5351_CAL_ON_TX_PATH)
+  set_calibration_target();
+#endif
+  start_calibration_clock();
 }
 
-// This initializes both of the Interrupts needed for self-calibration.
-void setup_calibration()
+// Attach the GPS PPS interrupt handler, leaving the interrupt disabled until a calibration (or the TX frequency monitor)
+// enables it. Also used to resume after a reset without a startup calibration, see OrionCheckpoint.cpp.
+void setup_pps_interrupt()
 {
-
-  // Timer1 Interrupt
-  // Timer1 (16 bits) is setup as a frequency counter to sample the Calibration clock
-  // Maximum frequency is Fclk_io/2 as sampled pulse duration must be larger than processor clock period(recommended to be < Fclk_io/2.5)
-  // Fclk_io is 8 MHz so we are using 3.2 Mhz as the calibration frequency for CAL_CLOCK_NUM
-  noInterrupts();
-  // Select Normal mode, TCNT1 increments to a max of 0XFFFF, overflows to zero and sets TOV1 (Timer1 overflow flag)
-  // Note that the TOV1 flag is automatically reset to 0 by the Timer1 ISR
-  TCCR1A = 0;
-
-  TCNT1  = 0; // Initialize Timer1 counter to 0.
-
-  // TCCR1B CS12 =1, CS11=1, CS10=1 means select external clock source on T1 PIN (D5), trigger on rising edge
-  // of Si5351 Calibration CLK signal
-  TCCR1B = (1 << CS12) | (1 << CS11) | (1 << CS10);
-
-  // Enable Timer1 overflow interrupt - will jump into ISR(TIMER1_OVF_vect) when TOV1 is set
-  TIMSK1 = (1 << TOIE1); // Enable Timer1 Overflow Interrupt
-  interrupts();
-
 #if defined (GPS_PPS_ON_D2_OR_D3)
   // Set 1PPS pin D2 or D3 for external interrupt input
   attachInterrupt(digitalPinToInterrupt(GPS_PPS_PIN), PPSinterruptISR, RISING);
 
-  noInterrupts();
-  EIMSK = (0 << INT0); // Disable GPS PPS external interupt (INT0 on PIN D2) - CHANGE THIS TO "INT1" IF USING PIN D3
-  interrupts();
+  hal_pps_irq_setup(); // Leave the GPS PPS external interupt disabled until we need it
 #else
   // We are using PIN Change Interrupts. This will require reconfiguration if using other than Atmega PIN A5 to connect to the GPS PPS PIN
   /* Atmega328p Pin to PinChange Interrupt Register Mappings
@@ -213,26 +297,49 @@ void setup_calibration()
     A4    PCINT12 (PCMSK1 / PCIF1 / PCIE1)
     A5    PCINT13 (PCMSK1 / PCIF1 / PCIE1)
   */
-  noInterrupts();
   // We are using A5 for GPS_PPS_PIN so PCINT13 (PCMSK1 / PCIF1 / PCIE1)
-  PCICR |= (1 << PCIE1);    // [Pin Change Interrupt Control Register] - Enable PinchangeInterrupts for Port C (A5), without disabling PCIE0 or PCIE2
-  PCIFR  = (1 << PCIF1);   // [Pin Change Interrupt Flag Register] clear any outstanding interrupts. Counterintuitively writing a 1 clears the flag
-  PCMSK1 = (0 << PCINT13); // [Pin Change Mask Register 1] Disable Interrupts for PCINT13 aka PIN A5.
+  hal_pps_irq_setup(); // Enable PinchangeInterrupts for Port C (A5) but leave PCINT13 masked until we need it
   is_PPS_rising_edge = false; // Reset our toggle so we can mimic triggering only on rising edge
-  interrupts();
 #endif
+}
+
+// This initializes both of the Interrupts needed for self-calibration.
+void setup_calibration()
+{
+
+  // Timer1 Interrupt
+  // Timer1 (16 bits) is setup as a frequency counter to sample the Calibration clock
+  // Maximum frequency is Fclk_io/2 as sampled pulse duration must be larger than processor clock period(recommended to be < Fclk_io/2.5)
+  // Fclk_io is 8 MHz so we are using 3.2 Mhz as the calibration frequency for CAL_CLOCK_NUM
+  noInterrupts();
+  // Select Normal mode, TCNT1 increments to a max of 0XFFFF, overflows to zero and sets TOV1 (Timer1 overflow flag)
+  // Note that the TOV1 flag is automatically reset to 0 by the Timer1 ISR
+  hal_timer1_clear(); // Initialize Timer1 counter to 0.
+
+  // Count the Si5351 Calibration CLK signal on the T1 PIN (D5), rising edge, with the overflow interrupt
+  // enabled - will jump into ISR(TIMER1_OVF_vect) when TOV1 is set
+  hal_timer1_start_counter();
+  interrupts();
+
+  setup_pps_interrupt();
 
 
   // Turn off the PARK clock
-  si5351bx_enable_clk(SI5351A_PARK_CLK_NUM, SI5351_CLK_OFF);
+  si5351bx_park(SI5351_CLK_OFF);
 
   // Start Calibration clock on target frequency
-  si5351bx_setfreq(SI5351A_CAL_CLK_NUM, target_freq, SI5351_CLK_ON);
+#if defined (SI5351_CAL_ON_TX_PATH)
+  set_calibration_target();
+#endif
+  start_calibration_clock();
 }
 
 OrionCalibrationResult do_calibration(unsigned long calibration_step, uint64_t calibration_timeout) {
   byte i;
-  int timer_counter1 = 0;
+  uint16_t timer_counter1 = 0; // TCNT1 is 16 bits unsigned, a signed int would go negative above 32767 counts
+  uint32_t gate_res_ppb = 10000000000ULL / target_freq; // One count in 10 seconds, in ppb of the calibration frequency
+  uint64_t max_gate_error = (target_freq / 1000000ULL) * CALIBRATION_MAX_GATE_ERROR_PPM;
+  bool gate_ok;
   Chrono calibration_guard_tmr;
   OrionCalibrationResult calibration_result = PASS; // Assume it is going to pass by default
 
@@ -252,24 +359,20 @@ OrionCalibrationResult do_calibration(unsigned long calibration_step, uint64_t c
     gpsPPScounter = 0;
     overflowCounter = 0;
 
-#if defined (GPS_PPS_ON_D2_OR_D3)
-    // Using External Interrupt on PIN D2 or D3 for GPS PPS
-    EIMSK = (1 << INT0); // Enable GPS PPS external interupt (INT0 on PIN D2) - CHANGE THIS TO "INT1" if using PIN D3
-#else
-    // Using PinChange Interrupts on Pins other than D2 or D3
-    PCIFR  = (1 << PCIF1);   // [Pin Change Interrupt Flag Register] clear any outstanding interrupts, counterintuitively writing a 1 clears the flag
-    PCMSK1 = (1 << PCINT13); // [Pin Change Mask Register 1] Enable Interrupts for PCINT13 on PIN A5
+    // Using External Interrupt on PIN D2 or D3, or PinChange Interrupts on Pins other than D2 or D3 for GPS PPS
+    hal_pps_irq_enable(true);
+#if !defined (GPS_PPS_ON_D2_OR_D3)
     is_PPS_rising_edge = false; // Reset our flag so we can mimic external interrupts triggering on rising edge
 #endif
 
     // Start counter
-    TCCR1B = (1 << CS12) | (1 << CS11) | (1 << CS10);
-    TIMSK1 = (1 << TOIE1); // Enable Timer1 Overflow Interrupt
+    hal_timer1_start_counter();
     interrupts();
 
     // LOOP in place here until the proceed flag is set by PPSinterruptISR after 10 seconds of sampling
     // or the guard timer value is exceeded, indictating a GPS LOS scenario
     while (!g_calibration_proceed) {
+      hal_spin();
 
       if (calibration_guard_tmr.hasPassed(calibration_timeout, false) == true) {
         calibration_result = FAIL_PPS; // We timed out so calibration failed due no PPS detected.
@@ -288,7 +391,7 @@ OrionCalibrationResult do_calibration(unsigned long calibration_step, uint64_t c
 
     // Done the 10 seconds of sampling, take the count and calculate the frequency.
     noInterrupts();
-    timer_counter1 = TCNT1;
+    timer_counter1 = hal_timer1_read();
     interrupts();
 
 
@@ -302,18 +405,22 @@ OrionCalibrationResult do_calibration(unsigned long calibration_step, uint64_t c
     // We discard the first measurement (i=0) as it is always low.
     if (i != 0 ) {
 
-      // If measured_rx_freq == target_freq we don't modify the cal_factor.
+      // If measured_rx_freq == target_freq we don't modify the cal_factor. A gate more than CALIBRATION_MAX_GATE_ERROR_PPM
+      // off isn't a frequency error, an extra or missing PPS edge changed its length, so it is ignored.
+      gate_ok = (measured_rx_freq > target_freq - max_gate_error) && (measured_rx_freq < target_freq + max_gate_error);
       if (measured_rx_freq != 0 ) {
-        
-        // When we reach our target Frequency enable Frequency Diversity (aka QRM Avoidance)
-        if (measured_rx_freq == target_freq)
-          enable_qrm_avoidance();
-          
-        if (measured_rx_freq < target_freq)
-          cal_factor = cal_factor - calibration_step;
-
-        if (measured_rx_freq > target_freq)
-          cal_factor = cal_factor + calibration_step;
+
+        if (gate_ok) {
+          // When we reach our target Frequency enable Frequency Diversity (aka QRM Avoidance)
+          if (measured_rx_freq == target_freq)
+            enable_qrm_avoidance();
+
+          if (measured_rx_freq < target_freq)
+            cal_factor = cal_factor - calibration_step;
+
+          if (measured_rx_freq > target_freq)
+            cal_factor = cal_factor + calibration_step;
+        }
       }
       else {
         // Measured Frequency is Zero so the calibration has failed due to not sampling the Si5351a Calibration clock
@@ -322,13 +429,19 @@ OrionCalibrationResult do_calibration(unsigned long calibration_step, uint64_t c
         break; // break out of the for loop  *****
       }
 
+      // Each gate is also a measurement of the correction factor for the oscillator model. The correction that was
+      // in use during the gate is off by the relative frequency error. Allow for one count of error.
+      if ((g_params.osc_model == ON) && gate_ok)
+        osc_model_measure(old_cal_factor + (int32_t)((((int64_t)measured_rx_freq - (int64_t)target_freq) * 1000000000LL) / (int64_t)target_freq),
+                          gate_res_ppb * gate_res_ppb);
+
       log_debug_Timer1_info(i, overflowCounter, timer_counter1);
 
       // Log this iteration
       log_calibration(measured_rx_freq, old_cal_factor, cal_factor );
 
       si5351bx_set_correction(cal_factor); // Update the correction factor and reset the frequency to use it
-      si5351bx_setfreq(SI5351A_CAL_CLK_NUM, target_freq, SI5351_CLK_ON);
+      start_calibration_clock();
 
       delay(10);
 
@@ -346,25 +459,114 @@ OrionCalibrationResult do_calibration(unsigned long calibration_step, uint64_t c
   // This code mimics what happens when Calibration terminates successfully. (See PPSinterruptISR() and ISR (PCINT1_vect) for handling of the success case.)
   if (calibration_result != PASS ) { // If we failed Calibration then we need to disable the interrupts used for Calibration
     noInterrupts();
-    #if defined GPS_PPS_ON_D2_OR_D3 
-    {
-        //  GPS PPS signal sampled using External Interrupts on D2 or D3
-       EIMSK = (0 << INT0); // Disable GPS PPS external interrupt (INT1 on PIN D3)- CHANGE THIS to "INT0" IF USING PIN D2
-       TCCR1B = 0; // Disable Timer1 Counter sampling of the calibration clock.
-    }
-    #else 
-    {
-      // GPS PPS signal sampled using PinChangeInterrupts on A5/PCINT13 typical of U3S clone boards
-      PCMSK1 = (0 << PCINT13); // Disable PinChangeInterrupts (GPS PPS interrupt PCINT13 on A5)
-      TCCR1B = 0; // Disable Timer1 Counter Interrupt sampling of the calibration clock.
-    }
-    #endif
+    hal_pps_irq_enable(false); // Disable the GPS PPS External or PinChange interrupt
+    hal_timer1_stop(); // Disable Timer1 Counter sampling of the calibration clock.
+    HAL_PROBE_LOW(PROBE_BIT_CAL);
     interrupts(); 
   } // end if calibration not passed 
 
   // Turn on the PARK clock
-  si5351bx_setfreq(SI5351A_PARK_CLK_NUM, (PARK_FREQ_HZ * 100ULL), SI5351_CLK_ON); // Turn on Park Clock
+  si5351bx_park(SI5351_CLK_ON);
 
   return calibration_result;
 
 } // end do_calibration
+
+
+// Start the TX frequency monitor, if the txmon parameter is on, at the start of a WSPR transmission.
+// It needs self-calibration, which sets up the PPS interrupt, and a CAL clock output that is separate from the TX path.
+// It is also skipped on dual band boards, where the CAL clock is shared with the PARK clock.
+void tx_monitor_start() {
+  tx_monitor_gates = 0;
+  tx_monitor_corrections = 0;
+
+#if !defined (SI5351_CAL_ON_TX_PATH) && (SI5351A_PARK_CLK_NUM != SI5351A_CAL_CLK_NUM)
+  if ((g_params.tx_monitor == OFF) || (SI5351_SELF_CALIBRATION_SUPPORTED == false) || (is_selfcalibration_on() == false))
+    return;
+
+  start_calibration_clock();
+
+  noInterrupts();
+  g_tx_monitor_on = true;
+  tx_monitor_gate_done = false;
+  gpsPPScounter = 0;
+  overflowCounter = 0;
+  hal_timer1_clear();
+  hal_timer1_start_counter();
+#if !defined (GPS_PPS_ON_D2_OR_D3)
+  is_PPS_rising_edge = false; // Reset our flag so we can mimic external interrupts triggering on rising edge
+#endif
+  hal_pps_irq_enable(true);
+  interrupts();
+#endif
+}
+
+// Call once per symbol during a transmission. After each gate the correction factor in use is moved towards the measured
+// one : by the oscillator model if the oscmodel parameter is on, otherwise one Huff&Puff fine step like a calibration.
+// The first gate is discarded as in do_calibration(). Returns true if the correction factor was changed.
+bool tx_monitor_poll() {
+  uint32_t gate_count;
+  uint64_t measured_freq;
+  uint64_t max_gate_error;
+  uint32_t gate_res_ppb;
+  int32_t corr;
+  int32_t new_corr;
+
+  if ((g_tx_monitor_on == false) || (tx_monitor_gate_done == false)) return false;
+
+  noInterrupts();
+  gate_count = tx_monitor_gate_count;
+  tx_monitor_gate_done = false;
+  interrupts();
+
+  if (tx_monitor_gates++ == 0) return false;
+
+  // A gate with no counts means that the CAL clock isn't reaching D5, there is nothing to correct against
+  if (gate_count == 0) return false;
+
+  // A PPS glitch, see do_calibration()
+  measured_freq = gate_count * 10ULL; // Tenths of a hertz to hundredths, like do_calibration()
+  max_gate_error = (target_freq / 1000000ULL) * CALIBRATION_MAX_GATE_ERROR_PPM;
+  if ((measured_freq <= target_freq - max_gate_error) || (measured_freq >= target_freq + max_gate_error)) return false;
+  corr = si5351bx_get_correction();
+  new_corr = corr;
+
+  if (g_params.osc_model == ON) {
+    gate_res_ppb = 10000000000ULL / target_freq;
+    osc_model_measure(corr + (int32_t)((((int64_t)measured_freq - (int64_t)target_freq) * 1000000000LL) / (int64_t)target_freq),
+                      gate_res_ppb * gate_res_ppb);
+    new_corr = osc_model_correction();
+  }
+  else {
+    if (measured_freq < target_freq)
+      new_corr = corr - g_params.fine_cal_step;
+    if (measured_freq > target_freq)
+      new_corr = corr + g_params.fine_cal_step;
+
+    // The next calibration carries on from here
+    old_cal_factor = cal_factor;
+    cal_factor = new_corr;
+  }
+
+  if (new_corr == corr) return false;
+
+  si5351bx_set_correction(new_corr);
+  start_calibration_clock(); // So that the next gate measures the new correction
+  tx_monitor_corrections++;
+  return true;
+}
+
+// Stop the TX frequency monitor at the end of a WSPR transmission
+void tx_monitor_stop() {
+  if (g_tx_monitor_on == false) return;
+
+  noInterrupts();
+  hal_pps_irq_enable(false);
+  hal_timer1_stop();
+  g_tx_monitor_on = false;
+  HAL_PROBE_LOW(PROBE_BIT_CAL);
+  interrupts();
+
+  si5351bx_enable_clk(SI5351A_CAL_CLK_NUM, SI5351_CLK_OFF);
+  log_tx_monitor(tx_monitor_gates, tx_monitor_corrections, si5351bx_get_correction());
+}
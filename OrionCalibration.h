@@ -24,7 +24,12 @@
 #define FINE_CORRECTION_STEP   10     // 0.1 HZ step
 #define COARSE_CORRECTION_STEP 100   // 1 Hz step
 
+void setup_pps_interrupt();
 void setup_calibration();
 void reset_for_calibration();
+void set_calibration_correction(int32_t corr);
 OrionCalibrationResult do_calibration(unsigned long calibration_step, uint64_t calibration_timeout);
+void tx_monitor_start();
+bool tx_monitor_poll();
+void tx_monitor_stop();
 #endif
@@ -0,0 +1,71 @@
+/*
+   OrionCheckpoint.cpp - Reset checkpoint for the Orion WSPR Beacon
+
+   A watchdog, brown-out or external reset would otherwise lose the system time, the calibrated correction factor, the
+   QRM Avoidance and GPS LOS state and the last telemetry, and start over with a full startup calibration. Instead a copy
+   of them is kept in SRAM that the C runtime leaves alone (.noinit), updated by save_checkpoint() in OrionWspr.ino at
+   each state machine action and once a second. SRAM keeps its contents through any reset except a power on, so after
+   a reset resume_from_checkpoint() can restore them and the beacon is back on its schedule within seconds.
+
+   The checkpoint is only trusted if the cause of the reset is known and wasn't a power on (MCUSR, or the copy of it that
+   Optiboot passes in r2, see hal_reset_flags()) and it has the right magic number, version and CRC. A brown-out can leave
+   SRAM partly corrupted, the CRC catches that. With a bootloader that clears MCUSR without passing it on the reset cause
+   is unknown and the beacon always starts over, as it did before the checkpoint was added.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+#include "OrionCheckpoint.h"
+#include "OrionHal.h"
+#include <util/crc16.h>
+
+#define CHECKPOINT_MAGIC     0x4F52   // "OR"
+
+static struct OrionCheckpoint g_checkpoint HAL_NOINIT;
+
+// CRC of everything but the crc field itself, the same CRC-16 as the EEPROM parameters
+static uint16_t checkpoint_crc(const struct OrionCheckpoint *cp) {
+  uint16_t crc = 0xFFFF;
+  const uint8_t *b = (const uint8_t *)cp;
+
+  for (byte i = 0; i < offsetof(struct OrionCheckpoint, crc); i++)
+    crc = _crc16_update(crc, b[i]);
+
+  return crc;
+}
+
+// Fill in the magic number, version and CRC of cp and make it the checkpoint
+void checkpoint_save(struct OrionCheckpoint *cp) {
+  cp->magic = CHECKPOINT_MAGIC;
+  cp->version = CHECKPOINT_VERSION;
+  cp->crc = checkpoint_crc(cp);
+  memcpy(&g_checkpoint, cp, sizeof(g_checkpoint));
+}
+
+// Copy the checkpoint to cp. Returns false after a power on reset, an unknown reset or if the checkpoint isn't valid.
+bool checkpoint_load(struct OrionCheckpoint *cp) {
+  uint8_t flags = hal_reset_flags();
+
+  if ((flags == 0) || (flags & HAL_RESET_POWER_ON)) return false;
+
+  memcpy(cp, &g_checkpoint, sizeof(g_checkpoint));
+  return (cp->magic == CHECKPOINT_MAGIC) && (cp->version == CHECKPOINT_VERSION) && (cp->crc == checkpoint_crc(cp));
+}
+
+// Make sure the checkpoint isn't used by the next reset, e.g. before a controlled shutdown
+void checkpoint_clear() {
+  memset(&g_checkpoint, 0, sizeof(g_checkpoint));
+}
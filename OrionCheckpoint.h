@@ -0,0 +1,46 @@
+#ifndef ORIONCHECKPOINT_H
+#define ORIONCHECKPOINT_H
+/*
+    OrionCheckpoint.h - Definitions for the Orion reset checkpoint
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+
+// Increment this whenever struct OrionCheckpoint changes so that a checkpoint left by older firmware is ignored
+#define CHECKPOINT_VERSION   1
+
+enum CheckpointLos {CHECKPOINT_LOS_NONE, CHECKPOINT_LOS_RUNNING, CHECKPOINT_LOS_EXPIRED};
+
+// What the beacon needs to carry on after a reset without a startup calibration
+struct OrionCheckpoint {
+  uint16_t magic;                  // CHECKPOINT_MAGIC
+  uint8_t version;                 // CHECKPOINT_VERSION
+  uint8_t state;                   // OrionState
+  uint32_t time_s;                 // System time (now()) when saved
+  int32_t correction;              // Si5351a correction factor in use
+  uint8_t qrm_avoidance;           // ON or OFF
+  uint8_t gps_los;                 // CheckpointLos, the g_chrono_GPS_LOS timer
+  uint8_t resumes;                 // Resets in a row that resumed from this checkpoint
+  struct OrionTxData tx_data;      // Last telemetry sent
+  struct OrionTelemetryData last_valid_telemetry;
+  uint16_t crc;
+};
+
+void checkpoint_save(struct OrionCheckpoint *cp);
+bool checkpoint_load(struct OrionCheckpoint *cp);
+void checkpoint_clear();
+#endif
@@ -0,0 +1,200 @@
+/*
+   OrionHal.cpp - Hardware abstraction layer for the Orion WSPR Beacon
+
+   The AVR versions of most of the HAL are inline in OrionHal.h. This file has the I2C functions, which need the
+   Wire (or SoftWire) instance, the reset cause, which is read before main(), and the host mock implementation used
+   when __AVR__ is not defined.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+#include "OrionBoardConfig.h"
+#include "OrionHal.h"
+
+#if defined(__AVR__)
+
+#if defined (SI5351A_USES_SOFTWARE_I2C)
+#include <SoftWire.h>  // Needed for Software I2C otherwise include <Wire.h>
+#else
+#include <Wire.h>
+#endif
+#include <avr/wdt.h>
+
+// Create an instance of Softwire named Wire if using Software I2C
+#if defined (SI5351A_USES_SOFTWARE_I2C)
+SoftWire Wire = SoftWire();
+#endif
+
+void hal_i2c_begin() {
+  Wire.begin();
+}
+
+// Write count bytes starting at register reg of the I2C device at addr
+uint8_t hal_i2c_write(uint8_t addr, uint8_t reg, const uint8_t *vals, uint8_t count) {
+  uint8_t status;
+
+  HAL_PROBE_HIGH(PROBE_BIT_I2C);
+  Wire.beginTransmission(addr);
+  Wire.write(reg);
+  while (count--) Wire.write(*vals++);
+  status = Wire.endTransmission();
+  HAL_PROBE_LOW(PROBE_BIT_I2C);
+
+  return status;
+}
+
+static uint8_t hal_mcusr HAL_NOINIT;
+static volatile uint8_t hal_boot_r2 HAL_NOINIT asm ("hal_boot_r2");
+
+// Save and clear MCUSR, then turn off the watchdog. After a watchdog reset the watchdog is still running with its
+// shortest timeout and it can't be turned off while WDRF is set, so this has to happen before the C runtime and the
+// Arduino core start up. This runs in .init3, after the stack pointer is set up and before .data and .bss, which
+// is why hal_mcusr and hal_boot_r2 are in .noinit.
+//
+// Optiboot clears MCUSR before it starts the sketch and passes the value it read in r2 instead, which nothing
+// touches before .init3, so r2 is saved as well, see hal_reset_flags().
+void hal_save_reset_flags() __attribute__ ((naked)) __attribute__ ((used)) __attribute__ ((section (".init3")));
+void hal_save_reset_flags() {
+  asm volatile ("sts hal_boot_r2, r2");  // First, before the compiler can use r2
+  hal_mcusr = MCUSR;
+  MCUSR = 0;
+  wdt_disable();
+}
+
+// MCUSR, or the copy that Optiboot passed in r2 when MCUSR was cleared. Only the four reset flag bits can be set in a
+// real MCUSR value, anything else in r2 means that it wasn't set by the bootloader (e.g. an old bootloader that clears
+// MCUSR without passing it on) and the cause of the reset is unknown.
+uint8_t hal_reset_flags() {
+  uint8_t flags = (hal_mcusr != 0) ? hal_mcusr : hal_boot_r2;
+
+  if (flags & ~(HAL_RESET_POWER_ON | HAL_RESET_EXTERNAL | HAL_RESET_BROWN_OUT | HAL_RESET_WATCHDOG)) return 0;
+  return flags;
+}
+
+#else // Host mock
+
+struct OrionHalMock g_hal_mock;
+
+// Back to power up state, with the EEPROM erased
+void hal_mock_reset() {
+  memset(&g_hal_mock, 0, sizeof(g_hal_mock));
+  memset(g_hal_mock.eeprom, 0xFF, sizeof(g_hal_mock.eeprom));
+}
+
+void hal_i2c_begin() {
+}
+
+uint8_t hal_i2c_write(uint8_t addr, uint8_t reg, const uint8_t *vals, uint8_t count) {
+  g_hal_mock.i2c_transactions++;
+  if (g_hal_mock.i2c_hook != NULL) g_hal_mock.i2c_hook(addr, reg, vals, count);
+  return g_hal_mock.i2c_status;
+}
+
+void hal_timer1_start_ctc(uint16_t top) {
+  g_hal_mock.timer1_mode = HAL_T1_CTC;
+  g_hal_mock.timer1_top = top;
+  g_hal_mock.timer1_count = 0;
+}
+
+void hal_timer1_start_counter() {
+  g_hal_mock.timer1_mode = HAL_T1_COUNTER;
+}
+
+void hal_timer1_stop() {
+  g_hal_mock.timer1_mode = HAL_T1_OFF;
+}
+
+void hal_timer1_disable() {
+  g_hal_mock.timer1_mode = HAL_T1_OFF;
+}
+
+void hal_timer1_clear() {
+  g_hal_mock.timer1_count = 0;
+  g_hal_mock.timer1_clears++;
+}
+
+uint16_t hal_timer1_read() {
+  return g_hal_mock.timer1_count;
+}
+
+bool hal_timer1_overflow_pending() {
+  return g_hal_mock.timer1_overflow;
+}
+
+void hal_timer2_start_ctc(uint8_t top) {
+  g_hal_mock.timer2_running = true;
+  g_hal_mock.timer2_top = top;
+}
+
+void hal_timer2_set_top(uint8_t top) {
+  g_hal_mock.timer2_top = top;
+}
+
+void hal_timer2_disable() {
+  g_hal_mock.timer2_running = false;
+}
+
+void hal_pps_irq_setup() {
+  g_hal_mock.pps_irq_enabled = false;
+}
+
+void hal_pps_irq_enable(bool on) {
+  g_hal_mock.pps_irq_enabled = on;
+}
+
+uint16_t hal_adc_read_internal_temp() {
+  return g_hal_mock.adc_internal_temp;
+}
+
+void hal_eeprom_read(uint16_t addr, void *data, uint16_t size) {
+  if ((uint32_t)addr + size > HAL_MOCK_EEPROM_SIZE) return;
+  memcpy(data, &g_hal_mock.eeprom[addr], size);
+}
+
+void hal_eeprom_update(uint16_t addr, const void *data, uint16_t size) {
+  const uint8_t *b = (const uint8_t *)data;
+
+  if ((uint32_t)addr + size > HAL_MOCK_EEPROM_SIZE) return;
+
+  for (uint16_t i = 0; i < size; i++) {
+    if (g_hal_mock.eeprom[addr + i] != b[i]) {
+      g_hal_mock.eeprom[addr + i] = b[i];
+      g_hal_mock.eeprom_writes++;
+    }
+  }
+}
+
+void hal_spin() {
+  if (g_hal_mock.wait_hook != NULL) g_hal_mock.wait_hook();
+}
+
+void hal_sleep_idle() {
+  g_hal_mock.idle_sleeps++;
+  if (g_hal_mock.wait_hook != NULL) g_hal_mock.wait_hook();
+}
+
+void hal_sleep_power_down_8s() {
+  g_hal_mock.power_down_sleeps++;
+}
+
+void hal_wdt_disable() {
+}
+
+uint8_t hal_reset_flags() {
+  return g_hal_mock.reset_flags;
+}
+
+#endif // __AVR__
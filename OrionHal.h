@@ -0,0 +1,319 @@
+#ifndef ORIONHAL_H
+#define ORIONHAL_H
+/*
+    OrionHal.h - Hardware abstraction layer for the Orion WSPR Beacon
+
+   All of the direct ATmega328p register access (Timer1, the GPS PPS interrupts, the ADC, sleep and the watchdog)
+   and the I2C and EEPROM library calls used by the Orion modules go through these functions. On the AVR they
+   are inline wrappers around the same register writes that the modules used to do themselves, so they cost
+   nothing. When compiled for anything other than the AVR (__AVR__ not defined) a mock implementation in
+   OrionHal.cpp is used instead. It records what the firmware asked the hardware to do in g_hal_mock and lets
+   a host program inject the values the hardware would return, so the Orion modules can be exercised without
+   a board.
+
+   The Arduino core API (millis(), digitalRead(), Serial etc.) is not part of the HAL, the host build (CMakeLists.txt)
+   gets it from the shims in tools/host.
+
+   The HAL_PROBE_xxx macros drive the optional timing probe pins (see ORION_TIMING_PROBES in OrionBoardConfig.h). The
+   mock keeps them in g_hal_mock.probes for the host board simulator (tools/host/sim_board.cpp).
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+#include "OrionBoardConfig.h"
+
+// Reset causes returned by hal_reset_flags(), the ATmega328p MCUSR bits
+#define HAL_RESET_POWER_ON   0x01   // PORF
+#define HAL_RESET_EXTERNAL   0x02   // EXTRF
+#define HAL_RESET_BROWN_OUT  0x04   // BORF
+#define HAL_RESET_WATCHDOG   0x08   // WDRF
+
+// I2C (implemented in OrionHal.cpp for both the AVR and the mock)
+void hal_i2c_begin();
+uint8_t hal_i2c_write(uint8_t addr, uint8_t reg, const uint8_t *vals, uint8_t count); // Returns 0 on success
+
+// The cause of the last reset, HAL_RESET_xxx bits, or 0 if the bootloader didn't let us know (implemented in OrionHal.cpp
+// for both the AVR and the mock)
+uint8_t hal_reset_flags();
+
+#if defined(__AVR__)
+
+#include <avr/eeprom.h>
+#include <LowPower.h>
+
+// Variables in .noinit are neither initialized nor cleared at startup, so they keep their value through any reset
+// other than a power on (see OrionCheckpoint.cpp)
+#define HAL_NOINIT  __attribute__ ((section (".noinit")))
+
+// ---- Timer1 ----
+
+// CTC mode with the /1024 prescaler and the compare B interrupt, ISR(TIMER1_COMPB_vect), every top + 1 ticks.
+// OCR1A is TOP and OCR1B is set equal to it so that compare B fires at the same rate. Used by the QRSS keyer.
+inline void hal_timer1_start_ctc(uint16_t top) {
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  OCR1A = top;
+  OCR1B = top;
+  TIFR1 = (1 << OCF1A) | (1 << OCF1B) | (1 << TOV1);  // Clear any stale interrupt flags
+  TIMSK1 = (1 << OCIE1B);
+  TCCR1B = (1 << WGM12) | (1 << CS12) | (1 << CS10);  // CTC, prescale /1024
+  interrupts();
+}
+
+// Normal mode counting the Si5351a calibration clock on the T1 pin (D5), rising edge, with the overflow interrupt
+// ISR(TIMER1_OVF_vect) enabled. The counter is not cleared, see hal_timer1_clear(). Call with interrupts disabled.
+inline void hal_timer1_start_counter() {
+  TCCR1A = 0;
+  TCCR1B = (1 << CS12) | (1 << CS11) | (1 << CS10);
+  TIMSK1 = (1 << TOIE1);
+}
+
+// Stop the Timer1 clock, leaving the count and interrupt mask alone. Safe to call from an ISR.
+inline void hal_timer1_stop() {
+  TCCR1B = 0;
+}
+
+// Stop Timer1 and disable all of its interrupts
+inline void hal_timer1_disable() {
+  noInterrupts();
+  TIMSK1 = 0;
+  TCCR1B = 0;
+  interrupts();
+}
+
+// Zero the count and clear a pending overflow. Safe to call from an ISR.
+inline void hal_timer1_clear() {
+  TCNT1 = 0;
+  TIFR1 = (1 << TOV1);
+}
+
+// Call with interrupts disabled (or from an ISR)
+inline uint16_t hal_timer1_read() {
+  return TCNT1;
+}
+
+// True if the counter has overflowed but ISR(TIMER1_OVF_vect) hasn't run yet. Call with interrupts disabled (or from an ISR).
+inline bool hal_timer1_overflow_pending() {
+  return (TIFR1 & (1 << TOV1)) != 0;
+}
+
+// ---- Timer2 ----
+
+// CTC mode with the /1024 prescaler and the compare A interrupt, ISR(TIMER2_COMPA_vect), every top + 1 ticks.
+// The 8 bit timer only counts up to 256 ticks (32.768 ms at 8 MHz), longer periods are made of several, see
+// hal_timer2_set_top(). The prescaler is reset so that the first period is a whole one.
+inline void hal_timer2_start_ctc(uint8_t top) {
+  noInterrupts();
+  TCCR2B = 0;
+  TCCR2A = (1 << WGM21);                              // CTC
+  TCNT2 = 0;
+  OCR2A = top;
+  TIFR2 = (1 << OCF2A) | (1 << OCF2B) | (1 << TOV2);  // Clear any stale interrupt flags
+  TIMSK2 = (1 << OCIE2A);
+  GTCCR = (1 << PSRASY);
+  TCCR2B = (1 << CS22) | (1 << CS21) | (1 << CS20);   // Prescale /1024
+  interrupts();
+}
+
+// Change the number of ticks (less one) of the period that follows. Only call from ISR(TIMER2_COMPA_vect), just after the
+// counter has been cleared by the compare match, as OCR2A isn't double buffered in CTC mode.
+inline void hal_timer2_set_top(uint8_t top) {
+  OCR2A = top;
+}
+
+// Stop Timer2 and disable its interrupts
+inline void hal_timer2_disable() {
+  noInterrupts();
+  TIMSK2 = 0;
+  TCCR2B = 0;
+  interrupts();
+}
+
+// ---- GPS PPS interrupt ----
+// Either the external interrupt on D2/D3 (PPSinterruptISR() attached by the caller) or the pin change
+// interrupt PCINT13 on A5, see OrionCalibration.cpp
+
+// One time setup, leaving the PPS interrupt disabled
+inline void hal_pps_irq_setup() {
+  noInterrupts();
+#if defined (GPS_PPS_ON_D2_OR_D3)
+  EIMSK = (0 << INT0); // Disable GPS PPS external interupt (INT0 on PIN D2) - CHANGE THIS TO "INT1" IF USING PIN D3
+#else
+  PCICR |= (1 << PCIE1);   // [Pin Change Interrupt Control Register] - Enable PinchangeInterrupts for Port C (A5), without disabling PCIE0 or PCIE2
+  PCIFR  = (1 << PCIF1);   // [Pin Change Interrupt Flag Register] clear any outstanding interrupts. Counterintuitively writing a 1 clears the flag
+  PCMSK1 = (0 << PCINT13); // [Pin Change Mask Register 1] Disable Interrupts for PCINT13 aka PIN A5.
+#endif
+  interrupts();
+}
+
+// Enable or disable the PPS interrupt. Safe to call from an ISR or with interrupts disabled.
+inline void hal_pps_irq_enable(bool on) {
+#if defined (GPS_PPS_ON_D2_OR_D3)
+  EIMSK = on ? (1 << INT0) : (0 << INT0); // CHANGE THIS TO "INT1" IF USING PIN D3
+#else
+  if (on) PCIFR = (1 << PCIF1); // Clear any outstanding interrupt, writing a 1 clears the flag
+  PCMSK1 = on ? (1 << PCINT13) : (0 << PCINT13);
+#endif
+}
+
+// ---- ADC ----
+
+// Read the processor's internal temperature sensor (ADC channel 8 with the 1.1V internal reference), raw ADC counts
+inline uint16_t hal_adc_read_internal_temp() {
+  // Set the internal reference and mux. Channel 8 can not be selected with analogRead().
+  ADMUX = (_BV(REFS1) | _BV(REFS0) | _BV(MUX3));
+  ADCSRA |= _BV(ADEN);  // enable the ADC
+
+  delay(20);            // wait for voltages to become stable.
+
+  ADCSRA |= _BV(ADSC);  // Start the ADC
+
+  // Detect end-of-conversion
+  while (bit_is_set(ADCSRA, ADSC));
+
+  // Reading register "ADCW" takes care of how to read ADCL and ADCH.
+  return ADCW;
+}
+
+// ---- EEPROM ----
+
+inline void hal_eeprom_read(uint16_t addr, void *data, uint16_t size) {
+  eeprom_read_block(data, (const void *)addr, size);
+}
+
+// Only bytes that differ are written, to save EEPROM wear
+inline void hal_eeprom_update(uint16_t addr, const void *data, uint16_t size) {
+  eeprom_update_block(data, (void *)addr, size);
+}
+
+// ---- Sleep and watchdog ----
+
+// Called on each pass of a busy wait for an interrupt (the end of a WSPR symbol or a calibration gate). Nothing to do
+// on the AVR, the interrupt ends the wait on its own.
+inline void hal_spin() {
+}
+
+// Idle until the next interrupt. Timer0 (millis), Timer1 and the USART keep running.
+inline void hal_sleep_idle() {
+  LowPower.idle(SLEEP_FOREVER, ADC_OFF, TIMER2_OFF, TIMER1_ON, TIMER0_ON, SPI_OFF, USART0_ON, TWI_OFF);
+}
+
+// Power down for 8 seconds with the ADC off and brown-out detection on, we are woken by the watchdog
+inline void hal_sleep_power_down_8s() {
+  LowPower.powerDown(SLEEP_8S, ADC_OFF, BOD_ON);
+}
+
+// Disable the hardware watchdog, in case it was accidentally enabled during a brown-out
+inline void hal_wdt_disable() {
+  noInterrupts();
+  MCUSR &= ~(1 << WDRF);                // Clear WDRF in MCUSR
+  WDTCSR |= (1 << WDCE) | (1 << WDE);   // Write logical one to WDCE and WDE, keeping the old prescaler setting
+  WDTCSR = 0x00;                        // Turn off WDT
+  interrupts();
+}
+
+#else // Host mock
+
+// The host simulator (tools/host/sim_board.cpp) keeps this section through a simulated reset, like .noinit
+#define HAL_NOINIT  __attribute__ ((section ("orion_noinit")))
+
+// Interrupt handlers become ordinary functions that a host program can call to simulate the interrupt
+#if !defined(ISR)
+#define ISR(vector) void vector()
+#endif
+
+enum HalTimer1Mode {HAL_T1_OFF, HAL_T1_CTC, HAL_T1_COUNTER};
+
+#define HAL_MOCK_EEPROM_SIZE 1024
+
+// What the firmware has asked of the hardware, and the values the hardware should return
+struct OrionHalMock {
+  uint8_t timer1_mode;          // HalTimer1Mode
+  uint16_t timer1_top;
+  uint16_t timer1_count;        // Returned by hal_timer1_read()
+  unsigned long timer1_clears;  // hal_timer1_clear() calls
+  bool timer1_overflow;         // Returned by hal_timer1_overflow_pending()
+  bool timer2_running;
+  uint8_t timer2_top;
+  bool pps_irq_enabled;
+  uint16_t adc_internal_temp;   // Returned by hal_adc_read_internal_temp()
+  uint8_t eeprom[HAL_MOCK_EEPROM_SIZE];
+  unsigned long eeprom_writes;  // Bytes actually written
+  uint8_t i2c_status;           // Returned by hal_i2c_write(), 0 = ACK
+  unsigned long i2c_transactions;
+  void (*i2c_hook)(uint8_t addr, uint8_t reg, const uint8_t *vals, uint8_t count); // Optional, sees every write
+  void (*wait_hook)();           // Optional, called by hal_spin() and hal_sleep_idle() where the firmware waits for an interrupt
+  unsigned long idle_sleeps;
+  unsigned long power_down_sleeps;
+  uint8_t probes;               // The timing probe pins, bit PROBE_BIT_xxx
+  uint8_t reset_flags;          // Returned by hal_reset_flags()
+};
+
+extern struct OrionHalMock g_hal_mock;
+
+void hal_mock_reset();
+void hal_timer1_start_ctc(uint16_t top);
+void hal_timer1_start_counter();
+void hal_timer1_stop();
+void hal_timer1_disable();
+void hal_timer1_clear();
+uint16_t hal_timer1_read();
+bool hal_timer1_overflow_pending();
+void hal_timer2_start_ctc(uint8_t top);
+void hal_timer2_set_top(uint8_t top);
+void hal_timer2_disable();
+void hal_pps_irq_setup();
+void hal_pps_irq_enable(bool on);
+uint16_t hal_adc_read_internal_temp();
+void hal_eeprom_read(uint16_t addr, void *data, uint16_t size);
+void hal_eeprom_update(uint16_t addr, const void *data, uint16_t size);
+void hal_spin();
+void hal_sleep_idle();
+void hal_sleep_power_down_8s();
+void hal_wdt_disable();
+
+#endif // __AVR__
+
+// ---- Timing probe pins ----
+// See ORION_TIMING_PROBES in OrionBoardConfig.h. Each probe is a single sbi/cbi/out instruction so it can be used in an
+// ISR without disturbing the timing being measured. They compile to nothing when the probes are off. The mock always
+// keeps them in g_hal_mock.probes, for the host simulator's trace.
+#if defined (ORION_TIMING_PROBES) && defined(__AVR__)
+#define HAL_PROBE_SETUP()       do { PROBE_PORT &= ~((1 << PROBE_BIT_SYMBOL) | (1 << PROBE_BIT_CAL) | (1 << PROBE_BIT_I2C)); \
+                                     PROBE_DDR |= (1 << PROBE_BIT_SYMBOL) | (1 << PROBE_BIT_CAL) | (1 << PROBE_BIT_I2C); } while (0)
+#define HAL_PROBE_HIGH(bit)     (PROBE_PORT |= (1 << (bit)))
+#define HAL_PROBE_LOW(bit)      (PROBE_PORT &= ~(1 << (bit)))
+#define HAL_PROBE_TOGGLE(bit)   (*(&PROBE_PORT - 2) = (1 << (bit)))   // Writing a 1 to the PINx register toggles PORTx
+#elif !defined(__AVR__)
+#if !defined (ORION_TIMING_PROBES)
+#define PROBE_BIT_SYMBOL        0             // The OrionBoardConfig.h bits
+#define PROBE_BIT_CAL           2
+#define PROBE_BIT_I2C           5
+#endif
+#define HAL_PROBE_SETUP()       (g_hal_mock.probes = 0)
+#define HAL_PROBE_HIGH(bit)     (g_hal_mock.probes |= (1 << (bit)))
+#define HAL_PROBE_LOW(bit)      (g_hal_mock.probes &= ~(1 << (bit)))
+#define HAL_PROBE_TOGGLE(bit)   (g_hal_mock.probes ^= (1 << (bit)))
+#else
+#define HAL_PROBE_SETUP()
+#define HAL_PROBE_HIGH(bit)
+#define HAL_PROBE_LOW(bit)
+#define HAL_PROBE_TOGGLE(bit)
+#endif
+
+#endif
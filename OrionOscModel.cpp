@@ -0,0 +1,182 @@
+/*
+   OrionOscModel.cpp - Kalman filter model of the Si5351a reference oscillator for the Orion WSPR Beacon
+
+   Self-calibration measures the Si5351a correction factor (in parts per billion, see si5351bx_set_correction()) at every
+   10 second gate, but on its own only the last Huff&Puff value is kept. This filter combines the gates, along with the
+   temperature at the time, into a model of the crystal with three states :
+
+     corr     the correction factor at OSC_MODEL_REF_TEMP_C (ppb)
+     rate     its drift rate, e.g. from crystal aging (ppb per hour)
+     tempco   its temperature coefficient (ppb per degree C)
+
+   With the oscmodel parameter on each transmission uses the predicted correction, corr + tempco x (temperature -
+   OSC_MODEL_REF_TEMP_C), advanced by the drift rate to the time of the transmission. The prediction keeps following the
+   temperature between calibrations and through a GPS LOS, when there is nothing to calibrate against. Its standard
+   deviation decides if QRM Avoidance can stay on after a failed calibration and if a calibration can be skipped.
+
+   The filter is fixed point. The AVR float only has a 24 bit mantissa, which is not enough for variances that go from
+   about 1e8 ppb^2 down to a few ppb^2. The states are kept x 256 and the covariance x 16 in int32_t, with the intermediate
+   products in int64_t. It only runs once per calibration gate and once per transmission so the 64 bit arithmetic is cheap.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+#include "OrionOscModel.h"
+
+#define OSC_X_SHIFT  8     // The states are x 256
+#define OSC_P_SHIFT  4     // The covariance is x 16
+#define OSC_K_SHIFT  16    // The Kalman gains are x 65536
+
+enum {OSC_CORR, OSC_RATE, OSC_TEMPCO};
+
+static int32_t osc_x[3];                 // corr, rate and tempco, x 256
+static int32_t osc_p[3][3];              // Covariance of the states, x 16
+static uint32_t osc_time_min = 0;        // Time of the states, in minutes
+static bool osc_time_valid = false;
+static int osc_temp_offset_c = 0;        // Temperature of the next measurement or prediction, less OSC_MODEL_REF_TEMP_C
+static uint8_t osc_skipped_cals = 0;
+
+static int32_t sat32(int64_t v) {
+  if (v > INT32_MAX) return INT32_MAX;
+  if (v < -INT32_MAX) return -INT32_MAX;
+  return (int32_t)v;
+}
+
+static uint32_t isqrt32(uint32_t v) {
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+
+  while (bit > v) bit >>= 2;
+  while (bit != 0) {
+    if (v >= root + bit) {
+      v -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+      root >>= 1;
+    bit >>= 2;
+  }
+  return root;
+}
+
+// Start over from the correction factor corr, e.g. the saved corr parameter at boot or a "set corr" command.
+// The drift rate and the temperature coefficient start at zero, all three with the OSC_MODEL_*_SIGMA uncertainty.
+void osc_model_reset(int32_t corr) {
+  memset(osc_p, 0, sizeof(osc_p));
+  osc_x[OSC_CORR] = corr * (1L << OSC_X_SHIFT);
+  osc_x[OSC_RATE] = 0;
+  osc_x[OSC_TEMPCO] = 0;
+  osc_p[OSC_CORR][OSC_CORR] = ((int32_t)OSC_MODEL_CORR_SIGMA_PPB * OSC_MODEL_CORR_SIGMA_PPB) << OSC_P_SHIFT;
+  osc_p[OSC_RATE][OSC_RATE] = ((int32_t)OSC_MODEL_RATE_SIGMA_PPB_H * OSC_MODEL_RATE_SIGMA_PPB_H) << OSC_P_SHIFT;
+  osc_p[OSC_TEMPCO][OSC_TEMPCO] = ((int32_t)OSC_MODEL_TEMPCO_SIGMA_PPB_C * OSC_MODEL_TEMPCO_SIGMA_PPB_C) << OSC_P_SHIFT;
+  osc_time_valid = false;
+  osc_skipped_cals = 0;
+}
+
+// Kalman prediction step. Advance the states to time_s (seconds, e.g. now()) and record the temperature for the
+// following measurements and predictions. A clock that goes backwards (e.g. when the GPS first sets the time)
+// restarts the time base without a prediction, long gaps are limited to OSC_MODEL_MAX_STEP_MIN.
+void osc_model_time_update(uint32_t time_s, int temperature_c) {
+  uint32_t time_min = time_s / 60;
+  int64_t dt;
+  int32_t (*p)[3] = osc_p;
+
+  if (temperature_c < -100) temperature_c = -100;   // A failed sensor reading, don't let it wreck the model
+  if (temperature_c > 100) temperature_c = 100;
+  osc_temp_offset_c = temperature_c - OSC_MODEL_REF_TEMP_C;
+
+  if ((osc_time_valid == false) || (time_min < osc_time_min)) {
+    osc_time_min = time_min;
+    osc_time_valid = true;
+    return;
+  }
+
+  dt = time_min - osc_time_min;
+  if (dt > OSC_MODEL_MAX_STEP_MIN) dt = OSC_MODEL_MAX_STEP_MIN;
+  osc_time_min = time_min;
+  if (dt == 0) return;
+
+  // x = F x and P = F P F' + Q, with F = [1 dt/60 0, 0 1 0, 0 0 1] as the rate is per hour.
+  // Q adds the random walk of each state over dt.
+  osc_x[OSC_CORR] = sat32(osc_x[OSC_CORR] + ((int64_t)osc_x[OSC_RATE] * dt) / 60);
+
+  p[0][0] = sat32(p[0][0] + (2 * dt * p[0][1]) / 60 + (dt * dt * p[1][1]) / 3600 +
+                  ((dt * OSC_MODEL_CORR_WALK_PPB2_H) << OSC_P_SHIFT) / 60);
+  p[0][1] = sat32(p[0][1] + (dt * p[1][1]) / 60);
+  p[0][2] = sat32(p[0][2] + (dt * p[1][2]) / 60);
+  p[1][1] = sat32(p[1][1] + ((dt * OSC_MODEL_RATE_WALK) << OSC_P_SHIFT) / 60);
+  p[2][2] = sat32(p[2][2] + ((dt * OSC_MODEL_TEMPCO_WALK) << OSC_P_SHIFT) / 60);
+  p[1][0] = p[0][1];
+  p[2][0] = p[0][2];
+}
+
+// Kalman update step with one measured correction factor, at the temperature given to osc_model_time_update().
+// variance is the measurement variance in ppb^2.
+void osc_model_measure(int32_t corr, uint32_t variance) {
+  int64_t d = osc_temp_offset_c;   // The measurement is H x with H = [1 0 d]
+  int64_t ph[3];                   // P H'
+  int64_t k[3];                    // Kalman gain, x 65536
+  int64_t s;                       // Innovation variance, H P H' + R
+  int64_t y;                       // Innovation
+  uint8_t i;
+  uint8_t j;
+
+  for (i = 0; i < 3; i++)
+    ph[i] = osc_p[i][OSC_CORR] + d * osc_p[i][OSC_TEMPCO];
+  s = ph[OSC_CORR] + d * ph[OSC_TEMPCO] + ((int64_t)variance << OSC_P_SHIFT);
+  y = ((int64_t)corr << OSC_X_SHIFT) - osc_x[OSC_CORR] - d * osc_x[OSC_TEMPCO];
+
+  for (i = 0; i < 3; i++) {
+    k[i] = (ph[i] << OSC_K_SHIFT) / s;
+    osc_x[i] = sat32(osc_x[i] + ((k[i] * y) >> OSC_K_SHIFT));
+  }
+
+  // P = P - K H P, calculated on the upper triangle and mirrored so that P stays symmetric
+  for (i = 0; i < 3; i++) {
+    for (j = i; j < 3; j++) {
+      osc_p[i][j] = sat32(osc_p[i][j] - ((k[i] * ph[j]) >> OSC_K_SHIFT));
+      osc_p[j][i] = osc_p[i][j];
+    }
+    if (osc_p[i][i] < 1) osc_p[i][i] = 1;
+  }
+}
+
+// The predicted correction factor (ppb) at the time and temperature of the last osc_model_time_update()
+int32_t osc_model_correction() {
+  return (int32_t)((osc_x[OSC_CORR] + (int64_t)osc_temp_offset_c * osc_x[OSC_TEMPCO] + (1L << (OSC_X_SHIFT - 1))) >> OSC_X_SHIFT);
+}
+
+// The standard deviation (ppb) of osc_model_correction()
+uint16_t osc_model_sigma_ppb() {
+  int64_t d = osc_temp_offset_c;
+  int64_t var = (osc_p[0][0] + 2 * d * osc_p[0][2] + d * d * osc_p[2][2]) >> OSC_P_SHIFT;
+
+  if (var < 0) var = 0;
+  if (var > 0xFFFE0001LL) return 0xFFFF;
+  return isqrt32((uint32_t)var);
+}
+
+// Returns true if the next calibration can be skipped because the model already predicts the correction to within
+// OSC_MODEL_SKIP_CAL_PPB (one standard deviation). No more than OSC_MODEL_MAX_SKIPPED_CALS calibrations in a row are
+// skipped, so that the model keeps being checked against the GPS.
+bool osc_model_skip_calibration() {
+  if ((osc_skipped_cals >= OSC_MODEL_MAX_SKIPPED_CALS) || (osc_model_sigma_ppb() > OSC_MODEL_SKIP_CAL_PPB)) {
+    osc_skipped_cals = 0;
+    return false;
+  }
+  osc_skipped_cals++;
+  return true;
+}
@@ -0,0 +1,29 @@
+#ifndef ORIONOSCMODEL_H
+#define ORIONOSCMODEL_H
+/*
+    OrionOscModel.h - Kalman filter model of the Si5351a reference oscillator
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+
+void osc_model_reset(int32_t corr);
+void osc_model_time_update(uint32_t time_s, int temperature_c);
+void osc_model_measure(int32_t corr, uint32_t variance);
+int32_t osc_model_correction();
+uint16_t osc_model_sigma_ppb();
+bool osc_model_skip_calibration();
+#endif
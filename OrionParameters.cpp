@@ -0,0 +1,318 @@
+/*
+   OrionParameters.cpp - Runtime parameter store for the Orion WSPR Beacon
+
+   The parameters that used to require a rebuild to change (callsign, frequencies, Si5351a correction,
+   calibration steps, drive strength and the transmit slot table) are kept in g_params. They can be
+   displayed and changed from the Orion Serial Monitor with the list, get and set commands, and saved to
+   EEPROM with the save command. At boot the saved parameters are used if their CRC and version are valid,
+   otherwise we fall back to the compiled in defaults.
+
+   Each parameter is described by an entry in a typed table in PROGMEM, so adding a new parameter only requires
+   a new field in struct OrionParameters, a default in params_set_defaults() and a new table entry.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+#include "OrionBoardConfig.h"
+#include "OrionParameters.h"
+#include "OrionCalibration.h"
+#include "OrionSi5351.h"
+#include "OrionQrss.h"
+#include "OrionHal.h"
+#include <util/crc16.h>
+
+struct OrionParameters g_params;
+
+// A table entry describing one parameter. For PARAM_STR min and max are the allowed string lengths.
+struct OrionParamDesc {
+  const char *name;      // Name used by the get and set commands (in PROGMEM)
+  uint8_t type;          // OrionParamType
+  uint8_t offset;        // Offset of the field within struct OrionParameters
+  int32_t min;
+  int32_t max;
+};
+
+const char param_name_call[] PROGMEM = "call";
+const char param_name_freq[] PROGMEM = "freq";
+const char param_name_fixfreq[] PROGMEM = "fixfreq";
+const char param_name_qrssfreq[] PROGMEM = "qrssfreq";
+const char param_name_corr[] PROGMEM = "corr";
+const char param_name_finestep[] PROGMEM = "finestep";
+const char param_name_coarsestep[] PROGMEM = "coarsestep";
+const char param_name_drive[] PROGMEM = "drive";
+const char param_name_slots[] PROGMEM = "slots";
+const char param_name_qrssmode[] PROGMEM = "qrssmode";
+const char param_name_qrssspeed[] PROGMEM = "qrssspeed";
+const char param_name_freq2[] PROGMEM = "freq2";
+const char param_name_type3[] PROGMEM = "type3";
+const char param_name_telplan[] PROGMEM = "telplan";
+const char param_name_oscmodel[] PROGMEM = "oscmodel";
+const char param_name_txmon[] PROGMEM = "txmon";
+
+// Frequencies are limited to the range supported by si5351bx_setfreq()
+const struct OrionParamDesc param_table[] PROGMEM = {
+  {param_name_call,       PARAM_STR, offsetof(struct OrionParameters, callsign),             1,       10},
+  {param_name_freq,       PARAM_U32, offsetof(struct OrionParameters, beacon_freq_hz),       500000L, 109000000L},
+  {param_name_fixfreq,    PARAM_U32, offsetof(struct OrionParameters, fixed_beacon_freq_hz), 500000L, 109000000L},
+  {param_name_qrssfreq,   PARAM_U32, offsetof(struct OrionParameters, qrss_freq_hz),         500000L, 109000000L},
+  {param_name_corr,       PARAM_I32, offsetof(struct OrionParameters, si5351_correction),    -100000L, 100000L},
+  {param_name_finestep,   PARAM_U16, offsetof(struct OrionParameters, fine_cal_step),        1,       1000},
+  {param_name_coarsestep, PARAM_U16, offsetof(struct OrionParameters, coarse_cal_step),      1,       10000},
+  {param_name_drive,      PARAM_U8,  offsetof(struct OrionParameters, tx_drive),             0,       3},
+  {param_name_slots,      PARAM_U8,  offsetof(struct OrionParameters, tx_cycle_mask),        0,       TX_CYCLE_MASK_ALL},
+  {param_name_qrssmode,   PARAM_U8,  offsetof(struct OrionParameters, qrss_mode),            MODE_QRSS, NUM_QRSS_MODES - 1},
+  {param_name_qrssspeed,  PARAM_U8,  offsetof(struct OrionParameters, qrss_speed),           s12wpm,  QRSS10},
+  {param_name_type3,      PARAM_U8,  offsetof(struct OrionParameters, wspr_type3),           OFF,     ON},
+  {param_name_telplan,    PARAM_U8,  offsetof(struct OrionParameters, telemetry_planner),    OFF,     ON},
+  {param_name_oscmodel,   PARAM_U8,  offsetof(struct OrionParameters, osc_model),            OFF,     ON},
+  {param_name_txmon,      PARAM_U8,  offsetof(struct OrionParameters, tx_monitor),           OFF,     ON},
+#if defined (SI5351A_WSPRTX2_CLK_NUM)
+  {param_name_freq2,      PARAM_U32, offsetof(struct OrionParameters, beacon2_freq_hz),      500000L, 109000000L},
+#endif
+};
+
+#define NUM_PARAMS (sizeof(param_table) / sizeof(param_table[0]))
+
+static void read_param_desc(byte index, struct OrionParamDesc *desc) {
+  memcpy_P(desc, &param_table[index], sizeof(struct OrionParamDesc));
+}
+
+static uint16_t params_crc(const struct OrionParameters *p) {
+  uint16_t crc = 0xFFFF;
+  const uint8_t *b = (const uint8_t *)p;
+
+  for (byte i = 0; i < sizeof(struct OrionParameters); i++)
+    crc = _crc16_update(crc, b[i]);
+
+  return crc;
+}
+
+// Load the compiled in defaults
+void params_set_defaults() {
+  memset(&g_params, 0, sizeof(g_params));
+  g_params.version = PARAMS_VERSION;
+  strncpy(g_params.callsign, BEACON_CALLSIGN_6CHAR, sizeof(g_params.callsign) - 1);
+  g_params.beacon_freq_hz = BEACON_FREQ_HZ;
+  g_params.fixed_beacon_freq_hz = FIXED_BEACON_FREQ_HZ;
+  g_params.qrss_freq_hz = QRSS_BEACON_FREQ_HZ;
+  g_params.si5351_correction = SI5351A_CLK_FREQ_CORRECTION;
+  g_params.fine_cal_step = FINE_CORRECTION_STEP;
+  g_params.coarse_cal_step = COARSE_CORRECTION_STEP;
+  g_params.tx_drive = 3;
+  g_params.tx_cycle_mask = TX_CYCLE_MASK_ALL;
+  g_params.qrss_mode = QRSS_DEFAULT_MODE;
+  g_params.qrss_speed = QRSS_DEFAULT_SPEED;
+  g_params.beacon2_freq_hz = BEACON2_FREQ_HZ;
+  g_params.wspr_type3 = WSPR_TYPE3_INITIAL;
+  g_params.telemetry_planner = TELEMETRY_PLANNER_INITIAL;
+  g_params.osc_model = OSC_MODEL_INITIAL;
+  g_params.tx_monitor = TX_MONITOR_INITIAL;
+}
+
+// Load the parameters from EEPROM, falling back to the defaults if the EEPROM copy is invalid.
+// Returns true if the parameters came from EEPROM. Call once from setup() before anything uses g_params.
+bool params_begin() {
+  uint16_t crc;
+  bool from_eeprom = true;
+
+  hal_eeprom_read(EEPROM_PARAMS_ADDR, &g_params, sizeof(g_params));
+  hal_eeprom_read(EEPROM_PARAMS_ADDR + sizeof(struct OrionParameters), &crc, sizeof(crc));
+
+  if ((g_params.version != PARAMS_VERSION) || (crc != params_crc(&g_params))) {
+    params_set_defaults();
+    from_eeprom = false;
+  }
+
+  g_params.callsign[sizeof(g_params.callsign) - 1] = '\0';
+  set_calibration_correction(g_params.si5351_correction);
+  params_apply();
+  return from_eeprom;
+}
+
+// Save the parameters to EEPROM followed by their CRC. Only bytes that have changed are written.
+void params_save() {
+  uint16_t crc = params_crc(&g_params);
+
+  hal_eeprom_update(EEPROM_PARAMS_ADDR, &g_params, sizeof(g_params));
+  hal_eeprom_update(EEPROM_PARAMS_ADDR + sizeof(struct OrionParameters), &crc, sizeof(crc));
+}
+
+// Push the parameters that are cached elsewhere out to their users. The remaining parameters are read
+// directly from g_params when they are needed. The correction is not applied here because self-calibration
+// keeps refining it, it is only applied at boot and when it is explicitly set.
+void params_apply() {
+  si5351bx_drive[SI5351A_WSPRTX_CLK_NUM] = g_params.tx_drive;
+#if defined (SI5351A_WSPRTX2_CLK_NUM)
+  si5351bx_drive[SI5351A_WSPRTX2_CLK_NUM] = g_params.tx_drive;
+#elif defined (SI5351A_PUSH_PULL_CLK_NUM)
+  si5351bx_drive[SI5351A_PUSH_PULL_CLK_NUM] = g_params.tx_drive;
+#endif
+}
+
+byte params_count() {
+  return NUM_PARAMS;
+}
+
+// Copy the name of parameter index into name, returns false if index is out of range
+bool params_get_name(byte index, char *name, byte size) {
+  struct OrionParamDesc desc;
+
+  if (index >= NUM_PARAMS) return false;
+
+  read_param_desc(index, &desc);
+  strncpy_P(name, desc.name, size - 1);
+  name[size - 1] = '\0';
+  return true;
+}
+
+// Return the index of the named parameter or -1 if there is no such parameter
+int params_find(const char *name) {
+  struct OrionParamDesc desc;
+
+  for (byte i = 0; i < NUM_PARAMS; i++) {
+    read_param_desc(i, &desc);
+    if (strcmp_P(name, desc.name) == 0) return i;
+  }
+  return -1;
+}
+
+void params_print_value(byte index, Print &port) {
+  struct OrionParamDesc desc;
+  uint8_t *field;
+
+  if (index >= NUM_PARAMS) return;
+
+  read_param_desc(index, &desc);
+  field = (uint8_t *)&g_params + desc.offset;
+
+  switch (desc.type) {
+    case PARAM_U8 :
+      port.print(*field);
+      break;
+
+    case PARAM_U16 :
+      port.print(*(uint16_t *)field);
+      break;
+
+    case PARAM_U32 :
+      port.print(*(uint32_t *)field);
+      break;
+
+    case PARAM_I32 :
+      port.print(*(int32_t *)field);
+      break;
+
+    case PARAM_STR :
+      port.print((char *)field);
+      break;
+
+    default :
+      break;
+  }
+}
+
+void params_print_range(byte index, Print &port) {
+  struct OrionParamDesc desc;
+
+  if (index >= NUM_PARAMS) return;
+
+  read_param_desc(index, &desc);
+  port.print(desc.min);
+  port.print(F(".."));
+  port.print(desc.max);
+  if (desc.type == PARAM_STR) port.print(F(" chars"));
+}
+
+// Parse value and store it in parameter index. Returns false if the value is malformed or out of range,
+// in which case the parameter is left unchanged. The change takes effect immediately but is not saved.
+// Callsigns are letters and digits, up to 6 of them, or a compound callsign with a single '/' and either a prefix of 1 to 3
+// characters or a suffix of one character or two digits. These are what a WSPR Type 2 message can carry, see
+// wspr_pack_affix() in OrionTxMode.cpp.
+static bool valid_callsign(const char *call, byte len) {
+  const char *slash = strchr(call, '/');
+  byte before;
+  byte after;
+
+  for (byte i = 0; i < len; i++) {
+    if (!isalnum(call[i]) && (call[i] != '/')) return false;
+  }
+
+  if (slash == NULL) return (len <= 6);
+  if (strchr(slash + 1, '/') != NULL) return false;
+
+  before = slash - call;
+  after = len - before - 1;
+  if ((before == 0) || (after == 0)) return false;
+
+  if ((after == 1) || ((after == 2) && isdigit(slash[1]) && isdigit(slash[2])))
+    return (before <= 6);                    // Suffix
+
+  return (before <= 3) && (after <= 6);      // Prefix
+}
+
+bool params_set_value(byte index, const char *value) {
+  struct OrionParamDesc desc;
+  uint8_t *field;
+  char *end;
+  long v;
+  byte len;
+
+  if (index >= NUM_PARAMS) return false;
+
+  read_param_desc(index, &desc);
+  field = (uint8_t *)&g_params + desc.offset;
+
+  if (desc.type == PARAM_STR) {
+    len = strlen(value);
+    if ((len < desc.min) || (len > desc.max)) return false;
+
+    if (!valid_callsign(value, len)) return false;
+    for (byte i = 0; i <= len; i++)
+      field[i] = toupper(value[i]);
+  }
+  else {
+    v = strtol(value, &end, 0);
+    if ((end == value) || (*end != '\0')) return false;
+    if ((v < desc.min) || (v > desc.max)) return false;
+
+    switch (desc.type) {
+      case PARAM_U8 :
+        *field = (uint8_t)v;
+        break;
+
+      case PARAM_U16 :
+        *(uint16_t *)field = (uint16_t)v;
+        break;
+
+      case PARAM_U32 :
+        *(uint32_t *)field = (uint32_t)v;
+        break;
+
+      case PARAM_I32 :
+        *(int32_t *)field = (int32_t)v;
+        break;
+
+      default :
+        return false;
+    }
+  }
+
+  if (desc.offset == offsetof(struct OrionParameters, si5351_correction))
+    set_calibration_correction(g_params.si5351_correction);
+
+  params_apply();
+  return true;
+}
@@ -0,0 +1,69 @@
+#ifndef ORIONPARAMETERS_H
+#define ORIONPARAMETERS_H
+/*
+    OrionParameters.h - Definitions for the Orion runtime parameter store
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+
+// The parameters are saved in EEPROM following the EEPROM Log (see OrionPerfCounters.h)
+#define EEPROM_PARAMS_ADDR   16
+
+// Increment this whenever struct OrionParameters changes so that old EEPROM contents are ignored
+#define PARAMS_VERSION       10
+
+// All six 10 minute transmit cycles in the hour are enabled by default
+#define TX_CYCLE_MASK_ALL    0x3F
+
+// These are the parameters that can be changed at run time from the serial monitor with "set" and made
+// persistent with "save". The initial values come from OrionXConfig.h and OrionBoardConfig.h.
+struct OrionParameters {
+  uint8_t version;                 // PARAMS_VERSION
+  char callsign[11];               // Beacon callsign, maximum of 6 characters or 10 with a prefix or suffix
+  uint32_t beacon_freq_hz;         // Base frequency when QRM Avoidance is on (BEACON_FREQ_HZ)
+  uint32_t fixed_beacon_freq_hz;   // Frequency when QRM Avoidance is off (FIXED_BEACON_FREQ_HZ)
+  uint32_t qrss_freq_hz;           // QRSS beacon frequency (QRSS_BEACON_FREQ_HZ)
+  int32_t si5351_correction;       // Si5351a correction factor used at boot (SI5351A_CLK_FREQ_CORRECTION)
+  uint16_t fine_cal_step;          // Self-calibration correction step (FINE_CORRECTION_STEP)
+  uint16_t coarse_cal_step;        // Startup self-calibration correction step (COARSE_CORRECTION_STEP)
+  uint8_t tx_drive;                // Si5351a TX clock drive strength 0=2ma 1=4ma 2=6ma 3=8ma
+  uint8_t tx_cycle_mask;           // Slot table. Bit n enables the 10 minute transmit cycle starting at hh:n0
+  uint8_t qrss_mode;               // QrssMode used for the GPS LOS fallback beacon
+  uint8_t qrss_speed;              // QrssSpeed used for the GPS LOS fallback beacon
+  uint32_t beacon2_freq_hz;        // Second band frequency on dual band boards (BEACON2_FREQ_HZ)
+  uint8_t wspr_type3;              // ON to alternate Type 3 and Type 1 Primary WSPR-2 messages (WSPR_TYPE3_INITIAL)
+  uint8_t telemetry_planner;       // ON to let the telemetry planner pick the Telemetry messages (TELEMETRY_PLANNER_INITIAL)
+  uint8_t osc_model;               // ON to transmit with the correction predicted by the oscillator model (OSC_MODEL_INITIAL)
+  uint8_t tx_monitor;              // ON to monitor and correct the frequency during transmissions (TX_MONITOR_INITIAL)
+};
+
+enum OrionParamType {PARAM_U8, PARAM_U16, PARAM_U32, PARAM_I32, PARAM_STR};
+
+extern struct OrionParameters g_params;
+
+bool params_begin();
+void params_set_defaults();
+void params_save();
+void params_apply();
+byte params_count();
+bool params_get_name(byte index, char *name, byte size);
+int params_find(const char *name);
+void params_print_value(byte index, Print &port);
+void params_print_range(byte index, Print &port);
+bool params_set_value(byte index, const char *value);
+
+#endif
@@ -0,0 +1,215 @@
+/*
+   OrionPerfCounters.cpp - Runtime performance counters for the Orion WSPR Beacon
+
+   These counters are the primary field diagnostic. They are displayed with the 'p'
+   command in the Orion Serial Monitor and cleared with the 'r' command.
+
+   This file also implements the stack and heap high-water-mark monitoring. With only about 800 bytes
+   of SRAM left for the stack and the deep call chains in NeoGPS and DallasTemperature, a stack
+   overflow is a real risk and it shows up as a random reset. All of the free SRAM is painted with
+   STACK_CANARY before main() runs and we periodically scan for the lowest byte that has been overwritten.
+   The worst case is also kept in the EEPROM Log so that it survives the reset.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+#include "OrionPerfCounters.h"
+#include "OrionHal.h"
+
+#if defined(__AVR__)
+// Symbols provided by the linker and avr-libc malloc()
+extern uint8_t _end;            // First byte after .bss and .noinit, this is also the start of the heap
+extern uint8_t __stack;         // Initial stack pointer (RAMEND)
+extern char *__brkval;          // Current end of the heap, 0 if malloc() has never been called
+#endif
+
+volatile struct OrionIsrCounters g_isr_counts = {0, 0, 0, 0};
+struct OrionPerfCounters g_perf;
+
+static uint16_t eeprom_log_min_free_sram = 0xFFFF;   // Copy of the EEPROM Log value so we only write the EEPROM when it changes
+
+static uint32_t tx_start_i2c_transactions = 0;
+static uint16_t sleep_us_remainder = 0;
+static uint16_t loop_count = 0;
+static uint32_t loop_window_start_ms = 0;
+#if defined(__AVR__)
+static uint8_t *stack_low = NULL;     // Lowest SRAM byte the stack is known to have written, see perf_update_memory_hwm()
+#endif
+
+#if defined(__AVR__)
+// Paint all of the SRAM from the end of .bss up to the top of the stack with STACK_CANARY.
+// This runs in .init1, before the stack pointer has been initialized and before .data and .bss are set up,
+// so it has to be written in assembler and must not use the stack. The stack is completely unused at this point
+// so painting all the way up to __stack is safe.
+void paint_stack() __attribute__ ((naked)) __attribute__ ((used)) __attribute__ ((section (".init1")));
+void paint_stack() {
+  __asm volatile ("    ldi r30,lo8(_end)\n"
+                  "    ldi r31,hi8(_end)\n"
+                  "    ldi r24,%[canary]\n"
+                  "    ldi r25,hi8(__stack)\n"
+                  "    rjmp .paint_cmp\n"
+                  ".paint_loop:\n"
+                  "    st Z+,r24\n"
+                  ".paint_cmp:\n"
+                  "    cpi r30,lo8(__stack)\n"
+                  "    cpc r31,r25\n"
+                  "    brlo .paint_loop\n"
+                  "    breq .paint_loop" :: [canary] "M" (STACK_CANARY));
+}
+#endif
+
+// Clear all of the counters
+void perf_reset() {
+  noInterrupts();
+  g_isr_counts.timer2_compa = 0;
+  g_isr_counts.timer1_ovf = 0;
+  g_isr_counts.timer1_compb = 0;
+  g_isr_counts.pps = 0;
+  interrupts();
+
+  memset(&g_perf, 0, sizeof(g_perf));
+  tx_start_i2c_transactions = 0;
+  loop_count = 0;
+  loop_window_start_ms = millis();
+
+  // The painted SRAM can't be un-touched so the high-water mark is always measured since boot
+  perf_update_memory_hwm();
+}
+
+// Called once per pass through loop(). Every second we calculate the number of loop iterations per second.
+void perf_loop_tick() {
+  uint32_t elapsed_ms;
+
+  loop_count++;
+
+  elapsed_ms = millis() - loop_window_start_ms;
+  if (elapsed_ms >= 1000) {
+    // A long running action can stretch the window so we scale the count to one second
+    g_perf.loops_per_sec = (uint16_t)(((uint32_t)loop_count * 1000UL) / elapsed_ms);
+    loop_count = 0;
+    loop_window_start_ms = millis();
+
+    // Once per second is often enough to check the stack high-water mark
+    perf_update_memory_hwm();
+  }
+}
+
+// Remember the longest time taken to process each action returned by the state machine
+void perf_log_action_duration(OrionAction action, unsigned long duration_ms) {
+  if (action >= NUM_ORION_ACTIONS) return;
+
+  if (duration_ms > g_perf.max_action_ms[action])
+    g_perf.max_action_ms[action] = duration_ms;
+}
+
+// Bracket a transmission so that we can count the Si5351a I2C transactions that it required
+void perf_tx_start() {
+  tx_start_i2c_transactions = g_perf.i2c_transactions;
+}
+
+void perf_tx_end() {
+  g_perf.si5351_writes_last_tx = (uint16_t)(g_perf.i2c_transactions - tx_start_i2c_transactions);
+}
+
+// Accumulate the NeoGPS statistics. The caller is expected to clear the NeoGPS statistics after each call.
+void perf_add_gps_stats(uint32_t chars, uint32_t sentences, uint32_t errors) {
+  g_perf.gps_chars += chars;
+  g_perf.gps_sentences += sentences;
+  g_perf.gps_errors += errors;
+}
+
+// Accumulate time spent in idle sleep, which is measured in microseconds
+void perf_add_sleep_us(unsigned long sleep_us) {
+  sleep_us += sleep_us_remainder;
+  g_perf.sleep_ms += sleep_us / 1000;
+  sleep_us_remainder = sleep_us % 1000;
+}
+
+// Read the EEPROM Log, initializing it if this is the first boot, and count this boot
+void perf_eeprom_log_begin() {
+  struct OrionEepromLog log;
+
+  hal_eeprom_read(EEPROM_LOG_ADDR, &log, sizeof(log));
+
+  if (log.magic != EEPROM_LOG_MAGIC) {
+    log.magic = EEPROM_LOG_MAGIC;
+    log.boot_count = 0;
+    log.min_free_sram = 0xFFFF;
+  }
+
+  log.boot_count++;
+  hal_eeprom_update(EEPROM_LOG_ADDR, &log, sizeof(log));
+
+  eeprom_log_min_free_sram = log.min_free_sram;
+}
+
+void perf_get_eeprom_log(struct OrionEepromLog *log) {
+  hal_eeprom_read(EEPROM_LOG_ADDR, log, sizeof(*log));
+}
+
+#if defined(__AVR__)
+// Find the lowest SRAM byte that no longer holds STACK_CANARY, this is the stack high-water mark.
+// Called periodically and after each action. Everything above the last high-water mark is already known to be used,
+// so the scan starts there and works down until it finds STACK_CANARY_RUN untouched bytes in a row (a single byte
+// could just be stack data that happens to equal STACK_CANARY). It usually stops straight away.
+void perf_update_memory_hwm() {
+  uint8_t *heap_end;
+  uint8_t *p;
+  uint8_t run = 0;
+  uint16_t free_sram;
+
+  if (__brkval == 0)
+    heap_end = &_end;
+  else
+    heap_end = (uint8_t *)__brkval;
+
+  g_perf.heap_bytes = (uint16_t)(heap_end - &_end);
+
+  // The bytes above the stack pointer are in use now
+  if ((stack_low == NULL) || (stack_low > (uint8_t *)SP + 1)) stack_low = (uint8_t *)SP + 1;
+
+  p = stack_low;
+  while ((p > heap_end) && (run < STACK_CANARY_RUN)) {
+    p--;
+    if (*p == STACK_CANARY)
+      run++;
+    else {
+      run = 0;
+      stack_low = p;
+    }
+  }
+  if (stack_low < heap_end) stack_low = heap_end;   // The heap has grown into what the stack used
+  p = stack_low;
+
+  free_sram = (uint16_t)(p - heap_end);
+
+  if ((uint16_t)(&__stack - p + 1) > g_perf.stack_hwm_bytes)
+    g_perf.stack_hwm_bytes = (uint16_t)(&__stack - p + 1);
+
+  if ((g_perf.min_free_sram == 0) || (free_sram < g_perf.min_free_sram))
+    g_perf.min_free_sram = free_sram;
+
+  // Only write the EEPROM when we have a new worst case, this limits EEPROM wear
+  if (free_sram < eeprom_log_min_free_sram) {
+    eeprom_log_min_free_sram = free_sram;
+    hal_eeprom_update(EEPROM_LOG_ADDR + offsetof(struct OrionEepromLog, min_free_sram), &free_sram, sizeof(free_sram));
+  }
+}
+#else
+// There is no painted stack to measure in a host build (OrionHal.h mock)
+void perf_update_memory_hwm() {
+}
+#endif
@@ -0,0 +1,80 @@
+#ifndef ORIONPERFCOUNTERS_H
+#define ORIONPERFCOUNTERS_H
+/*
+    OrionPerfCounters.h - Definitions for Orion runtime performance counters
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+#include "OrionStateMachine.h"
+
+// Free SRAM between the heap and the stack is painted with this pattern at boot so that we can
+// find the deepest point that the stack has reached (the high-water mark).
+#define STACK_CANARY 0xC5
+#define STACK_CANARY_RUN 4    // Untouched bytes in a row that end the high-water mark scan
+
+// The EEPROM Log survives resets and power cycles. It records the number of boots and the smallest amount of
+// free SRAM ever seen, so that a stack overflow induced reset can be diagnosed after the fact.
+#define EEPROM_LOG_ADDR   0           // EEPROM address of struct OrionEepromLog
+#define EEPROM_LOG_MAGIC  0x4F4CU     // "OL"
+
+struct OrionEepromLog {
+  uint16_t magic;                    // EEPROM_LOG_MAGIC when the log has been initialized
+  uint16_t boot_count;               // Incremented on every reset
+  uint16_t min_free_sram;            // Smallest number of untouched bytes between the heap and the stack, over all boots
+};
+
+// Counters incremented from ISRs. These are multi-byte so they must be read with interrupts disabled.
+struct OrionIsrCounters {
+  uint32_t timer2_compa;     // ISR(TIMER2_COMPA_vect) - WSPR symbols (one per symbol, not per timer period)
+  uint32_t timer1_ovf;       // ISR(TIMER1_OVF_vect) - Calibration counter overflow
+  uint32_t timer1_compb;     // ISR(TIMER1_COMPB_vect) - QRSS keyer
+  uint32_t pps;              // GPS PPS interrupts (External or PinChange interrupt)
+};
+
+// Counters only ever updated from the main loop.
+struct OrionPerfCounters {
+  uint32_t i2c_transactions;         // Number of I2C transactions to the Si5351a
+  uint32_t i2c_bytes;                // Number of bytes written to the Si5351a (excluding the address byte)
+  uint16_t i2c_nacks;                // I2C writes to the Si5351a that were NACKed (or failed), including retries
+  uint16_t i2c_failures;             // I2C writes that still failed after SI5351_I2C_RETRIES retries
+  uint16_t si5351_writes_last_tx;    // I2C transactions used by the most recent WSPR or QRSS transmission
+  uint32_t gps_chars;                // Characters received from the GPS
+  uint32_t gps_sentences;            // NMEA sentences successfully parsed
+  uint32_t gps_errors;               // NMEA sentences with checksum (or other) errors
+  uint16_t loops_per_sec;            // Iterations of loop() per second, measured over the last second
+  uint32_t sleep_ms;                 // Time spent with the processor asleep
+  uint32_t max_action_ms[NUM_ORION_ACTIONS]; // Longest observed run time for each OrionAction
+  uint16_t stack_hwm_bytes;          // Deepest stack usage seen since boot (RAMEND down to the lowest touched byte)
+  uint16_t min_free_sram;            // Smallest number of untouched bytes between the heap and the stack since boot
+  uint16_t heap_bytes;               // Current heap size
+};
+
+extern volatile struct OrionIsrCounters g_isr_counts;
+extern struct OrionPerfCounters g_perf;
+
+void perf_reset();
+void perf_loop_tick();
+void perf_log_action_duration(OrionAction action, unsigned long duration_ms);
+void perf_tx_start();
+void perf_tx_end();
+void perf_add_gps_stats(uint32_t chars, uint32_t sentences, uint32_t errors);
+void perf_add_sleep_us(unsigned long sleep_us);
+void perf_eeprom_log_begin();
+void perf_update_memory_hwm();
+void perf_get_eeprom_log(struct OrionEepromLog *log);
+
+#endif
@@ -30,274 +30,508 @@
 #include "OrionQrss.h"
 #include <Chrono.h>
 #include "OrionSerialMonitor.h"
-
-const char msg[] = QRSS_MESSAGE; // Defined in OrionQrss.h
+#include "OrionPerfCounters.h"
+#include "OrionParameters.h"
+#include "OrionHal.h"
 
 // This array is indexed by a parameter of type QrssSpeed, defined in OrionXConfig.h
 const unsigned int speeds[] = {1, 30, 60, 100};   // Speeds for: s12wpm, QRSS3, QRSS6, QRSS10
 
+/*
+   Compile time Morse encoding of QRSS_MESSAGE
 
-byte charCode(char c) {
-
-  // This function returns the encoded CW pattern for the character passed in.
-  // Binary encoding is left-padded. Unused high-order bits are all ones.
-  // The first zero is the start bit, which is discarded.
-  // Processing from higher to lower order, bits we skip over ones, then discard first 0 (start bit). The next bit is the first element.
-  // We process each element sending a DIT or DAH, until we reach the end of the pattern.
-  //
-  // Pattern encoding is 0 = DIT, 1 = DAH.
-  // So 'A' = B11111001, which is 1 1 1 1 1 (padding bits) 0 (start bit)  0 1 (dit, dah)
-  // This excellent encoding scheme was developed by Hans, G0UPL as noted above.
-
-  switch (c)
-  {
-    case 'A':  return B11111001; break;    // A  .-
-    case 'B':  return B11101000; break;    // B  -...
-    case 'C':  return B11101010; break;    // C  -.-.
-    case 'D':  return B11110100; break;    // D  -..
-    case 'E':  return B11111100; break;    // E  .
-    case 'F':  return B11100010; break;    // F  ..-.
-    case 'G':  return B11110110; break;    // G  --.
-    case 'H':  return B11100000; break;    // H  ....
-    case 'I':  return B11111000; break;    // I  ..
-    case 'J':  return B11100111; break;    // J  .---
-    case 'K':  return B11110101; break;    // K  -.-
-    case 'L':  return B11100100; break;    // L  .-..
-    case 'M':  return B11111011; break;    // M  --
-    case 'N':  return B11111010; break;    // N  -.
-    case 'O':  return B11110111; break;    // O  ---
-    case 'P':  return B11100110; break;    // P  .--.
-    case 'Q':  return B11101101; break;    // Q  --.-
-    case 'R':  return B11110010; break;    // R  .-.
-    case 'S':  return B11110000; break;    // S  ...
-    case 'T':  return B11111101; break;    // T  -
-    case 'U':  return B11110001; break;    // U  ..-
-    case 'V':  return B11100001; break;    // V  ...-
-    case 'W':  return B11110011; break;    // W  .--
-    case 'X':  return B11101001; break;    // X  -..-
-    case 'Y':  return B11101011; break;    // Y  -.--
-    case 'Z':  return B11101100; break;    // Z  --..
-    case '0':  return B11011111; break;    // 0  -----
-    case '1':  return B11001111; break;    // 1  .----
-    case '2':  return B11000111; break;    // 2  ..---
-    case '3':  return B11000011; break;    // 3  ...--
-    case '4':  return B11000001; break;    // 4  ....-
-    case '5':  return B11000000; break;    // 5  .....
-    case '6':  return B11010000; break;    // 6  -....
-    case '7':  return B11011000; break;    // 7  --...
-    case '8':  return B11011100; break;    // 8  ---..
-    case '9':  return B11011110; break;    // 9  ----.
-    case ' ':  return B11101111; break;    // Space - equal to 4 dah lengths
-    case '/':  return B11010010; break;    // /  -..-.
-    default: return charCode(' ');
-  }
+   The message is a constant so rather than decoding it at run time we use C++11 constexpr functions to turn it
+   into a stream of keyer elements, packed two per byte in PROGMEM. The keyer ISR just walks this stream.
+
+   Each character is encoded as a pattern byte. Binary encoding is left-padded. Unused high-order bits are all ones.
+   The first zero is the start bit, which is discarded. The bits after the start bit are the elements, processed from
+   higher to lower order, 0 = DIT, 1 = DAH. So 'A' = B11111001, which is 1 1 1 1 1 (padding bits) 0 (start bit) 0 1 (dit, dah).
+   This excellent encoding scheme was developed by Hans, G0UPL as noted above.
+
+   A character becomes its elements, each followed by QRSS_ELEM_GAP, except the last which is followed by QRSS_CHAR_GAP.
+   A space (or any character that can't be sent) becomes QRSS_WORD_SPACE. The stream ends with QRSS_ELEM_END.
+*/
+enum QrssElement {QRSS_ELEM_END, QRSS_ELEM_DIT, QRSS_ELEM_DAH, QRSS_ELEM_GAP, QRSS_CHAR_GAP, QRSS_WORD_SPACE};
+
+constexpr char qrss_message[] = QRSS_MESSAGE;  // Defined in OrionQrss.h
+
+#define MORSE_CHARSET "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789/"
+#define MORSE_PATTERNS \
+  B11111001, B11101000, B11101010, B11110100, B11111100, B11100010, B11110110, B11100000,  /* A B C D E F G H */ \
+  B11111000, B11100111, B11110101, B11100100, B11111011, B11111010, B11110111, B11100110,  /* I J K L M N O P */ \
+  B11101101, B11110010, B11110000, B11111101, B11110001, B11100001, B11110011, B11101001,  /* Q R S T U V W X */ \
+  B11101011, B11101100,                                                                    /* Y Z */ \
+  B11011111, B11001111, B11000111, B11000011, B11000001, B11000000, B11010000, B11011000,  /* 0 1 2 3 4 5 6 7 */ \
+  B11011100, B11011110,                                                                    /* 8 9 */ \
+  B11010010                                                                                /* / */
+
+constexpr char morse_chars[] = MORSE_CHARSET;
+constexpr uint8_t morse_patterns[] = {MORSE_PATTERNS};
+#define MORSE_SPACE B11101111   // Also used for characters that can't be sent
+
+// The pattern for character c
+constexpr uint8_t morse_pattern(char c, uint8_t i = 0) {
+  return (morse_chars[i] == '\0') ? MORSE_SPACE :
+         (morse_chars[i] == c) ? morse_patterns[i] : morse_pattern(c, i + 1);
 }
 
+// Bit position of the start bit, this is also the number of elements in the character
+constexpr uint8_t morse_start_bit(uint8_t pattern, uint8_t bit = 7) {
+  return (pattern & (1 << bit)) ? morse_start_bit(pattern, bit - 1) : bit;
+}
 
+// Number of keyer elements for character c (each dit or dah plus its following gap)
+constexpr uint16_t morse_char_elements(char c) {
+  return (morse_pattern(c) == MORSE_SPACE) ? 1 : 2 * morse_start_bit(morse_pattern(c));
+}
 
-void setRfFsk(boolean rf_on, boolean setFSK_high)
-{
-  uint8_t fsk_value;
+// Element k of character c
+constexpr uint8_t morse_char_element(char c, uint16_t k) {
+  return (morse_pattern(c) == MORSE_SPACE) ? QRSS_WORD_SPACE :
+         (k & 1) ? (((k / 2) == (morse_start_bit(morse_pattern(c)) - 1U)) ? QRSS_CHAR_GAP : QRSS_ELEM_GAP) :
+         ((morse_pattern(c) >> (morse_start_bit(morse_pattern(c)) - 1 - (k / 2))) & 1) ? QRSS_ELEM_DAH : QRSS_ELEM_DIT;
+}
 
-  if (setFSK_high == true) {
-    fsk_value = FSK_HIGH;
-  }
-  else {
-    fsk_value = FSK_LOW;
-  }
+// Element k of the message, starting the search at character i
+constexpr uint8_t qrss_element(uint16_t k, uint8_t i = 0) {
+  return (qrss_message[i] == '\0') ? (uint8_t)QRSS_ELEM_END :
+         (k < morse_char_elements(qrss_message[i])) ? morse_char_element(qrss_message[i], k) :
+         qrss_element(k - morse_char_elements(qrss_message[i]), i + 1);
+}
 
-  if (rf_on == true) {
-    si5351bx_setfreq(SI5351A_WSPRTX_CLK_NUM, ((QRSS_BEACON_FREQ_HZ + fsk_value) * 100ULL), SI5351_CLK_ON );
-  }
-  else {
-    si5351bx_enable_clk(SI5351A_WSPRTX_CLK_NUM, SI5351_CLK_OFF); // Disable the TX clock
-  }
+// Number of elements in the message, including QRSS_ELEM_END
+constexpr uint16_t qrss_element_count(uint8_t i = 0) {
+  return (qrss_message[i] == '\0') ? 1 : morse_char_elements(qrss_message[i]) + qrss_element_count(i + 1);
 }
 
+// Byte n of the packed stream, the first element of each pair is in the low nibble
+constexpr uint8_t qrss_stream_byte(uint16_t n) {
+  return qrss_element(2 * n) | (qrss_element(2 * n + 1) << 4);
+}
 
-//
-bool qrss_transmit(QrssMode mode, QrssSpeed ditSpeed)
-{
-  static byte timerCounter;              // Counter to get to divide by 100 to get 10Hz
-  static int ditCounter;                 // Counter to time the length of each dit
-  static byte pause;                     // Generates the pause between characters
-  static byte msgIndex = 255;            // Index into the message
-  static byte character;                 // Bit pattern for the character being sent
-  static byte key;                       // State of the key
-  static byte charBit;                   // Which bit of the bit pattern is being sent
-
-  static boolean dah;                    // True when a dah is being sent
-  byte divisor;                          // Divide 1kHz by 100 normally, but by 33 when sending DFCW)
-  bool transmission_done = false;
-
-  // Set Divisor based on Mode
-  if (mode == MODE_DFCW)                 // Divisor is 33 for DFCW, to get the correct timing
-    divisor = 33;                        // (inter-symbol gap is 1/3 of a dit)
-  else
-    divisor = 100;                      // For ever other mode it is one dit length
+#define QRSS_STREAM_BYTES ((qrss_element_count() + 1) / 2)
 
+static_assert(QRSS_STREAM_BYTES < 256, "QRSS_MESSAGE is too long");
 
-  timerCounter++;                        // 1000Hz at this point
+// An index sequence 0..N-1 so that the stream can be generated as an array initializer
+template <uint16_t... I> struct QrssIndexSeq {};
+template <uint16_t N, uint16_t... I> struct QrssMakeIndexSeq : QrssMakeIndexSeq < N - 1, N - 1, I... > {};
+template <uint16_t... I> struct QrssMakeIndexSeq<0, I...> {
+  typedef QrssIndexSeq<I...> type;
+};
 
-  if (timerCounter == divisor)           // Divides by 100 (or 33 for DFCW)
-  {
-    timerCounter = 0;                    // 10 Hz here (30Hz for DFCW)
-    ditCounter++;                        // Generates the correct dit-length
+struct QrssStream {
+  uint8_t bytes[QRSS_STREAM_BYTES];
+};
 
-    if (ditCounter >= speeds[ditSpeed]) { // We have counted the duration of a dit
+template <uint16_t... I> constexpr struct QrssStream make_qrss_stream(QrssIndexSeq<I...>) {
+  return {{qrss_stream_byte(I)...}};
+}
 
-      ditCounter = 0;
+// The packed element stream, this is all that remains of QRSS_MESSAGE at run time
+const struct QrssStream qrss_stream PROGMEM = make_qrss_stream(QrssMakeIndexSeq<QRSS_STREAM_BYTES>::type());
 
-      if (!pause) {
-        // Pause is set to 2 after the last element of the character has been sent
-        key--;                         // This generates the correct pause between characters (3 dits)
-        if ((!key) && (!charBit)) {
 
-          if (mode == MODE_DFCW)
-            pause = 3;                 // DFCW needs an extra delay to make it 4/3 dit-length
-          else
-            pause = 2;
-        }
-      } // end if (!pause)
-      else
-        pause--;
+// Characters that can be sent, in font/alphabet order, and their Morse patterns for qrss_encode_stream()
+const char qrss_charset[] PROGMEM = MORSE_CHARSET;
+const uint8_t qrss_patterns[] PROGMEM = {MORSE_PATTERNS};
 
+// The message text for the engines that don't use the Morse element stream
+const char qrss_message_text[] PROGMEM = QRSS_MESSAGE;
 
-      // Key becomes 255 when the last element (dit or dah) of the character has been sent
-      if (key == 255) {
+/*
+   5x7 font for FSK Hell, in qrss_charset order. Each character is 5 columns, bit 0 is the top row.
+   A Hell column is sent by sweeping up through the 7 tones, bottom row first, with the RF on only
+   for the pixels that are set. Each character is followed by a blank column.
+*/
+#define HELL_ROWS    7
+#define HELL_COLUMNS 5
+
+const uint8_t hell_font[][HELL_COLUMNS] PROGMEM = {
+  {0x7E, 0x11, 0x11, 0x11, 0x7E}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22}, // A B C
+  {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x09, 0x01}, // D E F
+  {0x3E, 0x41, 0x49, 0x49, 0x7A}, {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00}, // G H I
+  {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, {0x7F, 0x40, 0x40, 0x40, 0x40}, // J K L
+  {0x7F, 0x02, 0x0C, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E}, // M N O
+  {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46}, // P Q R
+  {0x46, 0x49, 0x49, 0x49, 0x31}, {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F}, // S T U
+  {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x3F, 0x40, 0x38, 0x40, 0x3F}, {0x63, 0x14, 0x08, 0x14, 0x63}, // V W X
+  {0x07, 0x08, 0x70, 0x08, 0x07}, {0x61, 0x51, 0x49, 0x45, 0x43},                                 // Y Z
+  {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00}, {0x42, 0x61, 0x51, 0x49, 0x46}, // 0 1 2
+  {0x21, 0x41, 0x45, 0x4B, 0x31}, {0x18, 0x14, 0x12, 0x7F, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39}, // 3 4 5
+  {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03}, {0x36, 0x49, 0x49, 0x49, 0x36}, // 6 7 8
+  {0x06, 0x49, 0x49, 0x29, 0x1E}, {0x20, 0x10, 0x08, 0x04, 0x02}                                  // 9 /
+};
+
+// MFSK4 slow telemetry. Each character is sent as 3 base 4 symbols (most significant first) on 4 tones.
+// The symbol value is 0 for a space and 1 + the qrss_charset position for the other characters.
+// The message is preceded by a fixed sync pattern so that the character boundaries can be found.
+#define MFSK_SYMBOLS_PER_CHAR 3
+const uint8_t mfsk_sync[] PROGMEM = {0, 3, 0, 3};
+
+// QRSS keyer state, see qrss_start() and qrss_service()
+enum QrssState {QRSS_IDLE, QRSS_KEYING};
+
+// The tone produced by the keyer ISR is an index into qrss_msynth[], or QRSS_TONE_OFF for no RF output
+#define QRSS_TONE_OFF  0xFF
+#define QRSS_NO_GLYPH  0xFF    // qrss_char_index() of a character that can't be sent
+#define QRSS_MAX_TONES HELL_ROWS
+
+// A slow mode engine. The keyer ISR calls next_segment() at the end of each segment, it sets qrss_tone and
+// qrss_units_left for the next segment (or qrss_msg_done). One unit is unit_ms milliseconds for each tenth of a
+// second in speeds[], so for the CW modes one unit is one dit.
+struct QrssEngine {
+  uint8_t unit_ms;               // Unit length in ms per 0.1 s of dit length
+  uint8_t num_tones;             // Number of tones, each needs a multisynth register image
+  uint16_t tone_spacing_chz;     // Spacing between tones in hundredths of a hertz
+  void (*next_segment)();
+};
+
+static void cw_next_segment();
+static void hell_next_segment();
+static void mfsk_next_segment();
+
+// Indexed by QrssMode. The DFCW unit is 1/3 of a dit (dits and dahs are the same length and the gap between them
+// is 1/3 of a dit). A Hell column (7 pixels) takes one dit.
+const struct QrssEngine qrss_engines[] PROGMEM = {
+  {100, 0, 0, cw_next_segment},                                          // MODE_NONE (not keyed)
+  {100, 1, 0, cw_next_segment},                                          // MODE_QRSS
+  {100, 2, (FSK_HIGH - FSK_LOW) * 100, cw_next_segment},                 // MODE_FSKCW
+  {33,  2, (FSK_HIGH - FSK_LOW) * 100, cw_next_segment},                 // MODE_DFCW
+  {100 / HELL_ROWS, HELL_ROWS, QRSS_HELL_TONE_SPACING_CHZ, hell_next_segment}, // MODE_FSKHELL
+  {100, 4, QRSS_MFSK_TONE_SPACING_CHZ, mfsk_next_segment},               // MODE_MFSK4
+};
+
+// Durations (in units) and tones for each Morse element, indexed by QrssElement - 1, for each of the CW modes
+#define QRSS_NUM_ELEMENTS 5
+
+struct QrssCwMode {
+  uint8_t durations[QRSS_NUM_ELEMENTS];
+  uint8_t tones[QRSS_NUM_ELEMENTS];
+};
+
+// Indexed by QrssMode             DIT DAH GAP CHAR_GAP WORD_SPACE
+const struct QrssCwMode qrss_cw_modes[] PROGMEM = {
+  {{1, 3, 1, 3, 4}, {QRSS_TONE_OFF, QRSS_TONE_OFF, QRSS_TONE_OFF, QRSS_TONE_OFF, QRSS_TONE_OFF}}, // MODE_NONE
+  {{1, 3, 1, 3, 4}, {0, 0, QRSS_TONE_OFF, QRSS_TONE_OFF, QRSS_TONE_OFF}},   // MODE_QRSS - the RF output is keyed
+  {{1, 3, 1, 3, 4}, {1, 1, 0, 0, 0}},                                       // MODE_FSKCW - RF always on, FSK keyed
+  {{3, 3, 1, 4, 4}, {0, 1, QRSS_TONE_OFF, QRSS_TONE_OFF, QRSS_TONE_OFF}},   // MODE_DFCW - RF keyed, dahs on the high tone
+};
+
+static QrssState qrss_state = QRSS_IDLE;
+static struct QrssCwMode qrss_cw_mode;
+
+// Multisynth register images for each tone. These are calculated once in qrss_start() so that a tone change
+// is at most a short I2C write of the bytes that differ plus a clock enable, with no 64 bit arithmetic.
+static uint8_t qrss_msynth[QRSS_MAX_TONES][8];
+static bool qrss_rf_on;                // Current state of the Si5351a TX clock output
+
+// These are shared with the keyer ISR
+static void (*qrss_next_segment)();
+static volatile byte qrss_tone = QRSS_TONE_OFF;
+static volatile bool qrss_tone_changed = false;
+static volatile bool qrss_msg_done = false;
+static volatile byte qrss_units_left;
+static volatile byte qrss_postscale;
+static volatile byte qrss_postscale_count;
+static const uint8_t *qrss_src;        // Element stream for the CW engines, message text for the others
+static bool qrss_src_in_ram;           // qrss_src is a message composed at run time rather than in PROGMEM
+static volatile uint16_t qrss_index;   // Next element or next character of qrss_src
+static volatile byte qrss_glyph;       // Hell font index of the current character
+static volatile byte qrss_column;      // Hell column, or MFSK symbol within the character
+static volatile byte qrss_row;         // Hell row
+
+// Set the output tone, only writing to the Si5351a what actually changes
+static void qrss_set_tone(byte tone)
+{
+  if (tone == QRSS_TONE_OFF) {
+    if (qrss_rf_on == true)
+      si5351bx_enable_clk(SI5351A_WSPRTX_CLK_NUM, SI5351_CLK_OFF); // Disable the TX clock
+    qrss_rf_on = false;
+    return;
+  }
 
-        // Done sending the last element (dit or dah) in the character
-        // If the last symbol of the character has been sent, get the next character
+  si5351bx_update_msynth(SI5351A_WSPRTX_CLK_NUM, qrss_msynth[tone]);
 
-        if (!charBit) {
-          // Increment the message character index
-          msgIndex++;
+  if (qrss_rf_on == false)
+    si5351bx_enable_clk(SI5351A_WSPRTX_CLK_NUM, SI5351_CLK_ON);
+  qrss_rf_on = true;
+}
 
-          // If we are at the end of the message flag transmission_done
-          if (!msg[msgIndex]) {
-            msgIndex = 0;
-            transmission_done = true;
-          }
-          else {
+// Return the position of c in qrss_charset or QRSS_NO_GLYPH if it can't be sent
+static uint8_t qrss_char_index(char c) {
+  const char *p;
 
-            // Get the encoded bit pattern for the morse character
-            character = charCode(msg[msgIndex]);
-            // Start at the 7'th (leftmost) bit of the bit pattern
-            charBit = 7;
+  if (c == '\0') return QRSS_NO_GLYPH;
+  p = strchr_P(qrss_charset, c);
+  return (p == NULL) ? QRSS_NO_GLYPH : (uint8_t)(p - qrss_charset);
+}
 
-            // Loop through bits looking for a 0, signifying start of coding bits
-            while (character & (1 << charBit)) charBit--;
-          }
+// Byte i of the element stream or message text
+static uint8_t qrss_src_byte(uint16_t i) {
+  return qrss_src_in_ram ? qrss_src[i] : pgm_read_byte(&qrss_src[i]);
+}
 
-        } // end if (!charBit)
+// Store element e at position n of a packed element stream
+static void qrss_put_element(uint8_t *buf, uint16_t n, uint8_t e) {
+  if (n & 1)
+    buf[n >> 1] |= e << 4;
+  else
+    buf[n >> 1] = e;
+}
 
-        charBit--;                     // Move to the next rightermost bit of the pattern, this is the first element
+// Run time equivalent of the compile time encoding of QRSS_MESSAGE, used for messages composed from telemetry.
+// Characters that don't fit in size bytes are dropped, the stream always ends with QRSS_ELEM_END.
+static void qrss_encode_stream(const char *text, uint8_t *buf, uint8_t size) {
+  uint16_t n = 0;
+  uint16_t max_elements = (2 * size) - 1;   // Leave room for QRSS_ELEM_END
+  uint8_t idx;
+  uint8_t pattern;
+  uint8_t bits;
+
+  for (; *text != '\0'; text++) {
+    idx = qrss_char_index(*text);
+    pattern = (idx == QRSS_NO_GLYPH) ? MORSE_SPACE : pgm_read_byte(&qrss_patterns[idx]);
+
+    if (pattern == MORSE_SPACE) {
+      if (n + 1 > max_elements) break;
+      qrss_put_element(buf, n++, QRSS_WORD_SPACE);
+      continue;
+    }
 
+    bits = morse_start_bit(pattern);
+    if (n + (2 * bits) > max_elements) break;
 
-        if ((transmission_done == true) || (character == charCode(' ') )) { // Special case for space
-          key = 0;
-          dah = false;
-        }
-        else {
-          // Get the state of the current bit in the pattern
-          key = character & (1 << charBit);
+    while (bits--) {
+      qrss_put_element(buf, n++, ((pattern >> bits) & 1) ? QRSS_ELEM_DAH : QRSS_ELEM_DIT);
+      qrss_put_element(buf, n++, bits ? QRSS_ELEM_GAP : QRSS_CHAR_GAP);
+    }
+  }
 
-          if (key) {                     // If it's a 1, set this to a dah
-            key = 3;
-            dah = true;
-          }
-          else {                        // otherwise it's a dit
-            if (mode == MODE_DFCW)     // Special case for DFCW - dit's and dah's are both
-              key = 3;                 // the same length.
-            else
-              key = 1;
+  qrss_put_element(buf, n, QRSS_ELEM_END);
+}
 
-            dah = false;
-          }
-        }
-      } // end if (key == 255 )
+static void qrss_end_of_message() {
+  qrss_msg_done = true;
+  qrss_tone = QRSS_TONE_OFF;
+  qrss_units_left = 1;
+}
 
-      if (!key) dah = false;
+// CW engines (QRSS, FSKCW and DFCW) : send the next element of the Morse element stream
+static void cw_next_segment() {
+  uint8_t element;
 
+  element = qrss_src_byte(qrss_index >> 1);
+  if (qrss_index & 1) element >>= 4;
+  element &= 0x0F;
 
-      //
-      if (mode == MODE_FSKCW)
-      {
-        //setRF(true);                    // in FSK/CW mode, the RF output is always ON
-        //setFSK(key);                    // and the FSK depends on the key state
-        setRfFsk(true, key);
-      }
-      else if (mode == MODE_QRSS)
-      {
-        //setRF(key);                     // in QRSS mode, the RF output is keyed
-        //setFSK(false);                  // and the FSK is always off
-        setRfFsk(key, false);
-      }
-      else if (mode == MODE_DFCW)
-      {
-        //setRF(key);                     // in DFCW mode, the RF output is keyed (ON during a dit or a dah)
-        //setFSK(dah);                    // and the FSK depends on the key state
-        setRfFsk(key, dah);
-      }
-      else
-        setRfFsk(false, false);
+  if (element == QRSS_ELEM_END) {
+    qrss_end_of_message();
+    return;
+  }
+
+  qrss_index++;
+  qrss_units_left = qrss_cw_mode.durations[element - 1];
+  qrss_tone = qrss_cw_mode.tones[element - 1];
+}
+
+// FSK Hell engine : send the next pixel, one unit per pixel
+static void hell_next_segment() {
+  char c;
+  uint8_t column_bits;
+
+  if ((qrss_column == 0) && (qrss_row == 0)) {
+    c = qrss_src_byte(qrss_index);
+    if (c == '\0') {
+      qrss_end_of_message();
+      return;
+    }
+    qrss_index++;
+    qrss_glyph = qrss_char_index(c);
+  }
+
+  if ((qrss_column < HELL_COLUMNS) && (qrss_glyph != QRSS_NO_GLYPH))
+    column_bits = pgm_read_byte(&hell_font[qrss_glyph][qrss_column]);
+  else
+    column_bits = 0;        // Space, unsupported character or the blank column between characters
 
-    } // end if (ditcounter >= speeds[ditspeed];
+  // Row 0 is the bottom of the character (font bit 6) on the lowest tone
+  qrss_tone = (column_bits & (1 << (HELL_ROWS - 1 - qrss_row))) ? qrss_row : QRSS_TONE_OFF;
+  qrss_units_left = 1;
 
-  } // end if (timercounter == divisor)
+  if (++qrss_row == HELL_ROWS) {
+    qrss_row = 0;
+    if (++qrss_column > HELL_COLUMNS) qrss_column = 0;
+  }
+}
+
+// MFSK4 engine : send the sync pattern and then each character as 3 base 4 symbols, one unit per symbol
+static void mfsk_next_segment() {
+  char c;
+  uint8_t value;
 
+  qrss_units_left = 1;
 
-  if (transmission_done == true) {
-    // reset the static variables for the next transmission
-    timerCounter = 0;
-    ditCounter = 0;
-    pause = 0;
-    msgIndex = 255;
-    character = 0;
-    key = 0;
-    charBit = 0;
-    dah = false;
+  if (qrss_row < sizeof(mfsk_sync)) {
+    qrss_tone = pgm_read_byte(&mfsk_sync[qrss_row++]);
+    return;
   }
 
-  return transmission_done;
+  c = qrss_src_byte(qrss_index);
+  if (c == '\0') {
+    qrss_end_of_message();
+    return;
+  }
 
-} // end qrss_transmit function
+  value = qrss_char_index(c);
+  value = (value == QRSS_NO_GLYPH) ? 0 : value + 1;   // 0 for a space or a character that can't be sent
+  qrss_tone = (value >> (2 * (MFSK_SYMBOLS_PER_CHAR - 1 - qrss_column))) & 0x03;
 
+  if (++qrss_column == MFSK_SYMBOLS_PER_CHAR) {
+    qrss_column = 0;
+    qrss_index++;
+  }
+}
+
+// Timer1 runs in CTC mode with OCR1A as TOP, firing once per keyer unit (or once per 1/qrss_postscale of a unit when
+// a unit is too long for the 16 bit timer), see hal_timer1_start_ctc(). WSPR symbols are timed by Timer2, Timer1 is
+// only used for calibration outside of a QRSS transmission. We only do I2C from the main loop, the ISR just flags tone changes.
+ISR(TIMER1_COMPB_vect)
+{
+  HAL_PROBE_TOGGLE(PROBE_BIT_SYMBOL);
+  g_isr_counts.timer1_compb++;
 
-void qrss_beacon() {
+  if (--qrss_postscale_count) return;
+  qrss_postscale_count = qrss_postscale;
 
-  static unsigned long milliPrev;        // Static variable stores previous millisecond count
-  unsigned long milliNow;
-  bool done_transmission = false;
+  if (qrss_msg_done) return;
+  if (--qrss_units_left) return;
 
-  // Since we are using FSKCW, turn on the clock now to let it warm up, delay one second and then turn on TX
-  si5351bx_setfreq(SI5351A_WSPRTX_CLK_NUM, ((QRSS_BEACON_FREQ_HZ) * 100ULL), SI5351_CLK_OFF );
+  qrss_next_segment();
+  qrss_tone_changed = true;
+}
+
+// Start a non-blocking slow mode transmission using the engine for mode. The keyer is driven by the Timer1 compare B
+// interrupt, so qrss_service() must be called from loop() until it returns true.
+// If message is NULL the compile time QRSS_MESSAGE is sent, otherwise message is encoded into work_buf (which must
+// not be touched until the transmission is complete) and truncated if it doesn't fit.
+void qrss_start(QrssMode mode, QrssSpeed ditSpeed, const char *message, uint8_t *work_buf, uint8_t work_buf_size)
+{
+  struct QrssEngine engine;
+  unsigned long unit_ms;
+  unsigned long unit_ticks;
+  byte postscale;
+  byte i;
+
+  if (mode >= NUM_QRSS_MODES) mode = MODE_FSKCW;
+  if (ditSpeed > QRSS10) ditSpeed = QRSS10;
+
+  memcpy_P(&engine, &qrss_engines[mode], sizeof(struct QrssEngine));
+  if (mode <= MODE_DFCW)
+    memcpy_P(&qrss_cw_mode, &qrss_cw_modes[mode], sizeof(struct QrssCwMode));
+
+  unit_ms = (unsigned long)speeds[ditSpeed] * engine.unit_ms;
+
+  qrss_src_in_ram = (message != NULL);
+  if (qrss_src_in_ram) {
+    if (engine.next_segment == cw_next_segment)
+      qrss_encode_stream(message, work_buf, work_buf_size);
+    else {
+      strncpy((char *)work_buf, message, work_buf_size - 1);
+      work_buf[work_buf_size - 1] = '\0';
+    }
+    qrss_src = work_buf;
+  }
+  else
+    qrss_src = (engine.next_segment == cw_next_segment) ? qrss_stream.bytes : (const uint8_t *)qrss_message_text;
+
+  // Timer1 ticks per unit with the /1024 prescaler. A QRSS10 unit is 10 s * 8 MHz / 1024 = 78125 ticks, more than the
+  // 16 bit timer holds, so a postscaler of 2 runs Timer1 at 39062 ticks per period.
+  unit_ticks = (unit_ms * (F_CPU / 1000UL)) / 1024UL;
+  postscale = (unit_ticks >> 16) + 1;
+
+  for (i = 0; i < engine.num_tones; i++)
+    si5351bx_calc_msynth((g_params.qrss_freq_hz * 100ULL) + ((uint64_t)i * engine.tone_spacing_chz), qrss_msynth[i]);
+
+  // Turn on the clock now to let it warm up, delay one second and then turn on TX
+  si5351bx_setfreq(SI5351A_WSPRTX_CLK_NUM, ((g_params.qrss_freq_hz) * 100ULL), SI5351_CLK_OFF );
   delay(1000);
   si5351bx_enable_clk(SI5351A_WSPRTX_CLK_NUM, SI5351_CLK_ON);
+  qrss_rf_on = true;
 
   // Turn off the PARK clock
-  si5351bx_enable_clk(SI5351A_PARK_CLK_NUM, SI5351_CLK_OFF);
+  si5351bx_park(SI5351_CLK_OFF);
+
+  log_qrss_tx_start(mode, ditSpeed);
+  perf_tx_start();
+
+  noInterrupts();
+  qrss_next_segment = engine.next_segment;
+  qrss_index = 0;
+  qrss_glyph = 0;
+  qrss_column = 0;
+  qrss_row = 0;
+  qrss_msg_done = false;
+  qrss_postscale = postscale;
+  qrss_postscale_count = postscale;
+  qrss_next_segment();                  // The first segment starts now
+  qrss_tone_changed = true;
+  interrupts();
+
+  hal_timer1_start_ctc((unit_ticks / postscale) - 1);
+
+  qrss_state = QRSS_KEYING;
+}
 
-  log_qrss_tx_start(MODE_FSKCW, QRSS10);
+static void qrss_end_tx() {
 
-  while (!done_transmission) {
-    milliNow = millis();                   // Get millisecond counter value
+  // Stop the keyer. Timer1 is reconfigured by the calibration that always follows QRSS.
+  hal_timer1_disable();
 
-    if (milliNow != milliPrev)             // If one millisecond has elapsed, call the beacon() function
-    {
-      milliPrev = milliNow;
-      done_transmission = qrss_transmit(MODE_FSKCW, QRSS10); // This gets called once per millisecond (i.e 1000 times per second)
-    }
-  } // end while (!done)
+  perf_tx_end();
 
   // Ensure that the Si5351a TX clock is shutdown
   si5351bx_enable_clk(SI5351A_WSPRTX_CLK_NUM, SI5351_CLK_OFF);
 
   // Re-enable the Park Clock
-  si5351bx_setfreq(SI5351A_PARK_CLK_NUM, (PARK_FREQ_HZ * 100ULL), SI5351_CLK_ON);
+  si5351bx_park(SI5351_CLK_ON);
 
   log_qrss_tx_end();
+}
+
+// Service the QRSS keyer, this must be called from loop() while qrss_is_active().
+// Returns true once the transmission is complete. The hold-off before calibration is handled by the state machine.
+bool qrss_service() {
+  byte tone;
+  bool changed;
+  bool done;
+
+  switch (qrss_state) {
+
+    case QRSS_KEYING :
+      noInterrupts();
+      tone = qrss_tone;
+      changed = qrss_tone_changed;
+      qrss_tone_changed = false;
+      done = qrss_msg_done;
+      interrupts();
+
+      if (changed) qrss_set_tone(tone);
+
+      if (done) {
+        qrss_end_tx();
+        qrss_state = QRSS_IDLE;
+        return true;
+      }
+      break;
 
-  delay(POST_QRSS_TX_DELAY_MS); // Kill some time before attempting calibration
+    default :
+      return true;
+  }
+
+  return false;
+}
 
-} // end qrss_beacon()
+bool qrss_is_active() {
+  return (qrss_state != QRSS_IDLE);
+}
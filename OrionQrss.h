@@ -18,17 +18,27 @@
    You should have received a copy of the GNU General Public License
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include "OrionXConfig.h"
+
 // Configuration Parameters for QRSS Beacon
 #define QRSS_BEACON_FREQ_HZ       14096810UL
 #define QRSS_BEACON_FSK_OFFSET_HZ 4            // DITS will be transmitted at QRSS_BEACON_FREQ_HZ and DAHS QRSS_BEACON_FSK_OFFSET_HZ higher for FSKCW
 #define QRSS_MESSAGE "  VE3WMB "               // Message - put your callsign here, in capital letters. I recommend two spaces before and one after callsign
+#define QRSS_DEFAULT_MODE         MODE_FSKCW   // Initial value of the qrssmode parameter
+#define QRSS_DEFAULT_SPEED        QRSS10       // Initial value of the qrssspeed parameter
+#define QRSS_HELL_TONE_SPACING_CHZ 200         // FSK Hell row spacing in hundredths of a Hz, 7 rows are 12 Hz high
+#define QRSS_MFSK_TONE_SPACING_CHZ 200         // MFSK4 tone spacing in hundredths of a Hz
+#define QRSS_MAX_MESSAGE_LEN      31           // Longest message composed from telemetry, see compose_qrss_message()
 
 
-// Delay after QRSS Transmission before attempting self_calibration (3 minutes)
+// Delay after QRSS Transmission before attempting self_calibration (3 minutes). This is cut short if the GPS has a valid
+// position fix and 1PPS is seen, see qrss_holdoff_check() in OrionWspr.ino.
 #define POST_QRSS_TX_DELAY_MS   180000  // - Three minutes. Since we wait about 2 minutes for calibration this gives about 5 minutes between QRSS transmissions
 #define FSK_HIGH  QRSS_BEACON_FSK_OFFSET_HZ
 #define FSK_LOW 0
 
-void qrss_beacon();
+void qrss_start(QrssMode mode, QrssSpeed ditSpeed, const char *message, uint8_t *work_buf, uint8_t work_buf_size);
+bool qrss_service();
+bool qrss_is_active();
 
 #endif
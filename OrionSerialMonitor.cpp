@@ -20,6 +20,10 @@
 #include "OrionSerialMonitor.h"
 #include "OrionXConfig.h"
 #include "OrionBoardConfig.h"
+#include "OrionPerfCounters.h"
+#include "OrionParameters.h"
+#include "OrionBenchmark.h"
+#include "OrionQrss.h"
 #include <TimeLib.h>
 
 
@@ -70,6 +74,12 @@ static bool g_info_log_on_off = INFO_LOG_INITIAL; // Info logging flag
 static bool g_qrm_avoidance_on_off = OFF;         // Frequency Diversity is initially off. 
 static bool g_selfcalibration_on_off = ON;
 
+// Commands are collected a line at a time so that they can take arguments (e.g. "set freq 14097050").
+// Lines that are a single character are treated as the original single character commands.
+#define CMD_LINE_MAX_LEN 32
+static char g_cmd_line[CMD_LINE_MAX_LEN + 1];
+static byte g_cmd_line_len = 0;
+
 #if defined (DEBUG_USES_SW_SERIAL)
 NeoSWSerial debugSerial(SOFT_SERIAL_RX_PIN, SOFT_SERIAL_TX_PIN);  // RX, TX
 #else
@@ -178,7 +188,11 @@ void info(byte info_num, int data) {
 
 }
 void println_cmd_list() {
-  debugSerial.println(F("cmds: v = f/w version, d = debug trace on/off, l = TX log on/off, i= info on/off, q = qrm avoidance on/off, ? = cmd list"));
+  debugSerial.println(F("cmds: v = f/w version, d = debug trace on/off, l = TX log on/off, i= info on/off, q = qrm avoidance on/off, p = perf counters, r = reset perf counters, ? = cmd list"));
+  debugSerial.println(F("      list, get <param>, set <param> <value>, save, defaults  (end each cmd with Enter)"));
+#if defined (ORION_BENCHMARK_SUPPORTED)
+  debugSerial.println(F("      bench, bench save (save results as the baseline)"));
+#endif
 }
 
 
@@ -226,6 +240,11 @@ void orion_log_wspr_tx(OrionWsprMsgType msgType, char grid[], unsigned long freq
       debugSerial.print(grid);
       break;
 
+    case PRIMARY_TYPE3_WSPR_MSG :
+      debugSerial.print(F("Primary WSPR TX (Type 3) - Grid: "));
+      debugSerial.print(grid);
+      break;
+
     case ALTITUDE_TELEM_MSG :
       debugSerial.print(F("Telemetry WSPR TX - ALT-> "));
       break;
@@ -281,7 +300,7 @@ void orion_log_telemetry (struct OrionTxData *data) {
 
 }
 
-void log_debug_Timer1_info(byte it, int ofCount, int t_count) {
+void log_debug_Timer1_info(byte it, unsigned int ofCount, unsigned int t_count) {
 
   if (g_debug_on_off == OFF) return; // Do nothing if debug disabled.
 
@@ -360,6 +379,57 @@ void log_qrss_tx_end() {
   print_monitor_prompt();
 }
 
+void log_params_loaded(bool from_eeprom) {
+  if (from_eeprom)
+    debugSerial.println(F("Parameters loaded from EEPROM"));
+  else
+    debugSerial.println(F("Using default parameters"));
+  print_monitor_prompt();
+}
+
+void log_osc_model(int32_t corr, uint16_t sigma_ppb, bool cal_skipped)
+{
+  if (g_info_log_on_off == OFF) return;
+
+  print_date_time();
+  if (cal_skipped)
+    debugSerial.print(F(" ** Calibration skipped **"));
+  debugSerial.print(F(" Osc model corr factor : "));
+  debugSerial.print(corr);
+  debugSerial.print(F(" +/- "));
+  debugSerial.print(sigma_ppb);
+  debugSerial.println(F(" ppb"));
+  print_monitor_prompt();
+}
+
+void log_checkpoint_resume(uint8_t reset_flags, uint8_t state, int32_t corr)
+{
+  if ((g_txlog_on_off == OFF) && (g_info_log_on_off == OFF)) return;
+
+  print_date_time();
+  debugSerial.print(F(" ** Resumed from checkpoint ** Reset flags : 0x"));
+  debugSerial.print(reset_flags, HEX);
+  debugSerial.print(F(" State : "));
+  debugSerial.print(state);
+  debugSerial.print(F(" Corr factor : "));
+  debugSerial.println(corr);
+  print_monitor_prompt();
+}
+
+void log_tx_monitor(uint8_t gates, uint8_t corrections, int32_t corr)
+{
+  if (g_info_log_on_off == OFF) return;
+
+  print_date_time();
+  debugSerial.print(F(" TX monitor gates : "));
+  debugSerial.print(gates);
+  debugSerial.print(F(" corrections : "));
+  debugSerial.print(corrections);
+  debugSerial.print(F(" corr factor : "));
+  debugSerial.println(corr);
+  print_monitor_prompt();
+}
+
 void log_calibration_fail(OrionCalibrationResult fail_reason) {
 
   if ((g_txlog_on_off == OFF) && (g_info_log_on_off == OFF)) return;
@@ -374,14 +444,86 @@ void log_calibration_fail(OrionCalibrationResult fail_reason) {
 
 }
 /**********************
-  /* Serial Monitor code
-  /**********************/
+  * Serial Monitor code
+  **********************/
 void print_board_and_version() {
   debugSerial.print(F("Orion firmware version: "));
   debugSerial.print(ORION_FW_VERSION);
   debugSerial.println(BOARDNAME);
 }
 
+// Display a snapshot of the runtime performance counters (see OrionPerfCounters.h)
+void print_perf_counters() {
+  struct OrionIsrCounters isr_counts;
+  struct OrionEepromLog eeprom_log;
+  byte i;
+
+  // The ISR counters are multi-byte so take a consistent copy with interrupts disabled
+  noInterrupts();
+  isr_counts.timer2_compa = g_isr_counts.timer2_compa;
+  isr_counts.timer1_ovf = g_isr_counts.timer1_ovf;
+  isr_counts.timer1_compb = g_isr_counts.timer1_compb;
+  isr_counts.pps = g_isr_counts.pps;
+  interrupts();
+
+  debugSerial.print(F(" I2C xact: "));
+  debugSerial.print(g_perf.i2c_transactions);
+  debugSerial.print(F(" bytes: "));
+  debugSerial.print(g_perf.i2c_bytes);
+  debugSerial.print(F(" NACKs: "));
+  debugSerial.print(g_perf.i2c_nacks);
+  debugSerial.print(F(" failed: "));
+  debugSerial.print(g_perf.i2c_failures);
+  debugSerial.print(F(" Si5351 xact last TX: "));
+  debugSerial.println(g_perf.si5351_writes_last_tx);
+
+  debugSerial.print(F(" ISR T2 COMPA: "));
+  debugSerial.print(isr_counts.timer2_compa);
+  debugSerial.print(F(" T1 OVF: "));
+  debugSerial.print(isr_counts.timer1_ovf);
+  debugSerial.print(F(" T1 COMPB: "));
+  debugSerial.print(isr_counts.timer1_compb);
+  debugSerial.print(F(" PPS: "));
+  debugSerial.println(isr_counts.pps);
+
+  debugSerial.print(F(" GPS chars: "));
+  debugSerial.print(g_perf.gps_chars);
+  debugSerial.print(F(" sentences: "));
+  debugSerial.print(g_perf.gps_sentences);
+  debugSerial.print(F(" cksum errors: "));
+  debugSerial.println(g_perf.gps_errors);
+
+  debugSerial.print(F(" loops/s: "));
+  debugSerial.print(g_perf.loops_per_sec);
+  debugSerial.print(F(" asleep ms: "));
+  debugSerial.println(g_perf.sleep_ms);
+
+  perf_update_memory_hwm();
+  perf_get_eeprom_log(&eeprom_log);
+  debugSerial.print(F(" stack hwm: "));
+  debugSerial.print(g_perf.stack_hwm_bytes);
+  debugSerial.print(F(" heap: "));
+  debugSerial.print(g_perf.heap_bytes);
+  debugSerial.print(F(" min free SRAM: "));
+  debugSerial.print(g_perf.min_free_sram);
+  debugSerial.print(F(" EEPROM log boots: "));
+  debugSerial.print(eeprom_log.boot_count);
+  debugSerial.print(F(" min free SRAM: "));
+  debugSerial.println(eeprom_log.min_free_sram);
+
+  // Only the actions that have actually run are displayed
+  debugSerial.print(F(" max action ms:"));
+  for (i = 0; i < NUM_ORION_ACTIONS; i++) {
+    if (g_perf.max_action_ms[i] != 0) {
+      debugSerial.print(F(" "));
+      debugSerial.print(i);
+      debugSerial.print(F("="));
+      debugSerial.print(g_perf.max_action_ms[i]);
+    }
+  }
+  debugSerial.println();
+}
+
 void serial_monitor_begin() {
 
   // Start software serial port
@@ -393,69 +535,166 @@ void serial_monitor_begin() {
   delay(500);
 }
 
-static void flush_input(void) {
+// Display one parameter as "name = value"
+void print_param(byte index) {
+  char name[12];
 
-  while (debugSerial.available() > 0)
-    debugSerial.read();
+  params_get_name(index, name, sizeof(name));
+  debugSerial.print(name);
+  debugSerial.print(F(" = "));
+  params_print_value(index, debugSerial);
 }
 
-void serial_monitor_interface() {
+void print_param_list() {
+  for (byte i = 0; i < params_count(); i++) {
+    print_param(i);
+    debugSerial.print(F("  ["));
+    params_print_range(i, debugSerial);
+    debugSerial.println(F("]"));
+  }
+}
+
+// Handle the original single character commands
+void process_single_char_cmd(char c) {
+
+  switch (c) {
+
+    case 'v' :
+      print_board_and_version();
+      break;
+
+    case 'd' : // toggle debug flag
+      debugSerial.print(F("Orion debug tracing is : "));
+      g_debug_on_off = toggle_on_off(g_debug_on_off);
+      break;
 
-  if (debugSerial.available() > 0) {
-    char c = debugSerial.read();
-
-    debugSerial.println(c); // echo the typed character
-
-    switch (c) {
-
-      case 'v' :
-        flush_input();
-        print_board_and_version();
-        break;
-
-      case 'd' : // toggle debug flag
-        flush_input();
-        debugSerial.print(F("Orion debug tracing is : "));
-        g_debug_on_off = toggle_on_off(g_debug_on_off);
-        break;
-
-      case 'c' : // toggle calibration flag
-        flush_input();
-        debugSerial.print(F("Orion self calibration is : "));
-        g_selfcalibration_on_off = toggle_on_off(g_selfcalibration_on_off);
-        break;
-
-      case 'l' : // toggle TX log flag
-        flush_input();
-        debugSerial.print(F("Orion TX log is : "));
-        g_txlog_on_off = toggle_on_off(g_txlog_on_off);
-        break;
-
-      case 'h': case '?' : // list commands
-        flush_input();
-        println_cmd_list();
-        break;
-
-      case'q' :
-        flush_input();
-        debugSerial.print(F("Orion QRM avoidance is : "));
-        g_qrm_avoidance_on_off = toggle_on_off(g_qrm_avoidance_on_off);
-        break;
-
-      case'i' :
-        flush_input();
-        debugSerial.print(F("Orion info logs are : "));
-        g_info_log_on_off = toggle_on_off(g_info_log_on_off);
-        break;
-
-      default:
-        flush_input();
-        debugSerial.println(F(" -- unrecognized command"));
-        println_cmd_list();
-
-        // Do nothing
+    case 'c' : // toggle calibration flag
+      debugSerial.print(F("Orion self calibration is : "));
+      g_selfcalibration_on_off = toggle_on_off(g_selfcalibration_on_off);
+      break;
+
+    case 'l' : // toggle TX log flag
+      debugSerial.print(F("Orion TX log is : "));
+      g_txlog_on_off = toggle_on_off(g_txlog_on_off);
+      break;
+
+    case 'h': case '?' : // list commands
+      println_cmd_list();
+      break;
+
+    case'q' :
+      debugSerial.print(F("Orion QRM avoidance is : "));
+      g_qrm_avoidance_on_off = toggle_on_off(g_qrm_avoidance_on_off);
+      break;
+
+    case'i' :
+      debugSerial.print(F("Orion info logs are : "));
+      g_info_log_on_off = toggle_on_off(g_info_log_on_off);
+      break;
+
+    case 'p' : // display performance counters
+      print_date_time();
+      debugSerial.println(F("Orion perf counters :"));
+      print_perf_counters();
+      break;
+
+    case 'r' : // reset performance counters
+      perf_reset();
+      debugSerial.println(F("Orion perf counters reset"));
+      break;
+
+    default:
+      debugSerial.println(F(" -- unrecognized command"));
+      println_cmd_list();
+
+      // Do nothing
+  }
+}
+
+// Handle a complete command line
+void process_cmd_line(char *line) {
+  char *cmd;
+  char *name;
+  char *value;
+  int index;
+
+  cmd = strtok(line, " ");
+  if (cmd == NULL) return;
+  name = strtok(NULL, " ");
+  value = strtok(NULL, " ");
+
+  if ((cmd[1] == '\0') && (name == NULL)) {
+    process_single_char_cmd(cmd[0]);
+  }
+  else if (strcmp_P(cmd, PSTR("list")) == 0) {
+    print_param_list();
+  }
+  else if (strcmp_P(cmd, PSTR("save")) == 0) {
+    params_save();
+    debugSerial.println(F("Parameters saved to EEPROM"));
+  }
+  else if (strcmp_P(cmd, PSTR("defaults")) == 0) {
+    params_set_defaults();
+    params_apply();
+    debugSerial.println(F("Default parameters restored, use save to keep them"));
+  }
+#if defined (ORION_BENCHMARK_SUPPORTED)
+  else if (strcmp_P(cmd, PSTR("bench")) == 0) {
+    if (qrss_is_active()) {
+      debugSerial.println(F(" -- not available during QRSS"));
+      return;
     }
-    print_monitor_prompt();
+    bench_run_all(debugSerial, (name != NULL) && (strcmp_P(name, PSTR("save")) == 0));
   }
+#endif
+  else if ((strcmp_P(cmd, PSTR("get")) == 0) || (strcmp_P(cmd, PSTR("set")) == 0)) {
+    if ((name == NULL) || ((index = params_find(name)) < 0)) {
+      debugSerial.println(F(" -- unknown parameter, use list"));
+      return;
+    }
 
+    if (cmd[0] == 's') {
+      if ((value == NULL) || !params_set_value(index, value)) {
+        debugSerial.print(F(" -- invalid value, range is "));
+        params_print_range(index, debugSerial);
+        debugSerial.println();
+        return;
+      }
+    }
+    print_param(index);
+    debugSerial.println();
+  }
+  else {
+    debugSerial.println(F(" -- unrecognized command"));
+    println_cmd_list();
+  }
+}
+
+void serial_monitor_interface() {
+  char c;
+
+  while (debugSerial.available() > 0) {
+    c = debugSerial.read();
+
+    if ((c == '\r') || (c == '\n')) {
+      // Ignore the empty line produced by the second character of a CR LF pair
+      if (g_cmd_line_len == 0) continue;
+
+      debugSerial.println();
+      g_cmd_line[g_cmd_line_len] = '\0';
+      g_cmd_line_len = 0;
+      process_cmd_line(g_cmd_line);
+      print_monitor_prompt();
+    }
+    else if ((c == '\b') || (c == 0x7F)) { // Backspace or Delete
+      if (g_cmd_line_len > 0) {
+        g_cmd_line_len--;
+        debugSerial.print(F("\b \b"));
+      }
+    }
+    else if ((c >= ' ') && (g_cmd_line_len < CMD_LINE_MAX_LEN)) {
+      g_cmd_line[g_cmd_line_len++] = c;
+      debugSerial.print(c); // echo the typed character
+    }
+  }
 }
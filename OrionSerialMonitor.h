@@ -32,7 +32,7 @@ bool is_qrm_avoidance_on();
 void enable_qrm_avoidance();
 void disable_qrm_avoidance();
 bool is_selfcalibration_on();
-void log_debug_Timer1_info(byte i, int ofCount, int t_count);
+void log_debug_Timer1_info(byte i, unsigned int ofCount, unsigned int t_count);
 void log_calibration(uint64_t sampled_freq, int32_t o_cal_factor, int32_t n_cal_factor );
 void log_calibration_start();
 void log_time_set();
@@ -40,5 +40,9 @@ void log_shutdown(uint8_t voltagex10);
 void log_qrss_tx_start(QrssMode mode, QrssSpeed speed);
 void log_qrss_tx_end();
 void log_calibration_fail(OrionCalibrationResult fail_reason);
+void log_osc_model(int32_t corr, uint16_t sigma_ppb, bool cal_skipped);
+void log_tx_monitor(uint8_t gates, uint8_t corrections, int32_t corr);
+void log_checkpoint_resume(uint8_t reset_flags, uint8_t state, int32_t corr);
+void log_params_loaded(bool from_eeprom);
 
 #endif
@@ -23,22 +23,19 @@
 #include "OrionXConfig.h"
 #include "OrionBoardConfig.h"
 #include "OrionSi5351.h"
-
-#if defined (SI5351A_USES_SOFTWARE_I2C)
-#include <SoftWire.h>  // Needed for Software I2C otherwise include <Wire.h>
-#else
-#include <Wire.h>
-#endif
+#include "OrionPerfCounters.h"
+#include "OrionHal.h"    // I2C, using Wire or SoftWire (SI5351A_USES_SOFTWARE_I2C)
 
 uint64_t si5351bx_vcoa = (SI5351BX_XTAL*SI5351BX_MSA);  // 25mhzXtal calibrate
 int32_t si5351_correction = SI5351A_CLK_FREQ_CORRECTION;  //Frequency correction factor calculated using OrionSi5351_calibration sketch
 uint8_t  si5351bx_rdiv = 0;             // 0-7, CLK pin sees fout/(2**rdiv) // Note that 0 means divide by 1
 uint8_t  si5351bx_drive[3] = {3, 3, 3}; // 0=2ma 1=4ma 2=6ma 3=8ma for CLK 0,1,2 - Set CLK 0,1,2 to 8ma
 uint8_t  si5351bx_clken = 0xFF;         // Private, all CLK output drivers off
-
-// Create an instance of Softwire named Wire if using Software I2C
-#if defined (SI5351A_USES_SOFTWARE_I2C)
-SoftWire Wire = SoftWire();
+uint8_t  si5351bx_msynth[3][8];         // Private, the multisynth registers last written for CLK 0,1,2
+#if defined (SI5351A_PUSH_PULL_CLK_NUM)
+uint8_t  si5351bx_clk_inv = 1 << SI5351A_PUSH_PULL_CLK_NUM; // Private, bit n inverts the CLK n output (CLKn_INV)
+#else
+uint8_t  si5351bx_clk_inv = 0;
 #endif
 
 /** *************  SI5315 routines - (tks Jerry Gaffke, KE7ER)   ***********************
@@ -79,20 +76,32 @@ SoftWire Wire = SoftWire();
    This lightweight method is a reasonable compromise for a seldom used feature.
 */
 
+// Write vcnt bytes starting at an Si5351a register address. A NACK (or any other I2C error) is retried up to
+// SI5351_I2C_RETRIES times, returns false if the write still failed.
+static bool i2c_write_checked(uint8_t reg, const uint8_t *vals, uint8_t vcnt) {
+  uint8_t retries = 0;
+
+  g_perf.i2c_transactions++;
+  g_perf.i2c_bytes += vcnt + 1;
+
+  while (hal_i2c_write(SI5351BX_ADDR, reg, vals, vcnt) != 0) {
+    g_perf.i2c_nacks++;
+    if (retries++ == SI5351_I2C_RETRIES) {
+      g_perf.i2c_failures++;
+      return false;
+    }
+  }
+  return true;
+}
+
 // Write a single 8 bit value to an Si5351a register address
-void i2cWrite(uint8_t reg, uint8_t val) {   // write reg via i2c
-  Wire.beginTransmission(SI5351BX_ADDR);
-  Wire.write(reg);
-  Wire.write(val);
-  Wire.endTransmission();
+bool i2cWrite(uint8_t reg, uint8_t val) {   // write reg via i2c
+  return i2c_write_checked(reg, &val, 1);
 }
 
 // Write an array of 8bit values to an Si5351a register address
-void i2cWriten(uint8_t reg, uint8_t *vals, uint8_t vcnt) {  // write array
-  Wire.beginTransmission(SI5351BX_ADDR);
-  Wire.write(reg);
-  while (vcnt--) Wire.write(*vals++);
-  Wire.endTransmission();
+bool i2cWriten(uint8_t reg, uint8_t *vals, uint8_t vcnt) {  // write array
+  return i2c_write_checked(reg, vals, vcnt);
 }
 
 // Turn the specified clock number on or off.
@@ -106,10 +115,23 @@ void si5351bx_enable_clk(uint8_t clk_num, bool on_off) {
   i2cWrite(3, si5351bx_clken);
 }
 
+// Turn the PARK clock on or off. Dual band boards set SI5351A_PARK_CLK_NUM to SI5351A_CAL_CLK_NUM, that clock then
+// belongs to calibration and the TX monitor, and parking it would stop or retune the clock they count.
+void si5351bx_park(bool on_off) {
+#if (SI5351A_PARK_CLK_NUM != SI5351A_CAL_CLK_NUM)
+  if (on_off)
+    si5351bx_setfreq(SI5351A_PARK_CLK_NUM, (PARK_FREQ_HZ * 100ULL), SI5351_CLK_ON);
+  else
+    si5351bx_enable_clk(SI5351A_PARK_CLK_NUM, SI5351_CLK_OFF);
+#else
+  (void)on_off;
+#endif
+}
+
 // Initialize the Si5351a
 void si5351bx_init() {                  // Call once at power-up, start PLLA
-  uint8_t reg;  uint32_t msxp1;
-  Wire.begin();
+  uint32_t msxp1;
+  hal_i2c_begin();
   i2cWrite(149, 0);                     // SpreadSpectrum off
   i2cWrite(3, si5351bx_clken);          // Disable all CLK output drivers
   i2cWrite(183, ((SI5351BX_XTALPF << 6) | 0x12)); // Set 25mhz crystal load capacitance (tks Daniel KB3MUN)
@@ -119,17 +141,25 @@ void si5351bx_init() {                  // Call once at power-up, start PLLA
   i2cWrite(177, 0x20);                  // Reset PLLA  (0x80 resets PLLB)
 }
 
+// Reset PLLA, which restarts all of the multisynths in step. Clocks with the same multisynth settings are then
+// phase aligned (or 180 degrees apart if one of them is inverted).
+void si5351bx_reset_pll() {
+  i2cWrite(177, 0x20);
+}
+
 // Set the frequency correction factor - needed for self-calibration
 void si5351bx_set_correction(int32_t corr) {
   si5351_correction = corr;
 }
 
-// Set the frequency for the specified clock number
-// Note that fout is in hertz x 100 (i.e. hundredths of hertz).
-// Frequency range must be between 500 Khz and 109 Mhz
-// An fout value of 0 will shutdown the specified clock.
+// The correction factor in use, which is the oscillator model's prediction when the oscmodel parameter is on
+int32_t si5351bx_get_correction() {
+  return si5351_correction;
+}
 
-void si5351bx_setfreq(uint8_t clknum, uint64_t fout, bool tx_on)
+// Calculate the 8 multisynth register values for fout (in hundredths of hertz) using the current correction factor.
+// These are the values for registers 42 + (clknum * 8) through 49 + (clknum * 8).
+void si5351bx_calc_msynth(uint64_t fout, uint8_t *vals)
 {
   // Note that I am not being lazy here in naming variables. If you refer to SiLabs
   // application note AN619 - "Manually Generating an Si5351 Register Map", the formulas
@@ -138,6 +168,91 @@ void si5351bx_setfreq(uint8_t clknum, uint64_t fout, bool tx_on)
   // a bit cryptic.
   uint64_t a, b, c, ref_freq;
   uint32_t p1, p2, p3;
+
+  // Determine the integer part of feedback equation
+  ref_freq = si5351bx_vcoa;
+  ref_freq = ref_freq + (int32_t)((((((int64_t)si5351_correction) << 31) / 1000000000LL) * ref_freq) >> 31);
+  a = ref_freq / fout;
+  b = (ref_freq % fout * RFRAC_DENOM) / fout;
+  c = b ? RFRAC_DENOM : 1;
+
+  p1 = 128 * a + ((128 * b) / c) - 512;
+  p2 = 128 * b - c * ((128 * b) / c);
+  p3 = c;
+
+  // Setup the bytes to be sent to the Si5351a register
+  vals[0] = (p3 & 0x0000FF00) >> 8;
+  vals[1] = p3 & 0x000000FF;
+  vals[2] = ((p1 & 0x00030000) >> 16) | (si5351bx_rdiv << 4); // R divider in bits 6:4
+  vals[3] = (p1 & 0x0000FF00) >> 8;
+  vals[4] = p1 & 0x000000FF;
+  vals[5] = (((p3 & 0x000F0000) >> 12) | ((p2 & 0x000F0000) >> 16));
+  vals[6] = (p2 & 0x0000FF00) >> 8;
+  vals[7] = p2 & 0x000000FF;
+}
+
+// Change the multisynth for the specified clock number to the register image new_vals. Only the contiguous run of
+// bytes that differ from the registers last written (si5351bx_msynth) is written, for a small frequency shift this is
+// usually just the P2/P1 low order bytes. Nothing is written if the images are the same.
+void si5351bx_update_msynth(uint8_t clknum, const uint8_t *new_vals)
+{
+  const uint8_t *cur_vals = si5351bx_msynth[clknum];
+  int8_t first = 0;
+  int8_t last = 7;
+
+  while ((first < 8) && (new_vals[first] == cur_vals[first])) first++;
+  if (first == 8) return;
+  while (new_vals[last] == cur_vals[last]) last--;
+
+  i2cWriten(42 + (clknum * 8) + first, (uint8_t *)&new_vals[first], last - first + 1);
+  memcpy(si5351bx_msynth[clknum], new_vals, 8);
+}
+
+// Change the multisynths of two clocks with a single I2C write, so that both outputs change tone together. The
+// multisynth registers from clk_a to clk_b are contiguous (42 to 65 for CLK 0 to 2), any clock between the two is
+// rewritten with its current registers. As with si5351bx_update_msynth() only the run of bytes that differ is written.
+// clk_a must be lower than clk_b.
+void si5351bx_update_msynth_pair(uint8_t clk_a, const uint8_t *vals_a, uint8_t clk_b, const uint8_t *vals_b)
+{
+  uint8_t *cur = si5351bx_msynth[clk_a];   // The rows for clk_a to clk_b are contiguous, like the registers
+  uint8_t next[sizeof(si5351bx_msynth)];
+  uint8_t len = (clk_b - clk_a + 1) * 8;
+  uint8_t first = 0;
+  uint8_t last = len - 1;
+
+  memcpy(next, cur, len);
+  memcpy(next, vals_a, 8);
+  memcpy(&next[len - 8], vals_b, 8);
+
+  while ((first < len) && (next[first] == cur[first])) first++;
+  if (first == len) return;
+  while (next[last] == cur[last]) last--;
+
+  memcpy(cur, next, len);
+  i2cWriten(42 + (clk_a * 8) + first, &cur[first], last - first + 1);
+}
+
+// Drive the output of clknum (1 or 2, the Si5351a MSOP10 only has CLK0 to CLK2) from the multisynth of CLK0 instead of
+// its own, divided by 2**rdiv in its own R divider. This lets a spare output carry the TX multisynth, e.g. to calibrate
+// the TX path with the TX output off. A later si5351bx_setfreq() on clknum returns it to its own multisynth.
+// Any other clknum is ignored.
+void si5351bx_clk_from_ms0(uint8_t clknum, uint8_t rdiv, bool tx_on)
+{
+  if ((clknum < 1) || (clknum > 2)) return;
+
+  si5351bx_msynth[clknum][2] = (si5351bx_msynth[clknum][2] & 0x0F) | (rdiv << 4);
+  i2cWrite(44 + (clknum * 8), si5351bx_msynth[clknum][2]);
+  i2cWrite(16 + clknum, 0x08 | (((si5351bx_clk_inv >> clknum) & 1) << 4) | si5351bx_drive[clknum]); // CLKn_SRC is MS0
+  si5351bx_enable_clk(clknum, tx_on);
+}
+
+// Set the frequency for the specified clock number
+// Note that fout is in hertz x 100 (i.e. hundredths of hertz).
+// Frequency range must be between 500 Khz and 109 Mhz
+// An fout value of 0 will shutdown the specified clock.
+
+void si5351bx_setfreq(uint8_t clknum, uint64_t fout, bool tx_on)
+{
   uint8_t vals[8];
 
   if ((fout < 50000000) || (fout > 10900000000)) {  // If clock freq out of range 500 Khz to 109 Mhz
@@ -147,28 +262,10 @@ void si5351bx_setfreq(uint8_t clknum, uint64_t fout, bool tx_on)
 
   else {
 
-    // Determine the integer part of feedback equation
-    ref_freq = si5351bx_vcoa;
-    ref_freq = ref_freq + (int32_t)((((((int64_t)si5351_correction) << 31) / 1000000000LL) * ref_freq) >> 31);
-    a = ref_freq / fout;
-    b = (ref_freq % fout * RFRAC_DENOM) / fout;
-    c = b ? RFRAC_DENOM : 1;
-
-    p1 = 128 * a + ((128 * b) / c) - 512;
-    p2 = 128 * b - c * ((128 * b) / c);
-    p3 = c;
-
-    // Setup the bytes to be sent to the Si5351a register
-    vals[0] = (p3 & 0x0000FF00) >> 8;
-    vals[1] = p3 & 0x000000FF;
-    vals[2] = (p1 & 0x00030000) >> 16;
-    vals[3] = (p1 & 0x0000FF00) >> 8;
-    vals[4] = p1 & 0x000000FF;
-    vals[5] = (((p3 & 0x000F0000) >> 12) | ((p2 & 0x000F0000) >> 16));
-    vals[6] = (p2 & 0x0000FF00) >> 8;
-    vals[7] = p2 & 0x000000FF;
+    si5351bx_calc_msynth(fout, vals);
     i2cWriten(42 + (clknum * 8), vals, 8); // Write to 8 msynth regs
-    i2cWrite(16 + clknum, 0x0C | si5351bx_drive[clknum]); // use local msynth
+    memcpy(si5351bx_msynth[clknum], vals, 8);
+    i2cWrite(16 + clknum, 0x0C | (((si5351bx_clk_inv >> clknum) & 1) << 4) | si5351bx_drive[clknum]); // use local msynth
 
     if (tx_on == true)
       si5351bx_clken &= ~(1 << clknum);   // Clear bit to enable clock
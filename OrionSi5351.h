@@ -28,20 +28,31 @@
 #define BB2(x) ((uint8_t)(x>>16))
 
 #define SI5351BX_ADDR 0x60              // I2C address of Si5351   (typical)
+#define SI5351_I2C_RETRIES 2            // Times a NACKed register write is retried before giving up
 
 #define RFRAC_DENOM 1000000ULL
 #define SI5351_CLK_ON true
 #define SI5351_CLK_OFF false
 
+extern uint8_t si5351bx_drive[3];       // 0=2ma 1=4ma 2=6ma 3=8ma for CLK 0,1,2
+extern uint8_t si5351bx_rdiv;           // 0-7, the next si5351bx_setfreq() output is divided by 2**rdiv, return it to 0 after
+
 // Turn the specified clock number on or off.
 void si5351bx_enable_clk(uint8_t clk_num, bool on_off);
 
+// Turn the PARK clock on at PARK_FREQ_HZ or off. Does nothing when the PARK and CAL clocks are shared (dual band).
+void si5351bx_park(bool on_off);
+
 // Initialize the Si5351
 void si5351bx_init();
 
+// Reset PLLA, phase aligning the clocks that have the same multisynth settings
+void si5351bx_reset_pll();
+
 // Set the correction factor for the Si5351a clock.
 // This is used for self-calibration
 void si5351bx_set_correction(int32_t corr);
+int32_t si5351bx_get_correction();
 
 // Set the frequency for the specified clock number
 // Note that fout is in hertz x 100 (i.e. hundredths of hertz).
@@ -50,4 +61,17 @@ void si5351bx_set_correction(int32_t corr);
 // change. 
 void si5351bx_setfreq(uint8_t clknum, uint64_t fout, bool tx_on);
 
+// Drive the output of clknum (1 or 2) from the CLK0 multisynth, divided by 2**rdiv
+void si5351bx_clk_from_ms0(uint8_t clknum, uint8_t rdiv, bool tx_on);
+
+// Calculate the 8 multisynth register values for fout (hundredths of hertz)
+void si5351bx_calc_msynth(uint64_t fout, uint8_t *vals);
+
+// Switch the multisynth of the specified clock to a precalculated register image,
+// writing only the bytes that differ from the registers last written.
+void si5351bx_update_msynth(uint8_t clknum, const uint8_t *new_vals);
+
+// Switch the multisynths of two clocks (clk_a < clk_b) to new register images together, in one I2C write.
+void si5351bx_update_msynth_pair(uint8_t clk_a, const uint8_t *vals_a, uint8_t clk_b, const uint8_t *vals_b);
+
 #endif
@@ -37,6 +37,40 @@ void orion_sm_change_state( OrionState new_state) {
   g_current_orion_state = new_state;
 }
 
+OrionState orion_sm_get_state() {
+  return g_current_orion_state;
+}
+
+// Pick up again after a reset from saved_state, the state saved in the reset checkpoint (see OrionCheckpoint.cpp).
+// We can't know how far the interrupted action got so we restart from the nearest state that waits on the scheduler :
+// the WSPR states wait for the next transmit cycle, as after a calibration, and the QRSS states start a new hold-off.
+// Returns false if the beacon hadn't finished starting up or was shutting down, then it has to start from scratch.
+bool orion_sm_resume(OrionState saved_state, OrionAction *action) {
+
+  switch (saved_state) {
+
+    case CALIBRATE_ST :
+    case WAIT_TELEMETRY_ST :
+    case TELEMETRY_ST :
+    case WAIT_TX_PRIMARY_WSPR_ST :
+    case TX_PRIMARY_WSPR_ST :
+    case WAIT_TX_SECONDARY_WSPR_ST :
+    case TX_SECONDARY_WSPR_ST :
+      orion_sm_change_state(WAIT_TELEMETRY_ST);
+      *action = NO_ACTION;
+      return true;
+
+    case QRSS_TX_ST :
+    case QRSS_HOLDOFF_ST :
+      orion_sm_change_state(QRSS_HOLDOFF_ST);
+      *action = QRSS_HOLDOFF_ACTION;
+      return true;
+
+    default :
+      return false;
+  }
+}
+
 
 // This is the event processor that implements the core of the Orion State Machine
 // It returns an Action of type OrionAction to trigger work.
@@ -198,10 +232,7 @@ OrionAction orion_state_machine(OrionEvent event) {
         else {
           // If we don't support self Calibration then skip to telemetry
           orion_sm_change_state(WAIT_TELEMETRY_ST);
-
-          // Since we can't rely on the post-calibration cleanup to setup and
-          // start the WS TX Interrupt we trigger it using an action.
-          next_action = WSPR_TX_INT_SETUP_ACTION;
+          next_action = NO_ACTION;
         }
 
       } // SETUP_DONE_EV
@@ -211,9 +242,19 @@ OrionAction orion_state_machine(OrionEvent event) {
 
     case QRSS_TX_ST :
       if (event == QRSS_TX_DONE_EV) {
+        // Wait a while before attempting calibration, unless the GPS comes back first
+        orion_sm_change_state(QRSS_HOLDOFF_ST);
+        next_action = QRSS_HOLDOFF_ACTION;
+      }
+      break;
+
+    case QRSS_HOLDOFF_ST : // Waiting after a QRSS transmission, GPS data is still being processed
+      if ((event == QRSS_HOLDOFF_DONE_EV) || (event == GPS_AOS_EV)) {
         orion_sm_change_state(CALIBRATE_ST);
         next_action = CALIBRATION_ACTION;
       }
+      else
+        info(10, event); // This event is not supported in this state, ignore
       break;
 
     default :
@@ -19,21 +19,27 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 enum OrionState {POWERUP_ST, WAIT_OP_VOLTAGE_ST, CALIBRATE_ST, WAIT_TELEMETRY_ST, TELEMETRY_ST, WAIT_TX_PRIMARY_WSPR_ST,
-                 TX_PRIMARY_WSPR_ST, WAIT_TX_SECONDARY_WSPR_ST, TX_SECONDARY_WSPR_ST, SHUTDOWN_ST, QRSS_TX_ST
+                 TX_PRIMARY_WSPR_ST, WAIT_TX_SECONDARY_WSPR_ST, TX_SECONDARY_WSPR_ST, SHUTDOWN_ST, QRSS_TX_ST,
+                 QRSS_HOLDOFF_ST
                 };
 
 enum OrionEvent {NO_EV, SETUP_DONE_EV, CALIBRATION_FAIL_EV, CALIBRATION_DONE_EV, TELEMETRY_TIME_EV, TELEMETRY_DONE_EV,
                  PRIMARY_WSPR_TX_TIME_EV, PRIMARY_WSPR_TX_DONE_EV, SECONDARY_WSPR_TX_DONE_EV, WSPR_TX_TIME_MIN02_EV,
                  WSPR_TX_TIME_MIN12_EV, WSPR_TX_TIME_MIN22_EV, WSPR_TX_TIME_MIN32_EV, WSPR_TX_TIME_MIN42_EV, WSPR_TX_TIME_MIN52_EV,
-                 LOW_VOLTAGE_EV, WAIT_VOLTAGE_EV, GPS_LOS_TIMEOUT_EV, QRSS_TX_DONE_EV, STARTUP_CALIBRATION_FAIL_EV
+                 LOW_VOLTAGE_EV, WAIT_VOLTAGE_EV, GPS_LOS_TIMEOUT_EV, QRSS_TX_DONE_EV, STARTUP_CALIBRATION_FAIL_EV,
+                 QRSS_HOLDOFF_DONE_EV, GPS_AOS_EV
                 };
 
 enum OrionAction {NO_ACTION, CALIBRATION_ACTION, GET_TELEMETRY_ACTION, TX_WSPR_MSG1_ACTION, STARTUP_CALIBRATION_ACTION,
-                  WSPR_TX_INT_SETUP_ACTION, TX_WSPR_MIN02_ACTION, TX_WSPR_MIN12_ACTION, TX_WSPR_MIN22_ACTION, TX_WSPR_MIN32_ACTION,
-                  TX_WSPR_MIN42_ACTION, TX_WSPR_MIN52_ACTION, INITIATE_SHUTDOWN_ACTION, OP_VOLT_WAITLOOP_ACTION, QRSS_TX_ACTION
+                  TX_WSPR_MIN02_ACTION, TX_WSPR_MIN12_ACTION, TX_WSPR_MIN22_ACTION, TX_WSPR_MIN32_ACTION,
+                  TX_WSPR_MIN42_ACTION, TX_WSPR_MIN52_ACTION, INITIATE_SHUTDOWN_ACTION, OP_VOLT_WAITLOOP_ACTION, QRSS_TX_ACTION,
+                  QRSS_HOLDOFF_ACTION,
+                  NUM_ORION_ACTIONS // This must always be last, it is used to size per action tables
                  };
 
 void orion_sm_begin();
+OrionState orion_sm_get_state();
+bool orion_sm_resume(OrionState saved_state, OrionAction *action);
 
 OrionAction orion_state_machine(OrionEvent event);
 
@@ -20,6 +20,7 @@
 #include "OrionXConfig.h"
 #include "OrionBoardConfig.h"
 #include "OrionSerialMonitor.h"
+#include "OrionHal.h"
 
 #if defined (DS1820_TEMP_SENSOR_PRESENT)
 #include <OneWire.h>
@@ -96,22 +97,7 @@ int read_processor_temperature() {
 
   // The internal temperature has to be used
   // with the internal reference of 1.1V.
-  // Channel 8 can not be selected with
-  // the analogRead function yet.
-
-  // Set the internal reference and mux.
-  ADMUX = (_BV(REFS1) | _BV(REFS0) | _BV(MUX3));
-  ADCSRA |= _BV(ADEN);  // enable the ADC
-
-  delay(20);            // wait for voltages to become stable.
-
-  ADCSRA |= _BV(ADSC);  // Start the ADC
-
-  // Detect end-of-conversion
-  while (bit_is_set(ADCSRA, ADSC));
-
-  // Reading register "ADCW" takes care of how to read ADCL and ADCH.
-  wADC = ADCW;
+  wADC = hal_adc_read_internal_temp();
 
   // The offset of 324.31 could be wrong. It is just an indication.
   temp_c = (wADC - 324.31) / 1.22;
@@ -473,3 +459,66 @@ uint8_t encode_gridloc_char5_char6(char gridsq_char5, char gridsq_char6) {
   return (longitude + latitude);
 
 } // end encode_gridloc_char5_char6
+
+/*
+   Telemetry frame planner (telplan parameter)
+
+   Each transmit cycle has a single Telemetry slot. With the planner off the slot rotates through a fixed pattern
+   (see telemetry_tx_events[] in OrionWspr.ino). With it on, telemetry_plan() picks the channel whose slot is worth
+   the most : the number of Telemetry messages since the channel was last sent plus TELEM_PLAN_CHANGE_WEIGHT for every
+   power field level its value has moved since then. A channel that hasn't been sent for TELEM_PLAN_MAX_AGE messages
+   wins regardless, so a static value is still repeated now and then. During the ascent altitude takes most of the
+   slots, at float voltage and temperature take their turn as they change.
+
+   The receiver can't tell the channels apart from the Telemetry message alone, so the Primary message of the cycle
+   announces the channel in its power field, see telemetry_plan_announce_dbm().
+*/
+#define NUM_TELEM_CHANNELS   3     // ALTITUDE_TELEM_MSG, TEMPERATURE_TELEM_MSG and VOLTAGE_TELEM_MSG, in that order
+
+static uint8_t telem_plan_level[NUM_TELEM_CHANNELS];                   // Power field level last sent
+static uint8_t telem_plan_age[NUM_TELEM_CHANNELS] = {TELEM_PLAN_MAX_AGE, TELEM_PLAN_MAX_AGE, TELEM_PLAN_MAX_AGE};
+
+// The valid power field values 0, 3, 7, 10 ... 60 are levels 0 to 18
+static uint8_t dbm_level(uint8_t dbm) {
+  return ((dbm / 10) * 3) + (((dbm % 10) + 1) / 3);
+}
+
+// Pick the Telemetry message to send given the power field values of the three channels, indexed like the channels
+OrionWsprMsgType telemetry_plan(const uint8_t *dbm) {
+  uint16_t score;
+  uint16_t best_score = 0;
+  uint8_t best = 0;
+  uint8_t level;
+  uint8_t i;
+
+  for (i = 0; i < NUM_TELEM_CHANNELS; i++) {
+    level = dbm_level(dbm[i]);
+    score = telem_plan_age[i] + (TELEM_PLAN_CHANGE_WEIGHT * abs(level - telem_plan_level[i]));
+    if (telem_plan_age[i] >= TELEM_PLAN_MAX_AGE) score += 0x100;  // Overdue, ahead of any channel that isn't
+
+    if (score > best_score) {
+      best_score = score;
+      best = i;
+    }
+  }
+
+  return (OrionWsprMsgType)(ALTITUDE_TELEM_MSG + best);
+}
+
+// Record that a Telemetry message was sent with the given power field value
+void telemetry_plan_sent(OrionWsprMsgType type, uint8_t dbm) {
+  uint8_t i;
+
+  for (i = 0; i < NUM_TELEM_CHANNELS; i++)
+    if (telem_plan_age[i] < TELEM_PLAN_MAX_AGE) telem_plan_age[i]++;
+
+  i = type - ALTITUDE_TELEM_MSG;
+  telem_plan_age[i] = 0;
+  telem_plan_level[i] = dbm_level(dbm);
+}
+
+// Power field value of the Primary message announcing the Telemetry message of the cycle : 10 for altitude,
+// 20 for temperature and 30 for voltage
+uint8_t telemetry_plan_announce_dbm(OrionWsprMsgType type) {
+  return 10 * (type - PRIMARY_WSPR_MSG);
+}
@@ -18,6 +18,8 @@
    You should have received a copy of the GNU General Public License
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include "OrionXConfig.h"
+
 int read_voltage_v_x10 ();
 int read_DS1820_temperature();
 int read_TEMP36_temperature();
@@ -26,5 +28,8 @@ uint8_t encode_temperature (int temperature_c);
 uint8_t encode_voltage (int voltage_v_x10);
 uint8_t encode_altitude (int altitude_m);
 uint8_t encode_gridloc_char5_char6(char gridsq_char5, char gridsq_char6);
+OrionWsprMsgType telemetry_plan(const uint8_t *dbm);
+void telemetry_plan_sent(OrionWsprMsgType type, uint8_t dbm);
+uint8_t telemetry_plan_announce_dbm(OrionWsprMsgType type);
 
 #endif
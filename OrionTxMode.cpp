@@ -0,0 +1,193 @@
+/*
+   OrionTxMode.cpp - Orion digital transmit mode, the WSPR-2 encoder
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+#include "OrionBoardConfig.h"
+#include "OrionTxMode.h"
+
+/*
+   WSPR-2 encoder.
+
+   The 50 bit message is a 28 bit callsign field followed by a 22 bit field that holds the locator and power. It is
+   padded with 31 zero bits, convolutionally encoded (K=32, rate 1/2), interleaved by bit reversing the symbol index
+   and combined with the sync vector, as in the WSPR 2.0 protocol description and wsprsim_utils.c in WSJT-X.
+
+   The message type follows from the arguments, the same way WSJT-X picks it from the message text :
+     Type 1 : callsign, 4 character locator and power, e.g. "VE3WMB FN25 7"
+     Type 2 : compound callsign with a prefix or suffix and power (no locator), e.g. "G/VE3WMB 7"
+     Type 3 : 15 bit hash of the callsign, 6 character locator and power, e.g. "<VE3WMB> FN25DI 7"
+   A receiver can only show the callsign of a Type 3 message after it has decoded a Type 1 or Type 2 message from the
+   same callsign, so Type 3 messages have to be sent alternately with one of them.
+*/
+#define WSPR_POLY1              0xF2D05351UL
+#define WSPR_POLY2              0xE4613C47UL
+#define WSPR_MSG_BITS           81     // 50 bit message + 31 zero bits to flush the encoder
+#define WSPR_HASH_SEED          146
+
+// The sync vector, one bit per symbol, first symbol in the most significant bit of the first byte
+const uint8_t wspr_sync[21] PROGMEM = {0xC0, 0x8E, 0x25, 0xE0, 0x25, 0x02, 0xCD, 0x1A, 0x1A, 0xA9, 0x2C,
+                                       0x6A, 0x20, 0x93, 0xB3, 0x47, 0x05, 0x30, 0x1A, 0xC6, 0x00
+                                      };
+
+// 0-9 are 0 to 9, A-Z are 10 to 35 and anything else (a space) is 36
+static uint8_t wspr_char_code(char c) {
+  if (isdigit(c)) return c - '0';
+  if (isalpha(c)) return toupper(c) - 'A' + 10;
+  return 36;
+}
+
+// Pack up to 6 characters of a callsign, ending at a '\0' or a '/', into the 28 bit callsign field. The call area
+// digit has to be the third character so a callsign like K1ABC is shifted right by one space.
+static uint32_t wspr_pack_call(const char *call) {
+  char c6[6];
+  uint32_t n;
+  uint8_t i;
+
+  memset(c6, ' ', sizeof(c6));
+  for (i = 0; (i < sizeof(c6)) && (call[i] != '\0') && (call[i] != '/'); i++) c6[i] = call[i];
+
+  if (!isdigit(c6[2]) && isdigit(c6[1])) {
+    memmove(&c6[1], &c6[0], sizeof(c6) - 1);
+    c6[0] = ' ';
+  }
+
+  n = wspr_char_code(c6[0]);
+  n = (n * 36) + wspr_char_code(c6[1]);
+  n = (n * 10) + wspr_char_code(c6[2]);
+  for (i = 3; i < sizeof(c6); i++) n = (n * 27) + wspr_char_code(c6[i]) - 10;
+
+  return n;
+}
+
+static uint32_t wspr_rot(uint32_t x, uint8_t k) {
+  return (x << k) | (x >> (32 - k));
+}
+
+// 15 bit callsign hash of a Type 3 message. This is hashlittle() from Bob Jenkins' lookup3.c, which WSJT-X uses,
+// reduced to keys of 12 bytes or less as a callsign is never longer than that.
+static uint16_t wspr_hash(const char *call) {
+  uint8_t len = strlen(call);
+  uint32_t a, b, c;
+  uint32_t k;
+  uint8_t i;
+
+  a = b = c = 0xDEADBEEFUL + len + WSPR_HASH_SEED;
+  for (i = 0; i < len; i++) {
+    // Little endian 32 bit words
+    k = (uint32_t)(uint8_t)call[i] << ((i & 3) * 8);
+    if (i < 4) a += k;
+    else if (i < 8) b += k;
+    else c += k;
+  }
+
+  if (len > 0) {
+    c ^= b; c -= wspr_rot(b, 14);
+    a ^= c; a -= wspr_rot(c, 11);
+    b ^= a; b -= wspr_rot(a, 25);
+    c ^= b; c -= wspr_rot(b, 16);
+    a ^= c; a -= wspr_rot(c, 4);
+    b ^= a; b -= wspr_rot(a, 14);
+    c ^= b; c -= wspr_rot(b, 24);
+  }
+
+  return c & 0x7FFF;
+}
+
+// The 16 bit prefix or suffix value of a Type 2 message : a prefix of up to 3 characters in base 37, 60000 plus the
+// character code of a one character suffix or 60026 plus a two digit suffix. The top bit goes in the power field.
+// The callsign has been checked by params_set_value(), anything after the '/' that isn't a suffix is the base callsign.
+static uint16_t wspr_pack_affix(const char *call, const char *slash) {
+  uint16_t m;
+  const char *p;
+  uint8_t i;
+
+  if (slash[1] != '\0' && slash[2] == '\0')
+    return 60000U + wspr_char_code(slash[1]);
+
+  if (isdigit(slash[1]) && isdigit(slash[2]) && slash[3] == '\0')
+    return 60026U + (10 * (slash[1] - '0')) + (slash[2] - '0');
+
+  // Prefix, padded on the left to 3 characters with spaces. Never more than 3 characters, which would overflow m.
+  m = 0;
+  p = (slash - call > 3) ? slash - 3 : call;
+  for (i = slash - p; i < 3; i++) m = (37 * m) + 36;
+  for (; p < slash; p++) m = (37 * m) + wspr_char_code(*p);
+  return m;
+}
+
+// Encode a WSPR-2 message into WSPR2_SYMBOL_COUNT tones (0 to 3). grid is a 4 character locator for a Type 1 message
+// or a 6 character locator for a Type 3 message. A callsign with a '/' makes a Type 2 message in place of a Type 1
+// message, grid is then not sent. dbm has to be one of the valid WSPR power levels (0, 3, 7, 10 ... 60).
+void wspr_encode(const char *call, const char *grid, uint8_t dbm, uint8_t *symbols) {
+  const char *slash = strchr(call, '/');
+  char rotated[7];
+  uint32_t n;          // 28 bit callsign field
+  uint32_t m;          // 22 bit locator and power field
+  uint32_t reg = 0;    // Convolutional encoder shift register
+  uint8_t bit;
+  uint8_t i;
+  uint8_t k;
+  uint8_t j = 0;       // Interleaver index, bit reversed to give the symbol number
+  uint8_t sym;
+
+  if (strlen(grid) == 6) {
+    // Type 3, the locator rotated left by one character (FN25DI becomes N25DIF) packs as a callsign
+    memcpy(rotated, grid + 1, 5);
+    rotated[5] = grid[0];
+    rotated[6] = '\0';
+    n = wspr_pack_call(rotated);
+    m = ((uint32_t)wspr_hash(call) << 7) + 64 - (dbm + 1);
+  }
+  else if (slash != NULL) {
+    // Type 2, the base callsign is the part after a prefix or before a suffix
+    uint16_t affix = wspr_pack_affix(call, slash);
+
+    n = wspr_pack_call((affix >= 60000U) ? call : slash + 1);
+    m = ((uint32_t)(affix & 0x7FFF) << 7) + 64 + dbm + 1 + (affix >> 15);
+  }
+  else {
+    // Type 1
+    n = wspr_pack_call(call);
+    m = (179 - (10 * (grid[0] - 'A')) - (grid[2] - '0')) * 180UL + (10 * (grid[1] - 'A')) + (grid[3] - '0');
+    m = (m << 7) + 64 + dbm;
+  }
+
+  // Each message bit shifted into the encoder gives two symbols, which go to the next two symbol numbers in the
+  // interleaved order. Bit reversed indexes above the symbol count are skipped.
+  for (i = 0; i < WSPR_MSG_BITS; i++) {
+    if (i < 28)
+      bit = (n >> (27 - i)) & 1;
+    else if (i < 50)
+      bit = (m >> (49 - i)) & 1;
+    else
+      bit = 0;
+    reg = (reg << 1) | bit;
+
+    for (k = 0; k < 2; k++) {
+      do {
+        sym = j++;
+        sym = ((sym & 0xF0) >> 4) | ((sym & 0x0F) << 4);
+        sym = ((sym & 0xCC) >> 2) | ((sym & 0x33) << 2);
+        sym = ((sym & 0xAA) >> 1) | ((sym & 0x55) << 1);
+      } while (sym >= WSPR2_SYMBOL_COUNT);
+
+      symbols[sym] = ((pgm_read_byte(&wspr_sync[sym >> 3]) >> (7 - (sym & 7))) & 1) |
+                     (__builtin_parityl(reg & (k ? WSPR_POLY2 : WSPR_POLY1)) << 1);
+    }
+  }
+}
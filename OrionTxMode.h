@@ -0,0 +1,30 @@
+#ifndef ORIONTXMODE_H
+#define ORIONTXMODE_H
+/*
+    OrionTxMode.h - Definitions for the Orion digital transmit mode, WSPR-2
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+
+// WSPR specific defines. DO NOT CHANGE THESE VALUES, EVER!
+#define WSPR2_SYMBOL_COUNT      162
+#define WSPR2_NSPS              8192    // Symbol length in samples at 12000 samples per second, 683 ms
+#define WSPR2_TONE_SPACING_CHZ  146     // 12000 / 8192 = ~1.46 Hz, in hundredths of a hertz
+
+void wspr_encode(const char *call, const char *grid, uint8_t dbm, uint8_t *symbols);
+
+#endif
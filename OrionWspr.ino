@@ -34,7 +34,7 @@
 // Hardware Requirements
 // ---------------------
 // This firmware must be run on an Arduino or an AVR microcontroller with the Arduino Bootloader installed.
-// Pay special attention, the Timer1 Interrupt code is highly dependant on processor clock speed.
+// The WSPR symbol timing (Timer2) and the calibration frequency depend on the processor clock speed (F_CPU).
 //
 // I have tried to keep the AVR/Arduino port usage in the implementation configurable via #defines in OrionBoardConfig.h so that this
 // code can more easily be setup to run on different beacon boards such as those designed by DL6OW and N2NXZ and in future
@@ -43,7 +43,6 @@
 //
 // Required Libraries
 // ------------------
-// Etherkit JTEncode (Library Manager)  https://github.com/etherkit/JTEncode
 // Time (Library Manager)   https://github.com/PaulStoffregen/Time - This provides a Unix-like System Time capability
 // SoftI2CMaster (Software I2C with SoftWire wrapper) https://github.com/felias-fogg/SoftI2CMaster/blob/master/SoftI2CMaster.h - (assumes that you are using Software I2C otherwise Wire.h)
 // NeoGps (https://github.com/SlashDevin/NeoGPS) - NMEA and uBlox GPS parser using Nominal Configuration : date, time, lat/lon, altitude, speed, heading,
@@ -75,7 +74,6 @@
 // WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //
 
-#include <JTEncode.h>
 #include <NMEAGPS.h>  // NeoGps
 #include <TimeLib.h>
 #include <Chrono.h>
@@ -86,8 +84,14 @@
 #include "OrionSerialMonitor.h"
 #include "OrionCalibration.h"
 #include "OrionTelemetry.h"
-#include "OrionQRSS.h"
-#include <LowPower.h>
+#include "OrionQrss.h"
+#include "OrionPerfCounters.h"
+#include "OrionParameters.h"
+#include "OrionHal.h"
+#include "OrionBenchmark.h"
+#include "OrionTxMode.h"
+#include "OrionOscModel.h"
+#include "OrionCheckpoint.h"
 
 // NOTE THAT ALL #DEFINES THAT ARE INTENDED TO BE USER CONFIGURABLE ARE LOCATED IN OrionXConfig.h and OrionBoardConfig.h
 // DON'T TOUCH ANYTHING DEFINED IN THIS FILE WITHOUT SOME VERY CAREFUL CONSIDERATION.
@@ -106,23 +110,23 @@
 #define GPS_STATUS_TIME_ONLY 2         //This needs to match the definition in NeoGPS (GPSfix.h) for STATUS_TIME_ONLY
 #define LAST_MIN_SEC_NOT_SET 61  // For initializing g_last_second and g_last_minute
 
-// WSPR specific defines. DO NOT CHANGE THESE VALUES, EVER!
-#define TONE_SPACING            146                 // ~1.46 Hz
-#define SYMBOL_COUNT            WSPR_SYMBOL_COUNT
-
 // Globals
-JTEncode jtencode;
 
 // GPS related
 static NMEAGPS gps;
 static gps_fix fix;
 bool g_gps_power_state = OFF;
 bool g_gps_time_ok = false; // This boolean is used to determine if we truly have a good time fix from the GPS to set the clock.
+uint32_t g_gps_fix_ms = 0; // millis() when the last valid fix was received
 
 // Note that the constructor for Chrono automatically starts the timer so we need to do a g_chrono_GPS_LOS.stop() in setup()
 // We will then start this timer later when we need it to track how long we have been in a GPS LOS (loss of signal) scenario.
 Chrono g_chrono_GPS_LOS;
 
+// Times the hold-off after a QRSS transmission (QRSS_HOLDOFF_ST), it is only running while we are in that state.
+Chrono g_chrono_qrss_holdoff;
+bool g_last_pps_level = LOW; // Used to detect 1PPS rising edges during the QRSS hold-off
+
 // If we are using software serial to talk to the GPS then we need to create an instance of NeoSWSerial and
 // provide the RX and TX Pin numbers.
 #if !defined (GPS_USES_HW_SERIAL)
@@ -143,55 +147,165 @@ struct OrionTelemetryData g_orion_current_telemetry {0, 0, 0, 0, 0, 0, 0, 0, 0};
 
 // This differs from OrionTelemetryData mostly in that the values are reformatted with the correct units (i.e altitude in metres vs cm etc.)
 // It is used to populate the global values below prior to encoding the WSPR message for TX
-struct OrionTxData g_tx_data  = {'0', 0, 0, 0, 0, 0, 0, 0};
+struct OrionTxData g_tx_data  = {{'0'}, 0, 0, 0, 0, 0, 0, 0};
 
 // The following values are used in the encoding and transmission of the WSPR Type 1 messages.
 // They are populated from g_tx_data according to the implemented Telemetry encoding rules.
-char g_beacon_callsign[7] = BEACON_CALLSIGN_6CHAR;
+// The beacon callsign is a runtime parameter, g_params.callsign (see OrionParameters.h)
 char g_grid_loc[5] = BEACON_GRID_SQ_4CHAR; // Grid Square defaults to hardcoded value it is over-written with a value derived from GPS Coordinates
 uint8_t g_tx_pwr_dbm = BEACON_TX_PWR_DBM;  // This value is overwritten to encode telemetry data.
-uint8_t g_tx_buffer[SYMBOL_COUNT];
+bool g_primary_type3_next = false;          // The next Primary Message is a Type 3 message (type3 parameter)
+OrionWsprMsgType g_planned_telemetry = ALTITUDE_TELEM_MSG;  // Telemetry message of this cycle picked by the planner (telplan parameter)
+uint8_t g_tx_buffer[WSPR2_SYMBOL_COUNT];
 
 // Globals used by the Orion Scheduler
 OrionAction g_current_action = NO_ACTION;
 
+// Reset checkpoint (see OrionCheckpoint.cpp)
+time_t g_checkpoint_time = 0;               // System time of the last checkpoint
+uint8_t g_checkpoint_resumes = 0;           // Resets in a row resumed from the checkpoint, cleared by each transmission
+
 // Global variables used in ISRs
 volatile bool g_proceed = false;
 
-// Timer interrupt vector.  This toggles the variable g_proceed which we use to gate
-// each column of output to ensure accurate timing.  This ISR is called whenever
-// Timer1 hits the WSPR_CTC value used below in setup().
-ISR(TIMER1_COMPA_vect)
+// WSPR symbol timing on Timer2, which leaves Timer1 free to count the calibration clock during a transmission.
+// A symbol is nsps / 12000 seconds, which isn't a whole number of F_CPU / 1024 ticks (5333.33 ticks of 128 us for WSPR-2
+// at 8 MHz). Each symbol gets the whole number of ticks and the fractions are carried over to the next symbol, the way
+// Bresenham draws a line, so the symbols are 5333 or 5334 ticks and the whole frame is right to within a tick.
+// The 8 bit timer can only count 256 ticks at a time so a symbol is made of several timer periods. The last two
+// share what is left over, so that no period is too short for the ISR to program the next one in time.
+#define SYM_TICK_DEN        (1024UL * 12000UL)  // The ticks per symbol are F_CPU x nsps / SYM_TICK_DEN
+#define SYM_TIMER2_PERIOD   256                 // Longest Timer2 period, in ticks
+
+static uint32_t g_sym_ticks_whole;              // Whole ticks per symbol
+static uint32_t g_sym_ticks_frac;               // And the fraction, over SYM_TICK_DEN
+static volatile uint32_t g_sym_frac_acc;        // Fraction carried over from the previous symbols
+static volatile uint32_t g_sym_ticks_left;      // Ticks left in the current symbol, including the current period
+static volatile uint16_t g_sym_period;          // Ticks in the current Timer2 period
+
+uint16_t sym_next_period(uint32_t ticks_left) {
+  if (ticks_left > (2 * SYM_TIMER2_PERIOD)) return SYM_TIMER2_PERIOD;
+  if (ticks_left > SYM_TIMER2_PERIOD) return ticks_left / 2;
+  return ticks_left;
+}
+
+// Start the symbol clock for symbols of nsps samples. g_proceed is set at the end of each symbol.
+void start_symbol_clock(uint32_t nsps) {
+  uint64_t ticks = (uint64_t)F_CPU * nsps;
+
+  g_sym_ticks_whole = ticks / SYM_TICK_DEN;
+  g_sym_ticks_frac = ticks % SYM_TICK_DEN;
+  g_sym_frac_acc = SYM_TICK_DEN / 2;   // Round the end of each symbol to the nearest tick
+  g_sym_ticks_left = g_sym_ticks_whole;
+  g_sym_period = sym_next_period(g_sym_ticks_left);
+  g_proceed = false;
+  hal_timer2_start_ctc(g_sym_period - 1);
+}
+
+// Timer interrupt vector. This sets the variable g_proceed at the end of each symbol, which we use to gate
+// each column of output to ensure accurate timing.
+ISR(TIMER2_COMPA_vect)
 {
-  g_proceed = true;
+  uint32_t left = g_sym_ticks_left - g_sym_period;
+  uint32_t acc;
+
+  if (left == 0) {
+    HAL_PROBE_TOGGLE(PROBE_BIT_SYMBOL);
+    g_proceed = true;
+    g_isr_counts.timer2_compa++;
+
+    left = g_sym_ticks_whole;
+    acc = g_sym_frac_acc + g_sym_ticks_frac;
+    if (acc >= SYM_TICK_DEN) {
+      acc -= SYM_TICK_DEN;
+      left++;
+    }
+    g_sym_frac_acc = acc;
+  }
+
+  g_sym_ticks_left = left;
+  g_sym_period = sym_next_period(left);
+  hal_timer2_set_top(g_sym_period - 1);
 }
 
 // ------- Functions ------------------
 
+// Hash used for the QRM Avoidance hopping plan, 32 bit FNV-1a
+static uint32_t hop_hash(uint32_t h, uint8_t b) {
+  return (h ^ b) * 16777619UL;
+}
+
 unsigned long get_tx_frequency() {
   /********************************************************************************
     Get the frequency for the next transmission cycle
     This function also implements the QRM Avoidance feature
-    which applies a pseudo-random offset of 0 to 180 hz to the base TX frequency
+
+    QRM Avoidance hops between channels QRM_HOP_CHANNEL_HZ apart across QRM_HOP_SPAN_HZ above the base TX frequency,
+    less a margin at each end for the calibration uncertainty. The channel is chosen by a hash of the callsign and
+    the 2 minute slot of the transmission, so two beacons only collide if they pick the same channel, which is much
+    less likely than overlapping at random, and a collision in one slot says nothing about the next. The plan is
+    deterministic so the frequency of every transmission can be reproduced on the ground, see tools/orion_hop_sim.py :
+
+      slot    = UTC seconds since 1970 at the start of the transmission / 120
+      hash    = FNV-1a (32 bit) of the callsign characters followed by the 4 bytes of slot, least significant first
+      margin  = base frequency x QRM_HOP_CAL_UNCERTAINTY_PPB / 10^9, rounded up
+      offset  = margin + (hash % channels) x QRM_HOP_CHANNEL_HZ
+      channels = (QRM_HOP_SPAN_HZ - 2 x margin) / QRM_HOP_CHANNEL_HZ + 1
+
+    This is called a minute or less before the transmission starts (at hh:m9 for the Primary message and at the start of the
+    Telemetry slot), so the slot is that of the time a minute from now.
   ********************************************************************************/
+  uint32_t h = 2166136261UL; // FNV offset basis
+  uint32_t slot;
+  uint16_t margin;
+  uint16_t channels;
+  byte i;
+
   if (is_qrm_avoidance_on() == false)
-    return FIXED_BEACON_FREQ_HZ;
+    return g_params.fixed_beacon_freq_hz;
   else {
-    // QRM Avoidance - add a random number in range of 0 to 180 to the base TX frequency to help avoid QRM
-    return (BEACON_FREQ_HZ + random(181)); // base freq + 0 to 180 hz random offset
+    slot = (now() + 60) / 120;
+    for (i = 0; g_params.callsign[i] != '\0'; i++) h = hop_hash(h, g_params.callsign[i]);
+    for (i = 0; i < 4; i++) h = hop_hash(h, (uint8_t)(slot >> (8 * i)));
+
+    margin = ((uint64_t)g_params.beacon_freq_hz * QRM_HOP_CAL_UNCERTAINTY_PPB + 999999999ULL) / 1000000000ULL;
+    channels = ((QRM_HOP_SPAN_HZ - (2 * margin)) / QRM_HOP_CHANNEL_HZ) + 1;
+
+    return (g_params.beacon_freq_hz + margin + ((h % channels) * QRM_HOP_CHANNEL_HZ));
   }
 
 }
 
+// The second TX clock, transmitting either on a second band (dual band) or in antiphase with SI5351A_WSPRTX_CLK_NUM (push-pull)
+#if defined (SI5351A_WSPRTX2_CLK_NUM) && defined (SI5351A_PUSH_PULL_CLK_NUM)
+#error "Dual band (SI5351A_WSPRTX2_CLK_NUM) and push-pull (SI5351A_PUSH_PULL_CLK_NUM) both need the second TX clock, only define one"
+#elif defined (SI5351A_WSPRTX2_CLK_NUM)
+#define TX_PAIR_CLK_NUM SI5351A_WSPRTX2_CLK_NUM
+#elif defined (SI5351A_PUSH_PULL_CLK_NUM)
+#define TX_PAIR_CLK_NUM SI5351A_PUSH_PULL_CLK_NUM
+#endif
+
+#if defined (TX_PAIR_CLK_NUM)
+static_assert((TX_PAIR_CLK_NUM != SI5351A_WSPRTX_CLK_NUM) && (TX_PAIR_CLK_NUM != SI5351A_PARK_CLK_NUM) &&
+              (TX_PAIR_CLK_NUM != SI5351A_CAL_CLK_NUM), "The second TX clock must be a clock of its own");
+#endif
+
+#if defined (SI5351A_WSPRTX2_CLK_NUM)
+// The second band uses the same offset from freq2 as g_beacon_freq_hz has from fixfreq, so that QRM Avoidance moves both bands
+unsigned long get_tx2_frequency() {
+  return g_params.beacon2_freq_hz + (long)(g_beacon_freq_hz - g_params.fixed_beacon_freq_hz);
+}
+#endif
+
 // -- Telemetry -------
 
-void calculate_gridsquare_6char(float lat, float lon) {
+void calculate_gridsquare_6char(float lat, float lon, char *grid) {
   /***************************************************************************************
     Calculate the 6 Character Maidenhead Gridsquare from the Lat and Long Coordinates
     We follow the convention that West and South are negative Lat/Long.
   ***************************************************************************************/
-  // This puts the calculated 6 character Maidenhead Grid square into the field grid_sq_6char[]
-  // of g_tx_data
+  // This puts the calculated 6 character Maidenhead Grid square, null terminated, into grid[] which must hold
+  // 7 characters. Pass g_tx_data.grid_sq_6char only when the result is the grid square to be transmitted.
 
   // Temporary variables for calculation
   int o1, o2, o3;
@@ -215,13 +329,13 @@ void calculate_gridsquare_6char(float lat, float lon) {
   a3 = (int)(24.0 * remainder);
 
   // Generate the 6 character Grid Square
-  g_tx_data.grid_sq_6char[0] = (char)o1 + 'A';
-  g_tx_data.grid_sq_6char[1] = (char)a1 + 'A';
-  g_tx_data.grid_sq_6char[2] = (char)o2 + '0';
-  g_tx_data.grid_sq_6char[3] = (char)a2 + '0';
-  g_tx_data.grid_sq_6char[4] = (char)o3 + 'A';
-  g_tx_data.grid_sq_6char[5] = (char)a3 + 'A';
-  g_tx_data.grid_sq_6char[6] = (char)0;
+  grid[0] = (char)o1 + 'A';
+  grid[1] = (char)a1 + 'A';
+  grid[2] = (char)o2 + '0';
+  grid[3] = (char)a2 + '0';
+  grid[4] = (char)o3 + 'A';
+  grid[5] = (char)a3 + 'A';
+  grid[6] = (char)0;
 } // calculate_gridsquare_6char
 
 
@@ -305,7 +419,7 @@ void set_tx_data() {
   byte i;
 
   // Calculate the 6 character grid square and put it into g_tx_data.grid_sq_6char[]
-  calculate_gridsquare_6char(g_orion_current_telemetry.latitude, g_orion_current_telemetry.longitude);
+  calculate_gridsquare_6char(g_orion_current_telemetry.latitude, g_orion_current_telemetry.longitude, g_tx_data.grid_sq_6char);
 
   // Copy the first four characters of the Grid Square to g_grid_loc[] for use in the Primary Type 1 WSPR Message
   for (i = 0; i < 4; i++ ) g_grid_loc[i] = g_tx_data.grid_sq_6char[i];
@@ -332,63 +446,217 @@ void set_tx_data() {
   orion_log_telemetry (&g_tx_data);  // Pass a pointer to the g_tx_data structure
 }
 
+// Compose the QRSS fallback message from the last valid telemetry : callsign, 6 character grid square, altitude in
+// hundreds of metres and battery voltage x 10, e.g. "  VE3WMB FN25DG 120 41 ". Returns false if we have never had
+// a position fix, in which case the compile time QRSS_MESSAGE is sent instead.
+bool compose_qrss_message(char *msg, byte size) {
+  char num[8];
+  char grid[7];
+  long altitude_hm;
+
+  if ((g_last_valid_telemetry.latitude == 0) && (g_last_valid_telemetry.longitude == 0)) return false;
+
+  // A local grid square, g_tx_data holds the one for the next WSPR transmission
+  calculate_gridsquare_6char(g_last_valid_telemetry.latitude, g_last_valid_telemetry.longitude, grid);
+  altitude_hm = (g_last_valid_telemetry.altitude_cm < 0) ? 0 : g_last_valid_telemetry.altitude_cm / 10000;
+
+  strlcpy(msg, "  ", size);
+  strlcat(msg, g_params.callsign, size);
+  strlcat(msg, " ", size);
+  strlcat(msg, grid, size);
+  strlcat(msg, " ", size);
+  strlcat(msg, ltoa(altitude_hm, num, 10), size);
+  strlcat(msg, " ", size);
+  strlcat(msg, itoa(g_last_valid_telemetry.battery_voltage_v_x10, num, 10), size);
+  strlcat(msg, " ", size);
+  return true;
+}
+
+// The temperature sent in the Temperature Telemetry message
+uint8_t encode_telemetry_temperature() {
+#if defined (DS1820_TEMP_SENSOR_PRESENT) | defined (TMP36_TEMP_SENSOR_PRESENT )
+  return encode_temperature(g_tx_data.temperature_c); // Use Sensor data
+#else
+  return encode_temperature(g_tx_data.processor_temperature_c); // Use internal processor temperature
+#endif
+}
+
 void prepare_telemetry()
 {
+  uint8_t telemetry_dbm[3];
+
   get_telemetry_data();
 
   set_tx_data();
 
-  // We encode the 5th and 6th characters of the Grid square into the PWR/dBm field of the WSPR message.
-  g_tx_pwr_dbm = encode_gridloc_char5_char6(g_tx_data.grid_sq_6char[4], g_tx_data.grid_sq_6char[5]);
+  if (g_params.telemetry_planner == ON) {
+    // Let the planner pick this cycle's Telemetry message from the fresh values, in ALTITUDE_TELEM_MSG,
+    // TEMPERATURE_TELEM_MSG, VOLTAGE_TELEM_MSG order, and announce it in the PWR/dBm field of the Primary message.
+    telemetry_dbm[0] = encode_altitude(g_tx_data.altitude_m);
+    telemetry_dbm[1] = encode_telemetry_temperature();
+    telemetry_dbm[2] = encode_voltage(g_tx_data.battery_voltage_v_x10);
+    g_planned_telemetry = telemetry_plan(telemetry_dbm);
+    g_tx_pwr_dbm = telemetry_plan_announce_dbm(g_planned_telemetry);
+  }
+  else {
+    // We encode the 5th and 6th characters of the Grid square into the PWR/dBm field of the WSPR message.
+    g_tx_pwr_dbm = encode_gridloc_char5_char6(g_tx_data.grid_sq_6char[4], g_tx_data.grid_sq_6char[5]);
+  }
 
 } //end prepare_telemetry
 
-void encode_and_tx_wspr_msg() {
+#if defined (ORION_BENCHMARK_SUPPORTED)
+// Benchmark bodies for the "bench" serial monitor command, see OrionBenchmark.cpp. They are here because they use
+// objects that belong to the sketch. QRSS uses g_tx_buffer so the monitor doesn't run the benchmarks during QRSS.
+
+void bench_wspr_encode() {
+  wspr_encode(g_params.callsign, g_grid_loc, g_tx_pwr_dbm, g_tx_buffer);
+}
+
+// Into a local buffer, so that a bench run doesn't change the grid square of the next transmission. The position is
+// read from, and the result written to, volatiles so that the compiler can't work the call out at compile time.
+static volatile float bench_lat = 45.4215;
+static volatile float bench_lon = -75.6972;
+static volatile char bench_grid_sink;
+
+void bench_gridsquare() {
+  char grid[7];
+
+  calculate_gridsquare_6char(bench_lat, bench_lon, grid);
+  bench_grid_sink = grid[5];
+}
+
+// A separate parser instance so that the live GPS fix isn't disturbed
+const char bench_nmea_sentence[] PROGMEM = "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n";
+
+void bench_nmea_parse() {
+  static NMEAGPS bench_gps;
+  char c;
+
+  for (byte i = 0; (c = pgm_read_byte(&bench_nmea_sentence[i])) != '\0'; i++)
+    bench_gps.decode(c);
+}
+#endif
+
+// With the oscmodel parameter on, transmit with the correction factor that the oscillator model predicts for the current
+// time and temperature (from the last telemetry) rather than the last calibrated value, see OrionOscModel.cpp.
+void apply_osc_model() {
+  if (g_params.osc_model == OFF) return;
+
+  osc_model_time_update(now(), g_tx_data.temperature_c);
+  si5351bx_set_correction(osc_model_correction());
+  log_osc_model(osc_model_correction(), osc_model_sigma_ppb(), false);
+}
+
+#if defined (TX_PAIR_CLK_NUM)
+// Dual band or push-pull. The tones of both TX clocks are calculated up front so that each symbol only needs the
+// one I2C burst that changes both multisynths. Dual band sends the same frame on the second band, the two halves
+// of a push-pull pair are on the same frequency.
+void calc_pair_tones(uint8_t tones[2][4][8]) {
+  uint8_t j;
+
+  for (j = 0; j < 4; j++) {
+    si5351bx_calc_msynth((g_beacon_freq_hz * 100ULL) + (j * WSPR2_TONE_SPACING_CHZ), tones[0][j]);
+#if defined (SI5351A_WSPRTX2_CLK_NUM)
+    si5351bx_calc_msynth((get_tx2_frequency() * 100ULL) + (j * WSPR2_TONE_SPACING_CHZ), tones[1][j]);
+#else
+    memcpy(tones[1][j], tones[0][j], sizeof(tones[0][j]));
+#endif
+  }
+}
+#endif
+
+void update_checkpoint(); // Defined below. The Arduino IDE generates prototypes, the host build doesn't.
+
+void encode_and_tx_wspr_msg(const char *grid) {
   /**************************************************************************
-    Transmit the Primary WSPR Message
+    Transmit a WSPR Message
     Loop through the transmit buffer, transmitting one character at a time.
+    grid is the 4 character locator of a Type 1 message or the 6 character locator of a Type 3 message
   * ************************************************************************/
   uint8_t i;
+#if defined (TX_PAIR_CLK_NUM)
+  uint8_t tones[2][4][8];  // Multisynth register images of the four tones, for each TX clock
+#endif
+
+  apply_osc_model();
 
-  // Encode the primary message paramters into the TX Buffer
-  jtencode.wspr_encode(g_beacon_callsign, g_grid_loc, g_tx_pwr_dbm, g_tx_buffer);
+  // Encode the message paramters into the TX Buffer
+  wspr_encode(g_params.callsign, grid, g_tx_pwr_dbm, g_tx_buffer);
+
+#if defined (TX_PAIR_CLK_NUM)
+  calc_pair_tones(tones);
+#endif
+
+  perf_tx_start();
 
   // Reset the tone to 0 and turn on the TX output
   si5351bx_setfreq(SI5351A_WSPRTX_CLK_NUM, (g_beacon_freq_hz * 100ULL), SI5351_CLK_ON);
+#if defined (SI5351A_WSPRTX2_CLK_NUM)
+  si5351bx_setfreq(SI5351A_WSPRTX2_CLK_NUM, (get_tx2_frequency() * 100ULL), SI5351_CLK_ON);
+#elif defined (SI5351A_PUSH_PULL_CLK_NUM)
+  // The inverted half of the push-pull pair (see si5351bx_clk_inv). Resetting the PLL restarts both multisynths
+  // together, which lines them up 180 degrees apart. Identical updates then keep them locked for the whole message.
+  si5351bx_setfreq(SI5351A_PUSH_PULL_CLK_NUM, (g_beacon_freq_hz * 100ULL), SI5351_CLK_ON);
+  si5351bx_reset_pll();
+#endif
 
   // Turn off the PARK clock
-  si5351bx_enable_clk(SI5351A_PARK_CLK_NUM, SI5351_CLK_OFF);
+  si5351bx_park(SI5351_CLK_OFF);
 
   // If we are using the TX LED turn it on
 #if defined(TX_LED_PRESENT)
   digitalWrite(TX_LED_PIN, HIGH);
 #endif
 
-  // We need to synchronize the 1.46 Hz (682.68 milliSecond) Timer/Counter-1 interrupt to the start of WSPR transmission as it is free-running.
-  // We reset the counts to zero so we ensure that the first symbol is not truncated (i.e we get a full 682.68 milliseconds before the interrupt handler sets
-  // the g_proceed flag).
-  noInterrupts();
-   TCNT1 = 0; // Clear the count for Timer/Counter-1
-   GTCCR = (1 << PSRSYNC); // Do a reset on the pre-scaler. Note that we are not using Timer 0, it shares a prescaler so it would also be impacted.
-   TIMSK1 = (1 << OCIE1A);  // Make double sure that the timer1 compare interrupt is enabled, otherwise we are stuck !
-  interrupts();
-  
+  // Count the calibration clock on Timer1 during the transmission if the txmon parameter is on
+  tx_monitor_start();
+
+  // Start the symbol clock from zero so that the first symbol gets its full length (682.67 milliseconds)
+  start_symbol_clock(WSPR2_NSPS);
+
   // Now send the rest of the message
-  for (i = 0; i < SYMBOL_COUNT; i++)
+  for (i = 0; i < WSPR2_SYMBOL_COUNT; i++)
   {
-    si5351bx_setfreq(SI5351A_WSPRTX_CLK_NUM, (g_beacon_freq_hz * 100ULL) + (g_tx_buffer[i] * TONE_SPACING), SI5351_CLK_ON);
-    g_proceed = false;
+#if defined (TX_PAIR_CLK_NUM)
+    if (SI5351A_WSPRTX_CLK_NUM < TX_PAIR_CLK_NUM)
+      si5351bx_update_msynth_pair(SI5351A_WSPRTX_CLK_NUM, tones[0][g_tx_buffer[i]], TX_PAIR_CLK_NUM, tones[1][g_tx_buffer[i]]);
+    else
+      si5351bx_update_msynth_pair(TX_PAIR_CLK_NUM, tones[1][g_tx_buffer[i]], SI5351A_WSPRTX_CLK_NUM, tones[0][g_tx_buffer[i]]);
+#else
+    si5351bx_setfreq(SI5351A_WSPRTX_CLK_NUM, (g_beacon_freq_hz * 100ULL) + (g_tx_buffer[i] * WSPR2_TONE_SPACING_CHZ), SI5351_CLK_ON);
+#endif
 
-    // We spin our wheels in TX here, waiting until the Timer1 Interrupt sets the g_proceed flag
+    // Apply any correction from the frequency monitor at the start of the symbol, well clear of the next symbol change.
+    // The dual band and push-pull tones have the correction built in, so they are calculated again.
+    if (tx_monitor_poll()) {
+#if defined (TX_PAIR_CLK_NUM)
+      calc_pair_tones(tones);
+#endif
+    }
+
+    update_checkpoint(); // Keep the checkpoint time current during long transmissions
+
+    // We spin our wheels in TX here, waiting until the Timer2 Interrupt sets the g_proceed flag.
     // Then we can go back to the top of the for loop to start sending the next symbol
-    while (!g_proceed);
+    while (!g_proceed) hal_spin();
+    g_proceed = false;
   }
 
+  hal_timer2_disable();
+  tx_monitor_stop();
+  g_checkpoint_resumes = 0; // We are making progress, the next reset can resume again
+
   // Turn off the WSPR TX clock output, we are done sending the message
   si5351bx_enable_clk(SI5351A_WSPRTX_CLK_NUM, SI5351_CLK_OFF);
+#if defined (TX_PAIR_CLK_NUM)
+  si5351bx_enable_clk(TX_PAIR_CLK_NUM, SI5351_CLK_OFF);
+#endif
+
+  perf_tx_end();
 
   // Re-enable the Park Clock
-  si5351bx_setfreq(SI5351A_PARK_CLK_NUM, (PARK_FREQ_HZ * 100ULL), SI5351_CLK_ON); // Turn on Park Clock
+  si5351bx_park(SI5351_CLK_ON); // Turn on Park Clock
 
 
   // If we are using the TX LED turn it off
@@ -408,7 +676,7 @@ void get_gps_fix_and_time() {
     fix = gps.read();
 
     if ( (fix.valid.status) && (fix.status > GPS_STATUS_TIME_ONLY)) {
-       
+      g_gps_fix_ms = millis();
 
       // If we have a valid fix, set the Time on the Arduino if needed, This handles the intial time setting case
       if ( timeStatus() == timeNotSet ) { // System date/time isn't set so set it
@@ -460,10 +728,14 @@ void shutdown_beacon_operation() { // Called on the reception of an INITIATE_SHU
 
   // Turn off all of the Si5351 clocks
   si5351bx_enable_clk(SI5351A_WSPRTX_CLK_NUM, SI5351_CLK_OFF);
-  si5351bx_enable_clk(SI5351A_PARK_CLK_NUM, SI5351_CLK_OFF);
+  si5351bx_park(SI5351_CLK_OFF);
   si5351bx_enable_clk(SI5351A_CAL_CLK_NUM, SI5351_CLK_OFF);
+#if defined (TX_PAIR_CLK_NUM)
+  si5351bx_enable_clk(TX_PAIR_CLK_NUM, SI5351_CLK_OFF);
+#endif
 
   log_shutdown(g_tx_data.battery_voltage_v_x10); // Log the shutdown
+  checkpoint_clear(); // Start from scratch on the next reset
 
   // Cut power to GPS and SI5351 if the board supports it
 
@@ -501,10 +773,11 @@ bool operating_voltage_wait() {
     while (sleep_count < 75){ // Sleep/Wake for 10 minutes (75 x 8 seconds)
       
       //Power Down for 8 seconds - we wake up automatically via the WDC
-      LowPower.powerDown(SLEEP_8S, ADC_OFF, BOD_ON); // Enter power down state for 8 s with ADC disabled but Brown-Out detection still on. 
+      hal_sleep_power_down_8s(); // Enter power down state for 8 s with ADC disabled but Brown-Out detection still on. 
       
       // Now we are awake
       sleep_count++; 
+      g_perf.sleep_ms += 8000;
     }
     
     volt_loop_guard_tmr.add(600000); // We need to account for the 10 minutes we were mostly powered down so add this to the guard timer
@@ -541,10 +814,15 @@ void setup_si5351_and_gps() {
 
     // Setup WSPR TX output
     si5351bx_setfreq(SI5351A_WSPRTX_CLK_NUM, (g_beacon_freq_hz * 100ULL), SI5351_CLK_OFF); // Disable the TX clock initially 
+#if defined (SI5351A_WSPRTX2_CLK_NUM)
+    si5351bx_setfreq(SI5351A_WSPRTX2_CLK_NUM, (g_params.beacon2_freq_hz * 100ULL), SI5351_CLK_OFF);
+#elif defined (SI5351A_PUSH_PULL_CLK_NUM)
+    si5351bx_setfreq(SI5351A_PUSH_PULL_CLK_NUM, (g_beacon_freq_hz * 100ULL), SI5351_CLK_OFF);
+#endif
 
     // Set PARK CLK Output - Note that we leave SI5351A_PARK_CLK_NUM running at 108 Mhz to keep the SI5351 temperature more constant
     // This minimizes thermal induced drift during WSPR transmissions. The idea is borrowed from G0UPL's PARK feature on the QRP Labs U3S
-    si5351bx_setfreq(SI5351A_PARK_CLK_NUM, (PARK_FREQ_HZ * 100ULL), SI5351_CLK_ON); // Turn on Park Clock
+    si5351bx_park(SI5351_CLK_ON); // Turn on Park Clock
       
 }
 
@@ -583,14 +861,19 @@ OrionAction handle_calibration_result(OrionCalibrationResult cal_result, OrionAc
             This helps to keep us transmitting with the 200 Hz WSPR "window". 
           */
           
-          disable_qrm_avoidance();// Failed calibration due to GPS LOS so we can't be certain we will stay within the WSPR window if we jump around.
+          // Failed calibration due to GPS LOS so we can't be certain we will stay within the WSPR window if we jump around,
+          // unless the oscillator model still predicts the correction to within the margin left at the ends of the hop span.
+          if ((g_params.osc_model == OFF) || (osc_model_sigma_ppb() > (QRM_HOP_CAL_UNCERTAINTY_PPB / 2)))
+            disable_qrm_avoidance();
           
           if (g_chrono_GPS_LOS.isRunning() == true){ // The GPS LOS virtual guard timer is running 
 
             if ( (g_chrono_GPS_LOS.hasPassed(GPS_LOS_GUARD_TMO_MS, false) ) == true) {
               // The GPS LOS time exceeds GPS_LOS_GUARD_TMO_M so trigger a timeout event (scenario 2)
-              // We keep the GPS LOS virtual timer running so we know that we are still in LOS
+              // We keep the GPS LOS virtual timer running so we know that we are still in LOS, but restart it already expired so that
+              // its elapsed time can't wrap around after 49.7 days of LOS and look unexpired again.
              
+             g_chrono_GPS_LOS.restart(GPS_LOS_GUARD_TMO_MS + 1);
              action = orion_state_machine(GPS_LOS_TIMEOUT_EV);  
             }
             else { //The GPS LOS guard timer is running but hasn't expired so business as usual, but without QRM avoidance (scenario 1)
@@ -667,29 +950,24 @@ OrionAction process_orion_sm_action (OrionAction action) {
       break;
 
 
-    case WSPR_TX_INT_SETUP_ACTION :
-      // This action is used to handle the case where self calibration is not supported by the board in use.
-      // Usually we rely on the post-calibration clean-up to setup and enable the WSPR TX Interrupt
-      // so this is no longer done in setup(). In the case where we skip the Startup self-calibration,
-      // because self-calibration isn't suported, we need a mechanism to setup this timer Interrupt, so
-      // here it is.
-
-      // Setup 1.46 Hz Timer1 interrupt for WSPR Transmission
-      wspr_tx_interrupt_setup();
-      returned_action = NO_ACTION;
-      break;
-
-
     case CALIBRATION_ACTION : {
       OrionCalibrationResult cal_result = PASS;
 
+      if (g_params.osc_model == ON) {
+        osc_model_time_update(now(), g_tx_data.temperature_c);
+
+        // Outside of a GPS LOS, skip the calibration when the oscillator model is good enough on its own
+        if ((g_chrono_GPS_LOS.isRunning() == false) && osc_model_skip_calibration()) {
+          log_osc_model(osc_model_correction(), osc_model_sigma_ppb(), true);
+          returned_action = orion_state_machine(CALIBRATION_DONE_EV);
+          break;
+        }
+      }
+
       // re-initialize Interrupts for calibration
       reset_for_calibration();
  
-      cal_result = do_calibration(FINE_CORRECTION_STEP, CALIBRATION_GUARD_TMO_MS);
-
-      // Restore Timer1 interrupt for WSPR Transmission
-      wspr_tx_interrupt_setup();
+      cal_result = do_calibration(g_params.fine_cal_step, CALIBRATION_GUARD_TMO_MS);
 
       returned_action = handle_calibration_result(cal_result, action);
     }
@@ -698,14 +976,14 @@ OrionAction process_orion_sm_action (OrionAction action) {
     case STARTUP_CALIBRATION_ACTION : {
       OrionCalibrationResult cal_result = PASS;
 
+      if (g_params.osc_model == ON)
+        osc_model_time_update(now(), g_tx_data.temperature_c);
+
       // Initialize Interrupts for Initial calibration
       setup_calibration();
 
       //TODO This should be modified with a boolean return code so we can handle calibration fail.
-      cal_result = do_calibration(COARSE_CORRECTION_STEP, INITIAL_CALIBRATION_GUARD_TMO_MS); // Initial calibration with 1 Hz correction step
-
-      // Reset the Timer1 interrupt for WSPR transmission
-      wspr_tx_interrupt_setup();
+      cal_result = do_calibration(g_params.coarse_cal_step, INITIAL_CALIBRATION_GUARD_TMO_MS); // Initial calibration with 1 Hz correction step
 
       returned_action = handle_calibration_result(cal_result, action);
     }
@@ -734,10 +1012,21 @@ OrionAction process_orion_sm_action (OrionAction action) {
       // It is the same story for :
       //  g_beacon_freq_hz = get_tx_frequency(); .. this is already covered for the Primary Msg in the Telemetry Phase.
 
-      // Encode and transmit the Primary WSPR Message
-      encode_and_tx_wspr_msg();
-
-      orion_log_wspr_tx(PRIMARY_WSPR_MSG, g_tx_data.grid_sq_6char, g_beacon_freq_hz, g_tx_pwr_dbm); // If TX Logging is enabled then ouput a lo
+      // With the type3 parameter on, every other Primary Message is a Type 3 message carrying the full 6 character
+      // locator and the beacon power. Receivers learn the callsign hash it uses from the Type 1 message in between.
+      // The telemetry planner announcement is sent in place of the power.
+      if ((g_params.wspr_type3 == ON) && g_primary_type3_next) {
+        if (g_params.telemetry_planner == OFF) g_tx_pwr_dbm = BEACON_TX_PWR_DBM;
+        encode_and_tx_wspr_msg(g_tx_data.grid_sq_6char);
+        orion_log_wspr_tx(PRIMARY_TYPE3_WSPR_MSG, g_tx_data.grid_sq_6char, g_beacon_freq_hz, g_tx_pwr_dbm);
+        g_primary_type3_next = false;
+      }
+      else {
+        // Encode and transmit the Primary WSPR Message
+        encode_and_tx_wspr_msg(g_grid_loc);
+        orion_log_wspr_tx(PRIMARY_WSPR_MSG, g_tx_data.grid_sq_6char, g_beacon_freq_hz, g_tx_pwr_dbm); // If TX Logging is enabled then ouput a log
+        g_primary_type3_next = true;
+      }
 
       // Tell the Orion state machine that we are done tranmitting the Primary WSPR message and update the current_action
       returned_action = orion_state_machine(PRIMARY_WSPR_TX_DONE_EV);
@@ -750,11 +1039,12 @@ OrionAction process_orion_sm_action (OrionAction action) {
 
       // At  hh:02, hh:22, hh:42 encode and transmit the Secondary WSPR Message with altitude encoded into the pwr/dBm field
       g_tx_pwr_dbm = encode_altitude(g_tx_data.altitude_m);
+      telemetry_plan_sent(ALTITUDE_TELEM_MSG, g_tx_pwr_dbm);
 
       // Set the transmit frequency. This will ensure that QRM Avoidance is utilized for Telemetry Messages as well (i.e different TX frequency than Primary WSPR Msg)
       g_beacon_freq_hz = get_tx_frequency();
 
-      encode_and_tx_wspr_msg();
+      encode_and_tx_wspr_msg(g_grid_loc);
       orion_log_wspr_tx(ALTITUDE_TELEM_MSG, g_tx_data.grid_sq_6char, g_beacon_freq_hz, g_tx_pwr_dbm); // If TX Logging is enabled then ouput a log
 
       // Tell the Orion state machine that we are done tranmitting the Telemetry WSPR message and update the current_action
@@ -766,11 +1056,12 @@ OrionAction process_orion_sm_action (OrionAction action) {
 
       // At hh:12, hh:22, hh:52 encode and transmit the Secondary WSPR Message with voltage encoded into the pwr/dBm field
       g_tx_pwr_dbm = encode_voltage(g_tx_data.battery_voltage_v_x10);
+      telemetry_plan_sent(VOLTAGE_TELEM_MSG, g_tx_pwr_dbm);
 
       // Set the transmit frequency. This will ensure that QRM Avoidance is utilized for Telemetry Messages as well (i.e different TX frequency than Primary WSPR Msg)
       g_beacon_freq_hz = get_tx_frequency();
 
-      encode_and_tx_wspr_msg();
+      encode_and_tx_wspr_msg(g_grid_loc);
       orion_log_wspr_tx(VOLTAGE_TELEM_MSG, g_tx_data.grid_sq_6char, g_beacon_freq_hz, g_tx_pwr_dbm); // If TX Logging is enabled then ouput a log
 
       // Tell the Orion state machine that we are done tranmitting the Telemetry WSPR message and update the current_action
@@ -780,15 +1071,12 @@ OrionAction process_orion_sm_action (OrionAction action) {
 
     case TX_WSPR_MIN32_ACTION : //  -  TX temperature Telemetry
       // At hh:32 encode and transmit the Secondary WSPR Message with temperature encoded into the pwr/dBm field
-#if defined (DS1820_TEMP_SENSOR_PRESENT) | defined (TMP36_TEMP_SENSOR_PRESENT )
-      g_tx_pwr_dbm = encode_temperature(g_tx_data.temperature_c); // Use Sensor data
-#else
-      g_tx_pwr_dbm = encode_temperature(g_tx_data.processor_temperature_c); // Use internal processor temperature
-#endif
+      g_tx_pwr_dbm = encode_telemetry_temperature();
+      telemetry_plan_sent(TEMPERATURE_TELEM_MSG, g_tx_pwr_dbm);
       // Set the transmit frequency. This will ensure that QRM Avoidance is utilized for Telemetry Messages as well (i.e different TX frequency than Primary WSPR Msg)
       g_beacon_freq_hz = get_tx_frequency();
 
-      encode_and_tx_wspr_msg();
+      encode_and_tx_wspr_msg(g_grid_loc);
       orion_log_wspr_tx(TEMPERATURE_TELEM_MSG, g_tx_data.grid_sq_6char, g_beacon_freq_hz, g_tx_pwr_dbm); // If TX Logging is enabled then ouput a log
 
       // Tell the Orion state machine that we are done transmitting the Telemetry WSPR message and update the current_action
@@ -821,10 +1109,24 @@ OrionAction process_orion_sm_action (OrionAction action) {
        }
        break;
       
-    case QRSS_TX_ACTION :
-        qrss_beacon();
-        returned_action = orion_state_machine(QRSS_TX_DONE_EV);
-        break; 
+    case QRSS_HOLDOFF_ACTION :
+      // Start timing the hold-off, loop() calls qrss_holdoff_check() until it ends
+      g_chrono_qrss_holdoff.restart();
+      g_last_pps_level = digitalRead(GPS_PPS_PIN);
+      returned_action = NO_ACTION;
+      break;
+
+    case QRSS_TX_ACTION : {
+      // The QRSS transmission is serviced from loop(), which sends QRSS_TX_DONE_EV when it completes.
+      // The WSPR symbol buffer is idle until the next WSPR transmission so the keyer uses it for the encoded message.
+      char qrss_msg[QRSS_MAX_MESSAGE_LEN + 1];
+
+      apply_osc_model();
+      qrss_start((QrssMode)g_params.qrss_mode, (QrssSpeed)g_params.qrss_speed,
+                 compose_qrss_message(qrss_msg, sizeof(qrss_msg)) ? qrss_msg : NULL, g_tx_buffer, sizeof(g_tx_buffer));
+      returned_action = NO_ACTION;
+    }
+    break;
         
     default :
       returned_action = NO_ACTION;
@@ -839,13 +1141,48 @@ OrionAction process_orion_sm_action (OrionAction action) {
 } //  process_orion_sm_action
 
 
+OrionAction qrss_holdoff_check() {
+  /*********************************************************************************************
+    Called from loop() during the hold-off that follows a QRSS transmission (QRSS_HOLDOFF_ST).
+    GPS data is still being processed, so rather than waiting out POST_QRSS_TX_DELAY_MS we go
+    straight back to calibration as soon as we have a valid position fix and see a 1PPS edge.
+  **********************************************************************************************/
+  bool pps_level;
+  bool pps_edge;
+
+  pps_level = digitalRead(GPS_PPS_PIN);
+  pps_edge = ((pps_level == HIGH) && (g_last_pps_level == LOW));
+  g_last_pps_level = pps_level;
+
+  if (pps_edge && fix.valid.status && fix.valid.location && (fix.status > GPS_STATUS_TIME_ONLY)) {
+    g_chrono_qrss_holdoff.stop();
+    return orion_state_machine(GPS_AOS_EV);
+  }
+
+  if (g_chrono_qrss_holdoff.hasPassed(POST_QRSS_TX_DELAY_MS)) {
+    g_chrono_qrss_holdoff.stop();
+    return orion_state_machine(QRSS_HOLDOFF_DONE_EV);
+  }
+
+  return NO_ACTION;
+}
+
+// The Telemetry message sent in each transmit cycle, indexed by the 10 minute cycle of the hour. The state machine
+// maps these events to the altitude, voltage and temperature telemetry actions.
+const uint8_t telemetry_tx_events[6] PROGMEM = {WSPR_TX_TIME_MIN02_EV, WSPR_TX_TIME_MIN12_EV, WSPR_TX_TIME_MIN22_EV,
+                                                WSPR_TX_TIME_MIN32_EV, WSPR_TX_TIME_MIN42_EV, WSPR_TX_TIME_MIN52_EV
+                                               };
+
+// The event for the Telemetry message picked by the telemetry planner, indexed by OrionWsprMsgType - ALTITUDE_TELEM_MSG
+const uint8_t telemetry_plan_events[3] PROGMEM = {WSPR_TX_TIME_MIN02_EV, WSPR_TX_TIME_MIN32_EV, WSPR_TX_TIME_MIN12_EV};
+
 OrionAction orion_scheduler() {
   /*********************************************************************
     This is the scheduler code that determines the Orion Beacon schedule
   **********************************************************************/
   byte Second; // The current second
   byte Minute; // The current minute
-  byte i;
+  uint32_t fix_age_ms; // Age of the GPS fix used to set the clock
 
   OrionAction returned_action = NO_ACTION;
 
@@ -869,57 +1206,49 @@ OrionAction orion_scheduler() {
 
     if (Second == 1) { // To simplify things we trigger everything at the one second mark if we are on the correct minute
 
-      switch (Minute) {
-
-        // Primary WSPR Transmission Triggers every 10th minute of the hour on the first second
-        case 0  :
-        case 10 :
-        case 20 :
-        case 30 :
-        case 40 :
-        case 50 :
-          // Primary WSPR transmission should start on the 1st second of the minute, but there's a slight delay
-          // in this code because it is limited to 1 second resolution.
-          return (orion_state_machine(PRIMARY_WSPR_TX_TIME_EV)); // This is a bit time critical so we try to minimize any extra processing
-
-        // These are also time critical as they trigger Telemetry messages so we try to minimize any extra processing by returning directly
-        // Telemetry is sent in the next even minute slot after the Primary message
-        case 2  : return (orion_state_machine(WSPR_TX_TIME_MIN02_EV));
-        case 12 : return (orion_state_machine(WSPR_TX_TIME_MIN12_EV));
-        case 22 : return (orion_state_machine(WSPR_TX_TIME_MIN22_EV));
-        case 32 : return (orion_state_machine(WSPR_TX_TIME_MIN32_EV));
-        case 42 : return (orion_state_machine(WSPR_TX_TIME_MIN42_EV));
-        case 52 : return (orion_state_machine(WSPR_TX_TIME_MIN52_EV));
-
-        case 9  :
-        case 19 :
-        case 29 :
-        case 39 :
-        case 49 :
-        case 59 :
-          // If we are one minute prior to a scheduled Beacon Transmission, trigger collection of new telemetry info, but first reset the system time from the GPS.
-          // We set the time here to try to minimize the delta between getting the time fix and setting the Orion system clock. This also lets us
-          // synchronize the regular setting of the clock with the beacon TX schedule so there is no overlap (resulting in lost events) and we have accurate
-          // clock time for each TX cycle.
-          if (g_gps_time_ok == true) {  // fix.valid.time is true and we are not in GPS LOS so we can trust the time fix. 
-            setTime(fix.dateTime.hours, fix.dateTime.minutes, fix.dateTime.seconds, fix.dateTime.date, fix.dateTime.month, fix.dateTime.year);
-            log_time_set(); // Log it.
-
-            // This is a minor kludge to prevent what seems to be a mini-time-warp, due to
-            // the re-setting of the time. This sometimes results in the generation of multiple TELEMETRY_TIME_EVs.
-            // The theory is that we keep reliving second 1 (Groundhog day scenario) so to fix this we simply
-            // delay for a couple of seconds after setting the time before we continue any further processing. 
-            delay(2000); 
+      // Primary WSPR Transmission Triggers every 10th minute of the hour on the first second
+      if ((Minute % 10) == 0) {
+        // Primary WSPR transmission should start on the 1st second of the minute, but there's a slight delay
+        // in this code because it is limited to 1 second resolution.
+        return (orion_state_machine(PRIMARY_WSPR_TX_TIME_EV)); // This is a bit time critical so we try to minimize any extra processing
+      }
 
-          }
-          returned_action =  (orion_state_machine(TELEMETRY_TIME_EV));
-          break;
+      // These are also time critical as they trigger Telemetry messages so we try to minimize any extra processing by returning directly
+      // Telemetry is sent in the next even minute slot after the Primary message. The telemetry type follows the 10 minute
+      // cycle of the hour, see telemetry_tx_events[], unless the telemetry planner picked it when the telemetry was collected.
+      if ((Minute % 10) == 2) {
+        if (g_params.telemetry_planner == ON)
+          return (orion_state_machine((OrionEvent)pgm_read_byte(&telemetry_plan_events[g_planned_telemetry - ALTITUDE_TELEM_MSG])));
+        return (orion_state_machine((OrionEvent)pgm_read_byte(&telemetry_tx_events[Minute / 10])));
+      }
 
-        default :
-          break;
+      if ((Minute % 10) == 9) {
+        // If we are one minute prior to a scheduled Beacon Transmission, trigger collection of new telemetry info, but first reset the system time from the GPS.
+        // We set the time here to try to minimize the delta between getting the time fix and setting the Orion system clock. This also lets us
+        // synchronize the regular setting of the clock with the beacon TX schedule so there is no overlap (resulting in lost events) and we have accurate
+        // clock time for each TX cycle.
+        // The fix must also be recent : while the NMEA sentences fail their checksums the last good fix gets older, and
+        // setting the clock from it would take the clock back and lose the cycle. A recent fix may still be for the
+        // previous second, depending on where in the NMEA burst we are, so it is moved on by its age.
+        fix_age_ms = millis() - g_gps_fix_ms;
+        if ((g_gps_time_ok == true) && (fix_age_ms < GPS_FIX_MAX_AGE_MS)) {  // fix.valid.time is true and we are not in GPS LOS so we can trust the time fix. 
+          setTime(fix.dateTime.hours, fix.dateTime.minutes, fix.dateTime.seconds, fix.dateTime.date, fix.dateTime.month, fix.dateTime.year);
+          adjustTime((fix_age_ms + 500) / 1000);
+          log_time_set(); // Log it.
+
+          // This is a minor kludge to prevent what seems to be a mini-time-warp, due to
+          // the re-setting of the time. This sometimes results in the generation of multiple TELEMETRY_TIME_EVs.
+          // The theory is that we keep reliving second 1 (Groundhog day scenario) so to fix this we simply
+          // delay for a couple of seconds after setting the time before we continue any further processing. 
+          delay(2000); 
 
+        }
 
-      } // end switch (Minute)
+        // Only start the transmit cycle if its slot is enabled in the slot table. The cycle starting at hh:n0 is
+        // enabled by bit n of g_params.tx_cycle_mask.
+        if (bitRead(g_params.tx_cycle_mask, ((Minute + 1) % 60) / 10))
+          returned_action =  (orion_state_machine(TELEMETRY_TIME_EV));
+      }
 
 
     } // end if (Second == 1)
@@ -929,44 +1258,86 @@ OrionAction orion_scheduler() {
   return returned_action;
 } // end orion_scheduler()
 
-void wspr_tx_interrupt_setup() {
-
-  // Set up Timer1 for interrupts every symbol period (i.e 1.46 Hz)
-  // The formula to calculate this is CPU_CLOCK_SPEED_HZ / (PRESCALE_VALUE) x (WSPR_CTC + 1)
-  // In this case we are using a prescale of 1024.
-  noInterrupts();          // Turn off interrupts.
-  TCCR1A = 0;              // Set entire TCCR1A register to 0; disconnects
-  //   interrupt output pins, sets normal waveform
-  //   mode.  We're just using Timer1 as a counter.
-  TCNT1  = 0;              // Initialize counter value to 0.
-  TCCR1B = (1 << CS12) |   // Set CS12 and CS10 bit to set prescale
-           (1 << CS10) |   //   to /1024
-           (1 << WGM12);   //   turn on CTC
-  //   which gives, 64 us ticks
-  TIMSK1 = (1 << OCIE1A);  // Enable timer compare interrupt.
-
-  // Note the the OCR1A value is processor clock speed dependant.
-  // WSPR_CTC must be defined as 5336 for an 8Mhz processor clock or 10672 for a 16 Mhz Clock
-  OCR1A = WSPR_CTC;       // Set up interrupt trigger count.
-
-  interrupts();            // Re-enable interrupts.
+// Save the reset checkpoint. It is saved after every action, which covers each state transition, and otherwise once
+// a second (see update_checkpoint()) so that the time restored after a reset is close.
+void save_checkpoint() {
+  struct OrionCheckpoint cp;
+
+  // Nothing worth resuming until the GPS has set the time
+  if (timeStatus() == timeNotSet) return;
+
+  memset(&cp, 0, sizeof(cp));
+  g_checkpoint_time = now();
+  cp.state = orion_sm_get_state();
+  cp.time_s = g_checkpoint_time;
+  cp.correction = si5351bx_get_correction();
+  cp.qrm_avoidance = is_qrm_avoidance_on();
+  if (g_chrono_GPS_LOS.isRunning() == false)
+    cp.gps_los = CHECKPOINT_LOS_NONE;
+  else if (g_chrono_GPS_LOS.hasPassed(GPS_LOS_GUARD_TMO_MS, false))
+    cp.gps_los = CHECKPOINT_LOS_EXPIRED;
+  else
+    cp.gps_los = CHECKPOINT_LOS_RUNNING;
+  cp.resumes = g_checkpoint_resumes;
+  cp.tx_data = g_tx_data;
+  cp.last_valid_telemetry = g_last_valid_telemetry;
+  checkpoint_save(&cp);
+}
+
+void update_checkpoint() {
+  if (now() != g_checkpoint_time) save_checkpoint();
+}
+
+// After a reset that wasn't a power on, carry on from the reset checkpoint rather than waiting for the operating
+// voltage and doing a startup calibration. Returns false if there is no valid checkpoint or it can't be used.
+bool resume_from_checkpoint() {
+  struct OrionCheckpoint cp;
+  OrionAction action;
+
+  if (checkpoint_load(&cp) == false) return false;
+
+  // Don't get stuck in a reset loop, and after a brown-out make sure the voltage has come back
+  if ((cp.resumes >= CHECKPOINT_MAX_RESUMES) || (read_voltage_v_x10() < OPERATING_VOLTAGE_Vx10)) return false;
+
+  if (orion_sm_resume((OrionState)cp.state, &action) == false) return false;
+
+  // We can't know how long we were down so the time is advanced by an estimate. The GPS sets it again before the
+  // next transmission, when the telemetry is collected.
+  setTime(cp.time_s + CHECKPOINT_RESUME_DELAY_S);
+  g_tx_data = cp.tx_data;
+  g_last_valid_telemetry = cp.last_valid_telemetry;
+  g_checkpoint_resumes = cp.resumes + 1;
+
+  setup_si5351_and_gps();
+  set_calibration_correction(cp.correction);
+  if (SI5351_SELF_CALIBRATION_SUPPORTED == true)
+    setup_pps_interrupt(); // Normally done by the startup calibration
+
+  if (cp.qrm_avoidance == ON)
+    enable_qrm_avoidance();
+  else
+    disable_qrm_avoidance();
+
+  // The LOS timer starts over, already expired if the QRSS beacon had been triggered
+  if (cp.gps_los == CHECKPOINT_LOS_RUNNING)
+    g_chrono_GPS_LOS.restart();
+  else if (cp.gps_los == CHECKPOINT_LOS_EXPIRED)
+    g_chrono_GPS_LOS.restart(GPS_LOS_GUARD_TMO_MS + 1);
+
+  log_checkpoint_resume(hal_reset_flags(), cp.state, cp.correction);
+  save_checkpoint();
+
+  g_current_action = action;
+  return true;
 }
 
 void setup() {
-  
+  bool params_load_result;
+
   // Disable the hardware Watch Dog, just in case it was accidentally enabled during a brown-out 
-  noInterrupts();   
-    // Clear WDRF in MCUSR
-     MCUSR &= ~(1<<WDRF);
-     
-   // Write logical one to WDCE and WDE
-   // Keep old prescaler setting to prevent unintentional
-   // time-out
-    WDTCSR |= (1<<WDCE) | (1<<WDE);
-    
-  // Turn off WDT
-   WDTCSR = 0x00;
- interrupts();
+  hal_wdt_disable();
+
+  HAL_PROBE_SETUP(); // Timing probe pins, if ORION_TIMING_PROBES is defined in OrionBoardConfig.h
 
   // Note that we don't intialize communications with the GPS or Si5351a until we are sure that we have reached OPERATING_VOLTAGE
 
@@ -997,20 +1368,26 @@ void setup() {
   digitalWrite(TX_POWER_DISABLE_PIN, HIGH); // Powered down
 #endif
 
+  perf_eeprom_log_begin(); // Count this boot in the EEPROM Log
+  perf_reset(); // Start with all of the performance counters cleared
+  params_load_result = params_begin(); // Load the runtime parameters from EEPROM (or the defaults)
+
   g_chrono_GPS_LOS.stop(); // Note that the constructor for Chrono starts the timer automatically so we need to stop it until we actually need it. 
+  g_chrono_qrss_holdoff.stop();
   
   // Setup the software serial port for the serial monitor interface
   serial_monitor_begin();
-
-  // Read unused analog pin (not connected) to generate a random seed for QRM avoidance feature
-  randomSeed(analogRead(ANALOG_PIN_FOR_RNG_SEED));
+  log_params_loaded(params_load_result);
 
   // Set the intial state for the Orion Beacon State Machine
   orion_sm_begin();
 
- // Tell the state machine that we need to wait for the operating voltage to be reached
- // If VCC_SAMPLING_SUPPORTED == false then we won't bother to try to measure VCC 
- g_current_action = orion_state_machine(WAIT_VOLTAGE_EV);
+  // After a watchdog, brown-out or external reset pick up where we left off if we can
+  if (resume_from_checkpoint() == false) {
+    // Tell the state machine that we need to wait for the operating voltage to be reached
+    // If VCC_SAMPLING_SUPPORTED == false then we won't bother to try to measure VCC
+    g_current_action = orion_state_machine(WAIT_VOLTAGE_EV);
+  }
 
 
 } // end setup()
@@ -1023,9 +1400,21 @@ void loop() {
   // We need to ensure that the GPS is up and running and we have valid time before we proceed
   // This should only get invoked on system cold start. It ensures that the scheduler and logging will properly function
 
+  OrionAction next_action;
+  uint32_t action_start_ms;
+  uint32_t sleep_start_us;
+  bool idle = false;
+
+  perf_loop_tick();
+
   // This triggers actual work when the state machine returns an OrionAction
   while (g_current_action != NO_ACTION) {
-    g_current_action = process_orion_sm_action(g_current_action);
+    action_start_ms = millis();
+    next_action = process_orion_sm_action(g_current_action);
+    perf_log_action_duration(g_current_action, millis() - action_start_ms);
+    perf_update_memory_hwm(); // Actions have the deepest call chains so check the stack high-water mark after each one
+    g_current_action = next_action;
+    save_checkpoint();
   }
 
   // Process serial monitor input
@@ -1034,9 +1423,40 @@ void loop() {
   // Get the current GPS fix and update the system clock time if needed.
   // Because the GPS could be powered off on the K1FM boards we need to check for this
   // otherwise this might cause a problem with the serial communications
-  if (g_gps_power_state == ON) get_gps_fix_and_time();
+  if (g_gps_power_state == ON) {
+    get_gps_fix_and_time();
 
-  // Call the scheduler to determine if it is time for any action
-  g_current_action = orion_scheduler();
+#if defined (NMEAGPS_STATS)
+    // Move the NeoGPS statistics into the performance counters so that they can be reset from the serial monitor
+    perf_add_gps_stats(gps.statistics.chars, gps.statistics.ok, gps.statistics.errors);
+    gps.statistics.init();
+#endif
+  }
+
+  if (qrss_is_active()) {
+    // While QRSS is transmitting the keyer runs from the Timer1 interrupt. We just apply key changes
+    // and otherwise idle the processor until the next interrupt. Timer0 (millis) and the USART keep running.
+    if (qrss_service() == true)
+      g_current_action = orion_state_machine(QRSS_TX_DONE_EV);
+    else
+      idle = true;
+  }
+  else if (g_chrono_qrss_holdoff.isRunning()) {
+    // Post QRSS hold-off, keep processing GPS data so that we notice GPS AOS (the Timer0 interrupt wakes us every ms)
+    g_current_action = qrss_holdoff_check();
+    idle = (g_current_action == NO_ACTION);
+  }
+  else {
+    // Call the scheduler to determine if it is time for any action
+    g_current_action = orion_scheduler();
+  }
+
+  update_checkpoint();
+
+  if (idle) {
+    sleep_start_us = micros();
+    hal_sleep_idle();
+    perf_add_sleep_us(micros() - sleep_start_us);
+  }
 
 } // end loop ()
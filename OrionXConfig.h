@@ -25,7 +25,7 @@
 // THIS FILE CONTAINS THE USER MODIFIABLE #DEFINES TO CONFIGURE THE ORION WSPR BEACON
 // See Orion Manual for configuration details. 
 
-#define ORION_FW_VERSION "v1.0"  // Whole numbers are for released versions. (i.e. 1.0, 2.0 etc.)
+#define ORION_FW_VERSION "v1.25" // Whole numbers are for released versions. (i.e. 1.0, 2.0 etc.)
 // Numbers to the right of the decimal are allocated consecutively, one per GITHUB submission.(i.e. 0.01, 0.02 etc)
 // a = alpha b=beta, r=release
 
@@ -39,25 +39,61 @@
 #define INFO_LOG_INITIAL OFF             // This determines the intial setting for g_info_log_on_off in the serial monitor.
                                         // THIS SHOULD BE SET TO OFF FOR FLIGHT
 
+//#define ORION_BENCHMARK_SUPPORTED     // Uncomment to build in the "bench" serial monitor command (see OrionBenchmark.cpp)
+                                        // THIS SHOULD BE COMMENTED OUT FOR FLIGHT
+
 /***********************************************************
    USER SPECIFIED PARAMETERS FOR WSPR
  ***********************************************************/
-#define BEACON_FREQ_HZ            14097010UL    //  Base Frequency In Hz for use when QRM Avoidance is enabled. Actual Tx frequency is BEACON_FREQ_HZ + a random offset.
+#define BEACON_FREQ_HZ            14097010UL    //  Base Frequency In Hz for use when QRM Avoidance is enabled. Actual Tx frequency is BEACON_FREQ_HZ + a hop offset.
 #define FIXED_BEACON_FREQ_HZ      14097070UL    //  Beacon Frequency In Hz for use when QRM Avoidance is disabled.
+#define QRM_HOP_SPAN_HZ             180         //  QRM Avoidance hops between BEACON_FREQ_HZ and BEACON_FREQ_HZ + QRM_HOP_SPAN_HZ, see get_tx_frequency()
+#define QRM_HOP_CHANNEL_HZ          6           //  Hop channel spacing, just over the 5.9 Hz bandwidth of a WSPR-2 signal
+#define QRM_HOP_CAL_UNCERTAINTY_PPB 100         //  Frequency uncertainty after self-calibration, kept clear of both ends of the hop span
+#define BEACON2_FREQ_HZ           7040070UL     //  Second band frequency In Hz on dual band boards (SI5351A_WSPRTX2_CLK_NUM). It moves with QRM Avoidance and carries the same frame as the first band.
 #define PARK_FREQ_HZ              108000000ULL  // Use this on clk SI5351A_PARK_CLK_NUM to keep the SI5351a warm to avoid thermal drift during WSPR transmissions. Max 109 Mhz.
 
 // Configuration parameters for Primary WSPR Message (i.e. Callsign, 4 character grid square and power out in dBm)
-#define BEACON_CALLSIGN_6CHAR   "VE3WMB"      // Your beacon Callsign, maximum of 6 characters
+#define BEACON_CALLSIGN_6CHAR   "VE3WMB"      // Your beacon Callsign, maximum of 6 characters plus an optional prefix (up to 3) or suffix (1 or 2) after a '/'
 #define BEACON_GRID_SQ_4CHAR    "AA01"        // Your hardcoded 4 character Grid Square - this will be overwritten with GPS derived Grid
 #define BEACON_TX_PWR_DBM          7          // Beacon Power Output in dBm (5mW = 7dBm)       
 
+#define WSPR_TYPE3_INITIAL   ON               // Initial value of the type3 parameter. ON alternates the Primary Message between Type 1
+                                                // and a Type 3 message with the full 6 character grid square and BEACON_TX_PWR_DBM.
+
+#define TELEMETRY_PLANNER_INITIAL OFF          // Initial value of the telplan parameter. ON lets the telemetry planner pick the Telemetry
+                                                // message of each cycle and announce it in the Primary message, see OrionTelemetry.cpp.
+#define TELEM_PLAN_MAX_AGE         6            // The planner sends every telemetry channel at least once every 6 Telemetry messages
+#define TELEM_PLAN_CHANGE_WEIGHT   2            // Planner score of each power field level a channel has moved since it was last sent
+
+#define OSC_MODEL_INITIAL OFF                  // Initial value of the oscmodel parameter. ON transmits with the correction factor predicted by
+                                                // the Kalman filter model of the Si5351a crystal, see OrionOscModel.cpp.
+#define OSC_MODEL_REF_TEMP_C         25         // Reference temperature of the modelled correction factor
+#define OSC_MODEL_CORR_SIGMA_PPB     2000       // Initial uncertainty of the correction factor (corr parameter), in ppb
+#define OSC_MODEL_RATE_SIGMA_PPB_H   50         // Initial uncertainty of the drift rate, in ppb per hour
+#define OSC_MODEL_TEMPCO_SIGMA_PPB_C 300        // Initial uncertainty of the temperature coefficient, in ppb per degree C
+#define OSC_MODEL_CORR_WALK_PPB2_H   100        // Random walk of the correction factor, variance added per hour (ppb^2)
+#define OSC_MODEL_RATE_WALK          4          // Random walk of the drift rate, variance added per hour ((ppb/hour)^2)
+#define OSC_MODEL_TEMPCO_WALK        1          // Random walk of the temperature coefficient, variance added per hour ((ppb/C)^2)
+#define OSC_MODEL_MAX_STEP_MIN       10080      // Longest time step of the model (one week), for a clock that jumps forward
+#define OSC_MODEL_SKIP_CAL_PPB       20         // Skip a calibration when the model predicts the correction to within this (1 sigma)
+#define OSC_MODEL_MAX_SKIPPED_CALS   5          // But never skip more than this many calibrations in a row
+
+#define TX_MONITOR_INITIAL OFF                 // Initial value of the txmon parameter. ON keeps counting the calibration clock during
+                                                // transmissions and corrects the frequency every 10 seconds, see tx_monitor_start().
+
 #define OPERATING_VOLTAGE_Vx10       30        // This is the sampled VCC value x 10  required to initiate beacon operation (i.e 33 means 3.3v) 
 #define SHUTDOWN_VOLTAGE_Vx10        20        // Sampled VCC value x 10. Readings below this value will initiate the transition to SHUTDOWN_ST
 
 #define OPERATING_VOLTAGE_GUARD_TMO_MS 3600000      // Guard Timeout value for  1 hour (60,000 ms / minute x 60 
 #define CALIBRATION_GUARD_TMO_MS  90000             // Guard Timeout value for 1.5 minutes (60,000 ms / minute x 1.5) 
+#define CALIBRATION_MAX_GATE_ERROR_PPM  200         // A calibration gate further off than this is a PPS glitch and is ignored
 #define INITIAL_CALIBRATION_GUARD_TMO_MS  1200000   // Guard Timeout value for 20 minutes (60,000 ms / minute x 20)
 #define GPS_LOS_GUARD_TMO_MS              1800000   // Guard Timeout value for 30 minutes (60,000 ms / minute x 30)
+#define GPS_FIX_MAX_AGE_MS                2000      // An older GPS fix isn't used to reset the clock before a TX cycle
+
+#define CHECKPOINT_RESUME_DELAY_S  2        // Estimate of the time lost to a reset and the bootloader, added to the restored time
+#define CHECKPOINT_MAX_RESUMES     3        // Resets in a row without a transmission that may resume from the checkpoint
 
 // Type Definitions
 
@@ -86,9 +122,11 @@ struct OrionTxData {
 
 
 enum OrionCalibrationResult {PASS, FAIL_PPS, FAIL_SAMPLE};
-enum OrionWsprMsgType {PRIMARY_WSPR_MSG, ALTITUDE_TELEM_MSG, TEMPERATURE_TELEM_MSG, VOLTAGE_TELEM_MSG};
+enum OrionWsprMsgType {PRIMARY_WSPR_MSG, ALTITUDE_TELEM_MSG, TEMPERATURE_TELEM_MSG, VOLTAGE_TELEM_MSG, PRIMARY_TYPE3_WSPR_MSG};
 
-enum QrssMode {MODE_NONE, MODE_QRSS, MODE_FSKCW, MODE_DFCW};
+enum QrssMode {MODE_NONE, MODE_QRSS, MODE_FSKCW, MODE_DFCW, MODE_FSKHELL, MODE_MFSK4,
+               NUM_QRSS_MODES // This must always be last
+              };
 enum QrssSpeed {s12wpm, QRSS3, QRSS6, QRSS10};
 
 #endif
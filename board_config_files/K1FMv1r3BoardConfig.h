@@ -26,7 +26,6 @@
 // THIS FILE CONTAINS THE USER MODIFIABLE #DEFINES TO CONFIGURE A SPECIFIC BOARD TO USE THE ORION WSPR BEACON CODE
 
 #define BOARDNAME " - K1FM v1.3"        // This string is output along with code version using the 'v' command in the monitor
-/*
 // Note: When using a previously unprogrammed ATMega chip it is important to "burn bootloader" first so that the fuses are set correctly
 // Use Arduino Pro Mini 3.3v / 8 Mhz as Board / Processor Type for 3.3 v operation. 
 
@@ -62,7 +61,7 @@ atmega328p pin #
 	 23        PCO (ADC0/PCINT8)                    Arduino A0 [Vdd+ input to ADC for voltage measument]        
 	 24        PC1 (ADC1/PCINT9)					Arduino A1 [TMP-36 Pin1 - Analog temperature sensor] 	   
 	 
-	 25        PC2 (ADC2/PCINT10)					Arduino A2  [Unused analog port for random number seed]
+	 25        PC2 (ADC2/PCINT10)					Arduino A2  [Unused]
 	 26        PC3 (ADC3/PCINT11)                   Arduino A3         
 	 27        PC4 (ADC4/SDA/PCINT11)				Arduin0 A4	[SDA - H/W I2C communication with Si5351]
 	 28        PC5 (ADC5/SCL/PCINT13)               Arduino A5  [SCL - H/W I2C communication with Si5351] 
@@ -76,7 +75,7 @@ atmega328p pin #
 */
 
 /*******************************************************
-/* Serial Port Configuration for GPS and debug serial  *
+ * Serial Port Configuration for GPS and debug serial  *
 *******************************************************/
  // GPS Communicates with processor via Hardware serial 
 //#define GPS_USES_HW_SERIAL              // Comment out if ATMEGA328p communicates with GPS via Software Serial
@@ -97,7 +96,7 @@ atmega328p pin #
 
 
 /*******************************************
-/* Si5351a I2C communication configuration *
+ * Si5351a I2C communication configuration *
 *******************************************/
 // Processor talks to Si5351a using software I2C
 //#define SI5351A_USES_SOFTWARE_I2C       // Comment out if  ATMEGA328p communicates with the Si5351a via Hardware I2C
@@ -111,7 +110,7 @@ atmega328p pin #
 #define SDA_PORT PORTD
 
 /*********************************************
-/* Si5351a CALIBRATION feature configuration *
+ * Si5351a CALIBRATION feature configuration *
 *********************************************/
 #define SI5351_SELF_CALIBRATION_SUPPORTED  true // set to false if No self-calibration. It requires an unused Si5351 CLK output fed back to D5 
 
@@ -127,7 +126,7 @@ atmega328p pin #
                                     // Otherwise Calibration is not supported for your board.
 
 /************************************
-/* Temperature sensor configuration *
+ * Temperature sensor configuration *
 ************************************/
 // External Temperature Sensor. If one of the following two are DEFINED this sensor data will be used for temperature telemetry
 // otherwise we default to using the internal temperature sensor in the Atmega328p. Only uncomment one at most. 
@@ -144,7 +143,7 @@ atmega328p pin #
 #endif
 
 /*****************************************
-/* Voltage (Vcc) sampling  configuration *
+ * Voltage (Vcc) sampling  configuration *
 *****************************************/
 #define VCC_SAMPLING_SUPPORTED True  	// Board does not have the capabilty to sample VCC on Vpwerbus using VpwerDivider as a multiplying factor
 #define Vpwerbus     A0          		// ADC input for Vpwrbus for measuring battery voltage - unused on Stella9.1
@@ -163,6 +162,18 @@ atmega328p pin #
                                                // I recommend terminating this port to ground via a 47 to 56 ohm resistor.
 #define SI5351A_CAL_CLK_NUM     2              // Calibration Clock Number                                
 #define SI5351A_WSPRTX_CLK_NUM  0              // The Si5351a Clock Number output used for the WSPR Beacon Transmission
+//#define SI5351A_WSPRTX2_CLK_NUM 2             // Dual band boards only, the Si5351a Clock Number output used for the second band (freq2 parameter).
+                                               // It can't share a clock with the outputs above, so for TX on CLK0 and CLK2 set both the PARK and
+                                               // CAL clocks to 1, with CLK1 fed back to D5 for self-calibration. Both bands send the same WSPR frame,
+                                               // a different message on the second band would need a second symbol buffer and isn't supported.
+                                               // With the PARK and CAL clocks shared there is no PARK clock and the txmon parameter is ignored.
+//#define SI5351A_PUSH_PULL_CLK_NUM 2           // Push-pull boards only, the Si5351a Clock Number output driven in antiphase with SI5351A_WSPRTX_CLK_NUM
+                                               // into a balanced load (e.g. a transformer), for about four times the output power. The same clock
+                                               // rules as SI5351A_WSPRTX2_CLK_NUM apply and only one of the two can be defined.
+//#define SI5351_CAL_ON_TX_PATH                // Self-calibrate the TX path itself. The CAL clock output is driven from the multisynth of
+                                               // SI5351A_WSPRTX_CLK_NUM (which must then be CLK0) at fixfreq, divided down by its R divider
+                                               // to below SI5351_CAL_TARGET_FREQ (e.g. 14.097 Mhz / 8). Boards without a spare clock output can
+                                               // set SI5351A_CAL_CLK_NUM to SI5351A_WSPRTX_CLK_NUM, with the divided TX output fed back to D5.
 
 #define SI5351BX_XTALPF   3                   // Crystal Load Capacitance 1:6pf  2:8pf  3:10pf -  assuming 10 pF, otherwise change
 
@@ -176,14 +187,7 @@ atmega328p pin #
 /***************************************************************************
 *   Parameters dependant on Processor CPU Speed - Assumption is 8Mhz Clock *
 ***************************************************************************/
-// The following value WSPR_CTC is used for Timer1 that generates a 1.46 Hz interrupt.
-
-// THE CURRENT VALUE for WSPR_CTC ASSUMES AN 8 MHZ PROCESSOR CLOCK !
-
-// If you are using most Arduinos (i.e Nano, UNO etc) they use a 16 Mhz clock and the value 10672 must be substituted.
-// ie. #define WSPR_CTC                10672       // CTC value for WSPR on Arduino using 16 Mhz clock (i.e. Nano, Uno etc)
-// The formula to calculate WSPR_CTC is: 1.4648 = CPU_CLOCK_SPEED_HZ / (PRESCALE_VALUE) x (WSPR_CTC + 1)
-#define WSPR_CTC                5336               // CTC value for WSPR on Arduino using an 8 Mhz clock (i.e. Arduino Pro Mini 3.3v 8 Mhz)
+// The WSPR symbol timing is worked out from F_CPU (see start_symbol_clock() in OrionWspr.ino) so it needs no setting here.
 
 #define SI5351_CAL_TARGET_FREQ  320000000ULL; //This is calculated as CPU_CLOCK_SPEED_HZ / 2.5 expressed in hundredths of Hz. Assumes 8 Mhz clk.
                                                
@@ -207,6 +211,23 @@ atmega328p pin #
   #define TX_POWER_DISABLE_PIN    6     // Pin D6
 #endif
 
+/*******************************************************
+*  Timing probe pins (for simulation and scope testing) *
+*******************************************************/
+// When ORION_TIMING_PROBES is defined the firmware drives three otherwise unused PORTB pins so that the timing
+// critical paths can be measured with a scope or a logic analyzer. The host board simulator (tools/host/sim_board.cpp)
+// traces them whether it is defined or not.
+// Leave it commented out for flight, the probe pins are left as inputs.
+//#define ORION_TIMING_PROBES
+
+#if defined (ORION_TIMING_PROBES)
+#define PROBE_PORT              PORTB
+#define PROBE_DDR               DDRB
+#define PROBE_BIT_SYMBOL        0             // PB0 (D8)  toggles at each WSPR symbol / QRSS element interrupt
+#define PROBE_BIT_CAL           2             // PB2 (D10) high while a calibration counting gate is open
+#define PROBE_BIT_I2C           5             // PB5 (D13) high during each I2C write to the Si5351a
+#endif
+
 /********************************
 *  Miscellaneous Pin Defintions *
 *********************************/
@@ -220,6 +241,5 @@ atmega328p pin #
 //#define SYNC_LED_PIN            7             // LED on PIN D7 indicates GPS time synchronization. 
 // Note the most Arduino Boards have a built-in LED that can be used for either of the above purposes referred to as LED_BUILTIN
 
-#define ANALOG_PIN_FOR_RNG_SEED  A2              // Pin used to generate seed for Random number generator - must be a free analog pin (i.e. unterminated) 
                                  
 #endif
@@ -26,7 +26,6 @@
 // THIS FILE CONTAINS THE USER MODIFIABLE #DEFINES TO CONFIGURE A SPECIFIC BOARD TO USE THE ORION WSPR BEACON CODE
 
 #define BOARDNAME " - STELLA 16"        // This string is output along with code version using the 'v' command in the monitor
-/*
 // Note: When using a previously unprogrammed ATMega chip it is important to "burn bootloader" first so that the fuses are set correctly
 // Use Arduino Pro Mini 3.3v / 8 Mhz as Board / Processor Type for 3.3 v operation. 
 
@@ -60,7 +59,7 @@ atmega328 pin #
 	 21        GND
 	 22        ADC7
 	 23        PCO (ADC0/PCINT8)                    Arduino  A0 [OneWire Bus for DS1820 temp sensor]          
-	 24        PC1 (ADC1/PCINT9)					          Arduino A1  [Unused analog port for random number seed]	   
+	 24        PC1 (ADC1/PCINT9)					          Arduino A1  [Unused]	   
 	 
 	 25        PC2 (ADC2/PCINT10)
 	 26        PC3 (ADC3/PCINT11)                   Arduino A3  [V+ input to ADC for voltage measument]        
@@ -83,7 +82,7 @@ Arduino 10bit ADC; each count of 1 = 0.004654V
 */
 
 /*******************************************************
-/* Serial Port Configuration for GPS and debug serial  *
+ * Serial Port Configuration for GPS and debug serial  *
 *******************************************************/
  // GPS Communicates with processor via Hardware serial 
 #define GPS_USES_HW_SERIAL              // Comment out if ATMEGA328p communicates with GPS via Software Serial
@@ -104,7 +103,7 @@ Arduino 10bit ADC; each count of 1 = 0.004654V
 
 
 /*******************************************
-/* Si5351a I2C communication configuration *
+ * Si5351a I2C communication configuration *
 *******************************************/
 // Processor talks to Si5351a using software I2C
 #define SI5351A_USES_SOFTWARE_I2C       // Comment out if  ATMEGA328p communicates with the Si5351a via Hardware I2C
@@ -118,7 +117,7 @@ Arduino 10bit ADC; each count of 1 = 0.004654V
 #define SDA_PORT PORTD
 
 /*********************************************
-/* Si5351a CALIBRATION feature configuration *
+ * Si5351a CALIBRATION feature configuration *
 *********************************************/
 #define SI5351_SELF_CALIBRATION_SUPPORTED  true // set to false if No self-calibration. It requires an unused Si5351 CLK output fed back to D5 
 
@@ -134,7 +133,7 @@ Arduino 10bit ADC; each count of 1 = 0.004654V
                                     // Otherwise Calibration is not supported for your board.
 
 /************************************
-/* Temperature sensor configuration *
+ * Temperature sensor configuration *
 ************************************/
 // External Temperature Sensor. If one of the following two are DEFINED this sensor data will be used for temperature telemetry
 // otherwise we default to using the internal temperature sensor in the Atmega328p. Only uncomment one at most. 
@@ -151,7 +150,7 @@ Arduino 10bit ADC; each count of 1 = 0.004654V
 #endif
 
 /*****************************************
-/* Voltage (Vcc) sampling  configuration *
+ * Voltage (Vcc) sampling  configuration *
 *****************************************/
 #define VCC_SAMPLING_SUPPORTED false  	// Board does not have the capabilty to sample VCC on Vpwerbus using VpwerDivider as a multiplying factor
 #define Vpwerbus     A3          		// ADC input for Vpwrbus for measuring battery voltage - unused on Stella9.1
@@ -170,6 +169,18 @@ Arduino 10bit ADC; each count of 1 = 0.004654V
                                                // I recommend terminating this port to ground via a 47 to 56 ohm resistor.
 #define SI5351A_CAL_CLK_NUM     2              // Calibration Clock Number                                
 #define SI5351A_WSPRTX_CLK_NUM  0              // The Si5351a Clock Number output used for the WSPR Beacon Transmission
+//#define SI5351A_WSPRTX2_CLK_NUM 2             // Dual band boards only, the Si5351a Clock Number output used for the second band (freq2 parameter).
+                                               // It can't share a clock with the outputs above, so for TX on CLK0 and CLK2 set both the PARK and
+                                               // CAL clocks to 1, with CLK1 fed back to D5 for self-calibration. Both bands send the same WSPR frame,
+                                               // a different message on the second band would need a second symbol buffer and isn't supported.
+                                               // With the PARK and CAL clocks shared there is no PARK clock and the txmon parameter is ignored.
+//#define SI5351A_PUSH_PULL_CLK_NUM 2           // Push-pull boards only, the Si5351a Clock Number output driven in antiphase with SI5351A_WSPRTX_CLK_NUM
+                                               // into a balanced load (e.g. a transformer), for about four times the output power. The same clock
+                                               // rules as SI5351A_WSPRTX2_CLK_NUM apply and only one of the two can be defined.
+//#define SI5351_CAL_ON_TX_PATH                // Self-calibrate the TX path itself. The CAL clock output is driven from the multisynth of
+                                               // SI5351A_WSPRTX_CLK_NUM (which must then be CLK0) at fixfreq, divided down by its R divider
+                                               // to below SI5351_CAL_TARGET_FREQ (e.g. 14.097 Mhz / 8). Boards without a spare clock output can
+                                               // set SI5351A_CAL_CLK_NUM to SI5351A_WSPRTX_CLK_NUM, with the divided TX output fed back to D5.
 
 #define SI5351BX_XTALPF   3                   // Crystal Load Capacitance 1:6pf  2:8pf  3:10pf -  assuming 10 pF, otherwise change
 
@@ -183,14 +194,7 @@ Arduino 10bit ADC; each count of 1 = 0.004654V
 /***************************************************************************
 *   Parameters dependant on Processor CPU Speed - Assumption is 8Mhz Clock *
 ***************************************************************************/
-// The following value WSPR_CTC is used for Timer1 that generates a 1.46 Hz interrupt.
-
-// THE CURRENT VALUE for WSPR_CTC ASSUMES AN 8 MHZ PROCESSOR CLOCK !
-
-// If you are using most Arduinos (i.e Nano, UNO etc) they use a 16 Mhz clock and the value 10672 must be substituted.
-// ie. #define WSPR_CTC                10672       // CTC value for WSPR on Arduino using 16 Mhz clock (i.e. Nano, Uno etc)
-// The formula to calculate WSPR_CTC is: 1.4648 = CPU_CLOCK_SPEED_HZ / (PRESCALE_VALUE) x (WSPR_CTC + 1)
-#define WSPR_CTC                5336               // CTC value for WSPR on Arduino using an 8 Mhz clock (i.e. Arduino Pro Mini 3.3v 8 Mhz)
+// The WSPR symbol timing is worked out from F_CPU (see start_symbol_clock() in OrionWspr.ino) so it needs no setting here.
 
 #define SI5351_CAL_TARGET_FREQ  320000000ULL; //This is calculated as CPU_CLOCK_SPEED_HZ / 2.5 expressed in hundredths of Hz. Assumes 8 Mhz clk.
                                                
@@ -214,6 +218,23 @@ Arduino 10bit ADC; each count of 1 = 0.004654V
   #define TX_POWER_DISABLE_PIN    6     // Pin D6
 #endif
 
+/*******************************************************
+*  Timing probe pins (for simulation and scope testing) *
+*******************************************************/
+// When ORION_TIMING_PROBES is defined the firmware drives three otherwise unused PORTB pins so that the timing
+// critical paths can be measured with a scope or a logic analyzer. The host board simulator (tools/host/sim_board.cpp)
+// traces them whether it is defined or not.
+// Leave it commented out for flight, the probe pins are left as inputs.
+//#define ORION_TIMING_PROBES
+
+#if defined (ORION_TIMING_PROBES)
+#define PROBE_PORT              PORTB
+#define PROBE_DDR               DDRB
+#define PROBE_BIT_SYMBOL        0             // PB0 (D8)  toggles at each WSPR symbol / QRSS element interrupt
+#define PROBE_BIT_CAL           2             // PB2 (D10) high while a calibration counting gate is open
+#define PROBE_BIT_I2C           5             // PB5 (D13) high during each I2C write to the Si5351a
+#endif
+
 /********************************
 *  Miscellaneous Pin Defintions *
 *********************************/
@@ -227,6 +248,5 @@ Arduino 10bit ADC; each count of 1 = 0.004654V
 #define SYNC_LED_PIN            7             // LED on PIN D7 indicates GPS time synchronization. 
 // Note the most Arduino Boards have a built-in LED that can be used for either of the above purposes referred to as LED_BUILTIN
 
-#define ANALOG_PIN_FOR_RNG_SEED  A1              // Pin used to generate seed for Random number generator - must be a free analog pin (i.e. unterminated) 
                                  
 #endif
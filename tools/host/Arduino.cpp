@@ -0,0 +1,521 @@
+/*
+   Arduino.cpp - Arduino core and library shims for the host build of the Orion modules (see CMakeLists.txt)
+
+   The host clock only moves when a test calls host_advance_ms() (delay() does the same), so the tests are
+   deterministic and run as fast as the PC allows. The system time of TimeLib.h follows it, counting whole seconds of
+   millis() the way the Time library does.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include <Chrono.h>
+#include <TimeLib.h>
+#include <NeoSWSerial.h>
+
+volatile uint8_t TCCR1A, TCCR1B, TIMSK1, TIFR1, GTCCR, MCUSR, WDTCSR, EIMSK, PCICR, PCIFR, PCMSK1, ADMUX, ADCSRA;
+volatile uint8_t PORTB, PORTC, PORTD, DDRB, DDRC, DDRD, PINB, PINC, PIND;
+volatile uint8_t TCCR2A, TCCR2B, TIMSK2, TCNT2, OCR2A, TIFR2, GPIOR0, ASSR;
+volatile uint16_t TCNT1, OCR1A, OCR1B, ADCW, SP;
+
+HardwareSerial Serial;
+
+// ---- Time ----
+
+static unsigned long long host_us = 0;
+static bool host_advancing = false;
+
+void (*host_advance_hook)(unsigned long long until_us) = NULL;
+
+uint32_t millis() {
+  return (uint32_t)(host_us / 1000);
+}
+
+uint32_t micros() {
+  return (uint32_t)host_us;
+}
+
+unsigned long long host_time_us() {
+  return host_us;
+}
+
+void host_set_time_us(unsigned long long us) {
+  host_us = us;
+}
+
+void host_advance_us(unsigned long long us) {
+  // Not from within the hook itself, e.g. an interrupt handler calling delayMicroseconds()
+  if ((host_advance_hook != NULL) && !host_advancing) {
+    struct Advancing {              // Cleared however the hook returns, it may throw to end a simulation
+      Advancing() { host_advancing = true; }
+      ~Advancing() { host_advancing = false; }
+    } advancing;
+    host_advance_hook(host_us + us);
+  }
+  else
+    host_us += us;
+}
+
+void host_advance_ms(unsigned long ms) {
+  host_advance_us(1000ULL * ms);
+}
+
+void delay(unsigned long ms) {
+  host_advance_ms(ms);
+}
+
+void delayMicroseconds(unsigned int us) {
+  host_advance_us(us);
+}
+
+// ---- I/O ----
+
+uint8_t host_pin_levels[HOST_NUM_PINS];
+int host_analog_values[8];
+void (*host_ext_isr[2])(void);
+
+void pinMode(uint8_t, uint8_t) {
+}
+
+void digitalWrite(uint8_t, uint8_t) {
+}
+
+int digitalRead(uint8_t pin) {
+  return (pin < HOST_NUM_PINS) ? host_pin_levels[pin] : LOW;
+}
+
+int analogRead(uint8_t pin) {
+  if (pin >= A0) pin -= A0;
+  return (pin < 8) ? host_analog_values[pin] : 0;
+}
+
+void analogReference(uint8_t) {
+}
+
+void attachInterrupt(uint8_t irq, void (*isr)(void), int) {
+  if (irq < 2) host_ext_isr[irq] = isr;
+}
+
+void detachInterrupt(uint8_t irq) {
+  if (irq < 2) host_ext_isr[irq] = NULL;
+}
+
+long random(long howbig) {
+  return (howbig <= 0) ? 0 : rand() % howbig;
+}
+
+long random(long howsmall, long howbig) {
+  return (howsmall >= howbig) ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+  srand(seed);
+}
+
+// ---- Print ----
+
+size_t Print::write(const char *s) {
+  size_t n = 0;
+
+  while (*s) n += write((uint8_t)*s++);
+  return n;
+}
+
+size_t Print::print(const __FlashStringHelper *s) {
+  return write((const char *)s);
+}
+
+size_t Print::print(const char *s) {
+  return write(s);
+}
+
+size_t Print::print(char c) {
+  return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char n, int base) {
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(int n, int base) {
+  return print((long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base) {
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(long n, int base) {
+  char buf[34];
+
+  if (base == DEC) return write(ltoa(n, buf, 10));
+  return write(ultoa((unsigned long)n, buf, base));
+}
+
+size_t Print::print(unsigned long n, int base) {
+  char buf[34];
+
+  return write(ultoa(n, buf, base));
+}
+
+size_t Print::print(double n, int digits) {
+  char buf[40];
+
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return write(buf);
+}
+
+size_t Print::println() {
+  return write("\r\n");
+}
+
+size_t Print::println(const __FlashStringHelper *s) {
+  return print(s) + println();
+}
+
+size_t Print::println(const char *s) {
+  return print(s) + println();
+}
+
+size_t Print::println(char c) {
+  return print(c) + println();
+}
+
+size_t Print::println(unsigned char n, int base) {
+  return print(n, base) + println();
+}
+
+size_t Print::println(int n, int base) {
+  return print(n, base) + println();
+}
+
+size_t Print::println(unsigned int n, int base) {
+  return print(n, base) + println();
+}
+
+size_t Print::println(long n, int base) {
+  return print(n, base) + println();
+}
+
+size_t Print::println(unsigned long n, int base) {
+  return print(n, base) + println();
+}
+
+size_t Print::println(double n, int digits) {
+  return print(n, digits) + println();
+}
+
+void (*host_serial_hook)(uint8_t c) = NULL;
+
+void host_serial_write(uint8_t c) {
+  if (host_serial_hook != NULL)
+    host_serial_hook(c);
+  else
+    putchar(c);
+}
+
+HostSerialRx::HostSerialRx() : overruns(0), head(0), count(0) {
+}
+
+void HostSerialRx::receive(const char *data, size_t len, unsigned long long start_us, unsigned long char_us) {
+  for (size_t i = 0; i < len; i++)
+    queue.push_back(std::make_pair(start_us + (unsigned long long)i * char_us, (uint8_t)data[i]));
+}
+
+void HostSerialRx::clear() {
+  queue.clear();
+  head = 0;
+  count = 0;
+}
+
+// Move the characters that have arrived by now into the buffer, those that don't fit are lost
+void HostSerialRx::arrivals() {
+  while (!queue.empty() && (queue.front().first <= host_us)) {
+    if (count < HOST_SERIAL_RX_BUFFER_SIZE) {
+      buf[(head + count) % HOST_SERIAL_RX_BUFFER_SIZE] = queue.front().second;
+      count++;
+    }
+    else
+      overruns++;
+    queue.pop_front();
+  }
+}
+
+int HostSerialRx::available() {
+  arrivals();
+  return count;
+}
+
+int HostSerialRx::read() {
+  int c = peek();
+
+  if (c >= 0) {
+    head = (head + 1) % HOST_SERIAL_RX_BUFFER_SIZE;
+    count--;
+  }
+  return c;
+}
+
+int HostSerialRx::peek() {
+  arrivals();
+  return count ? buf[head] : -1;
+}
+
+void HardwareSerial::begin(unsigned long) {
+}
+
+int HardwareSerial::available() {
+  return host_rx.available();
+}
+
+int HardwareSerial::read() {
+  return host_rx.read();
+}
+
+int HardwareSerial::peek() {
+  return host_rx.peek();
+}
+
+void HardwareSerial::flush() {
+  fflush(stdout);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  host_serial_write(c);
+  return 1;
+}
+
+NeoSWSerial::NeoSWSerial(uint8_t, uint8_t) {
+}
+
+void NeoSWSerial::begin(unsigned long) {
+}
+
+int NeoSWSerial::available() {
+  return host_rx.available();
+}
+
+int NeoSWSerial::read() {
+  return host_rx.read();
+}
+
+int NeoSWSerial::peek() {
+  return host_rx.peek();
+}
+
+size_t NeoSWSerial::write(uint8_t c) {
+  host_serial_write(c);
+  return 1;
+}
+
+void NeoSWSerial::rxISR(uint8_t) {
+}
+
+// ---- avr-libc string functions ----
+
+size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t len = strlen(src);
+
+  if (size != 0) {
+    size_t n = (len < size - 1) ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+
+size_t strlcat(char *dst, const char *src, size_t size) {
+  size_t len = strnlen(dst, size);
+
+  if (len == size) return len + strlen(src);
+  return len + strlcpy(dst + len, src, size - len);
+}
+
+char *ultoa(unsigned long val, char *buf, int base) {
+  char tmp[33];
+  int i = 0;
+  int j = 0;
+
+  do {
+    tmp[i++] = "0123456789abcdefghijklmnopqrstuvwxyz"[val % base];
+    val /= base;
+  } while (val != 0);
+
+  while (i > 0) buf[j++] = tmp[--i];
+  buf[j] = '\0';
+  return buf;
+}
+
+char *ltoa(long val, char *buf, int base) {
+  if ((val < 0) && (base == 10)) {
+    buf[0] = '-';
+    ultoa(-(unsigned long)val, buf + 1, base);
+    return buf;
+  }
+  return ultoa((unsigned long)val, buf, base);
+}
+
+char *itoa(int val, char *buf, int base) {
+  return ltoa(val, buf, base);
+}
+
+// ---- Chrono ----
+// The arithmetic is done in 32 bits, like unsigned long on the AVR, so that it rolls over with millis()
+
+Chrono::Chrono() {
+  restart();
+}
+
+void Chrono::start(unsigned long offset) {
+  if (!running) restart(offset);
+}
+
+void Chrono::stop() {
+  offset = elapsed();
+  running = false;
+}
+
+void Chrono::restart(unsigned long offset) {
+  start_time = millis();
+  this->offset = (uint32_t)offset;
+  running = true;
+}
+
+bool Chrono::isRunning() const {
+  return running;
+}
+
+bool Chrono::hasPassed(unsigned long timeout) const {
+  return elapsed() >= (uint32_t)timeout;
+}
+
+bool Chrono::hasPassed(unsigned long timeout, bool restart_if_passed) {
+  if (elapsed() < (uint32_t)timeout) return false;
+  if (restart_if_passed) restart((uint32_t)(elapsed() - timeout));
+  return true;
+}
+
+unsigned long Chrono::elapsed() const {
+  return running ? (uint32_t)(millis() - start_time + offset) : offset;
+}
+
+void Chrono::add(unsigned long t) {
+  offset += (uint32_t)t;
+}
+
+// ---- TimeLib ----
+
+static time_t sys_time = 0;              // System time at prev_ms
+static uint32_t prev_ms = 0;
+static timeStatus_t time_status = timeNotSet;
+
+timeStatus_t timeStatus() {
+  return time_status;
+}
+
+void setTime(time_t t) {
+  sys_time = t;
+  prev_ms = millis();
+  time_status = timeSet;
+}
+
+void setTime(int hr, int min, int sec, int dy, int mnth, int yr) {
+  struct tm tm;
+
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_year = ((yr < 100) ? yr + 2000 : yr) - 1900;
+  tm.tm_mon = mnth - 1;
+  tm.tm_mday = dy;
+  tm.tm_hour = hr;
+  tm.tm_min = min;
+  tm.tm_sec = sec;
+  setTime(timegm(&tm));
+}
+
+void adjustTime(long adjustment) {
+  sys_time += adjustment;
+}
+
+// Whole seconds of millis() since the time was set, the same as the Time library
+time_t now() {
+  while ((uint32_t)(millis() - prev_ms) >= 1000) {
+    sys_time++;
+    prev_ms += 1000;
+  }
+  return sys_time;
+}
+
+unsigned long long host_next_second_us() {
+  uint32_t elapsed;
+
+  if (time_status == timeNotSet) return ~0ULL;
+  elapsed = millis() - prev_ms;
+  return (host_us / 1000 + (1000 - (elapsed % 1000))) * 1000;
+}
+
+static struct tm time_split(time_t t) {
+  struct tm tm;
+
+  gmtime_r(&t, &tm);
+  return tm;
+}
+
+int year(time_t t) {
+  return time_split(t).tm_year + 1900;
+}
+
+int month(time_t t) {
+  return time_split(t).tm_mon + 1;
+}
+
+int day(time_t t) {
+  return time_split(t).tm_mday;
+}
+
+int hour(time_t t) {
+  return time_split(t).tm_hour;
+}
+
+int minute(time_t t) {
+  return time_split(t).tm_min;
+}
+
+int second(time_t t) {
+  return time_split(t).tm_sec;
+}
+
+int year() {
+  return year(now());
+}
+
+int month() {
+  return month(now());
+}
+
+int day() {
+  return day(now());
+}
+
+int hour() {
+  return hour(now());
+}
+
+int minute() {
+  return minute(now());
+}
+
+int second() {
+  return second(now());
+}
@@ -0,0 +1,221 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+/*
+    Arduino.h - Arduino core shim for the host build of the Orion modules (see CMakeLists.txt)
+
+   Just enough of the Arduino core API, the avr-libc program memory functions and the ATmega328p registers for the
+   Orion modules to compile and run on a PC with the mock HAL in OrionHal.cpp. Program memory is ordinary memory,
+   the registers are ordinary variables that nothing looks at, and time only moves when a test calls
+   host_advance_ms() or the firmware calls delay(). millis() and micros() wrap around at 32 bits like on the AVR.
+   Serial output goes to stdout, or to host_serial_hook. The host_xxx functions and variables are for the host
+   programs, e.g. the board simulator in sim_board.cpp, and aren't part of the Arduino API.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <time.h>
+#include <deque>
+#include <utility>
+#include "binary.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#if !defined(F_CPU)
+#define F_CPU 8000000UL
+#endif
+
+// ---- Program memory ----
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(p)  (*(const uint8_t *)(p))
+#define pgm_read_word(p)  (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define pgm_read_ptr(p)   (*(void * const *)(p))
+#define strcmp_P  strcmp
+#define strncmp_P strncmp
+#define strcpy_P  strcpy
+#define strncpy_P strncpy
+#define strchr_P  strchr
+#define strlen_P  strlen
+#define memcpy_P  memcpy
+
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper *)(s))
+
+// ---- Bits, pins and interrupts ----
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define DEFAULT 1
+#define INTERNAL 3
+#define HEX 16
+#define DEC 10
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+#define _BV(b) (1 << (b))
+#define bit_is_set(r, b) ((r) & _BV(b))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define digitalPinToInterrupt(p) ((p) - 2)
+
+#define noInterrupts() ((void)0)
+#define interrupts() ((void)0)
+#define cli() ((void)0)
+#define sei() ((void)0)
+
+// ---- ATmega328p registers, plain variables in the host build ----
+#define RAMEND 0x8FF
+#define PORF  0
+#define EXTRF 1
+#define BORF  2
+#define WDRF  3
+
+extern volatile uint8_t TCCR1A, TCCR1B, TIMSK1, TIFR1, GTCCR, MCUSR, WDTCSR, EIMSK, PCICR, PCIFR, PCMSK1, ADMUX, ADCSRA;
+extern volatile uint8_t PORTB, PORTC, PORTD, DDRB, DDRC, DDRD, PINB, PINC, PIND;
+extern volatile uint8_t TCCR2A, TCCR2B, TIMSK2, TCNT2, OCR2A, TIFR2, GPIOR0, ASSR;
+extern volatile uint16_t TCNT1, OCR1A, OCR1B, ADCW, SP;
+
+enum {CS10 = 0, CS11 = 1, CS12 = 2, WGM12 = 3, WGM13 = 4, OCIE1A = 1, OCIE1B = 2, TOIE1 = 0, PSRSYNC = 0, PSRASY = 1,
+      TOV1 = 0, OCF1A = 1, OCF1B = 2, WDCE = 4, WDE = 3, PCIE1 = 1, PCIF1 = 1, PCINT13 = 5, INT0 = 0, INT1 = 1,
+      REFS1 = 7, REFS0 = 6, MUX3 = 3, ADEN = 7, ADSC = 6, WGM21 = 1, CS20 = 0, CS21 = 1, CS22 = 2, OCIE2A = 1, OCF2A = 1};
+
+// ---- Time ----
+// 32 bits, as unsigned long is on the AVR, so that the firmware sees the same rollovers
+uint32_t millis();
+uint32_t micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void host_advance_ms(unsigned long ms);           // Move the clock on, see host_advance_hook
+void host_advance_us(unsigned long long us);
+unsigned long long host_time_us();                // The host clock, which doesn't wrap around
+void host_set_time_us(unsigned long long us);
+// Optional. If set, moving the clock on calls it with the new time instead, and it is up to the hook to get there
+// with host_set_time_us(), e.g. one interrupt at a time.
+extern void (*host_advance_hook)(unsigned long long until_us);
+
+// ---- Digital and analog I/O ----
+// Pin levels and analog values are whatever a host program puts in host_pin_levels[] and host_analog_values[], pin
+// modes and outputs are ignored. attachInterrupt() remembers the handler in host_ext_isr[] for the host program to call.
+#define HOST_NUM_PINS 20
+extern uint8_t host_pin_levels[HOST_NUM_PINS];
+extern int host_analog_values[8];
+extern void (*host_ext_isr[2])(void);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogReference(uint8_t mode);
+void attachInterrupt(uint8_t irq, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t irq);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+// ---- Print and Serial ----
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    size_t write(const char *s);
+    size_t print(const __FlashStringHelper *s);
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+    size_t println();
+    size_t println(const __FlashStringHelper *s);
+    size_t println(const char *s);
+    size_t println(char c);
+    size_t println(unsigned char n, int base = DEC);
+    size_t println(int n, int base = DEC);
+    size_t println(unsigned int n, int base = DEC);
+    size_t println(long n, int base = DEC);
+    size_t println(unsigned long n, int base = DEC);
+    size_t println(double n, int digits = 2);
+};
+
+// Each character written by HardwareSerial or NeoSWSerial goes to host_serial_hook if it is set, otherwise to stdout
+extern void (*host_serial_hook)(uint8_t c);
+void host_serial_write(uint8_t c);
+
+// Received characters go through the 64 byte receive buffer of the Arduino core (NeoSWSerial has one the same size).
+// receive() queues characters that arrive one every char_us from start_us on the host clock. They are moved to the
+// buffer as the firmware reads it, and when the buffer is full they are lost, as they would be on the AVR.
+#define HOST_SERIAL_RX_BUFFER_SIZE 64
+
+class HostSerialRx {
+  public:
+    HostSerialRx();
+    void receive(const char *data, size_t len, unsigned long long start_us, unsigned long char_us);
+    void clear();                       // Empty the buffer and the queue, e.g. on a reset
+    int available();
+    int read();
+    int peek();
+    unsigned long overruns;             // Characters lost to a full buffer
+
+  private:
+    void arrivals();
+    std::deque<std::pair<unsigned long long, uint8_t> > queue;
+    uint8_t buf[HOST_SERIAL_RX_BUFFER_SIZE];
+    uint8_t head;
+    uint8_t count;
+};
+
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long baud);
+    int available();
+    int read();
+    int peek();
+    void flush();
+    size_t write(uint8_t c);
+    using Print::write;
+
+    HostSerialRx host_rx;
+};
+
+extern HardwareSerial Serial;
+
+// ---- avr-libc string functions missing from glibc ----
+size_t strlcpy(char *dst, const char *src, size_t size);
+size_t strlcat(char *dst, const char *src, size_t size);
+char *ltoa(long val, char *buf, int base);
+char *ultoa(unsigned long val, char *buf, int base);
+char *itoa(int val, char *buf, int base);
+
+#endif
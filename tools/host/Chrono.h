@@ -0,0 +1,40 @@
+#ifndef CHRONO_H
+#define CHRONO_H
+/*
+    Chrono.h - Chrono library shim for the host build, a millisecond chronometer on the host millis()
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+
+class Chrono {
+  public:
+    Chrono();
+    void start(unsigned long offset = 0);
+    void stop();
+    void restart(unsigned long offset = 0);
+    bool isRunning() const;
+    bool hasPassed(unsigned long timeout) const;
+    bool hasPassed(unsigned long timeout, bool restart_if_passed);
+    unsigned long elapsed() const;
+    void add(unsigned long t);
+
+  private:
+    uint32_t start_time;
+    uint32_t offset;
+    bool running;
+};
+#endif
@@ -0,0 +1,177 @@
+/*
+   NMEAGPS.cpp - NeoGPS shim for the host build of the firmware, see NMEAGPS.h
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <NMEAGPS.h>
+
+NMEAGPS::NMEAGPS() {
+  statistics.init();
+  length = 0;
+  receiving = false;
+  memset(&merged, 0, sizeof(merged));
+  memset(&ready, 0, sizeof(ready));
+  fix_ready = false;
+}
+
+static int hex_digit(char c) {
+  if ((c >= '0') && (c <= '9')) return c - '0';
+  if ((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+  return -1;
+}
+
+// ddmm.mmmm or dddmm.mmmm and the hemisphere, in degrees
+static float nmea_degrees(const char *field, const char *hemisphere) {
+  double v = atof(field);
+  double deg = (int)(v / 100);
+  double result = deg + (v - deg * 100) / 60.0;
+
+  return ((hemisphere[0] == 'S') || (hemisphere[0] == 'W')) ? -result : result;
+}
+
+static void nmea_time(gps_fix *fix, const char *field) {
+  if (strlen(field) < 6) return;
+  fix->dateTime.hours = (field[0] - '0') * 10 + (field[1] - '0');
+  fix->dateTime.minutes = (field[2] - '0') * 10 + (field[3] - '0');
+  fix->dateTime.seconds = (field[4] - '0') * 10 + (field[5] - '0');
+  fix->valid.time = true;
+}
+
+// Parse the sentence between '$' and '*' into the merged fix, false if it has a bad format
+bool NMEAGPS::parse_sentence() {
+  char *fields[20];
+  uint8_t count = 0;
+  char *p = sentence;
+
+  fields[count++] = p;
+  while ((p = strchr(p, ',')) != NULL) {
+    *p++ = '\0';
+    if (count == sizeof(fields) / sizeof(fields[0])) return false;
+    fields[count++] = p;
+  }
+
+  if ((strlen(fields[0]) != 5) || (fields[0][0] != 'G')) return false;
+
+  if (strcmp(&fields[0][2], "GGA") == 0) {
+    if (count < 10) return false;
+    nmea_time(&merged, fields[1]);
+    if (fields[2][0] && fields[4][0]) {
+      merged.lat = nmea_degrees(fields[2], fields[3]);
+      merged.lon = nmea_degrees(fields[4], fields[5]);
+      merged.valid.location = true;
+    }
+    switch (atoi(fields[6])) {
+      case 1: merged.status = gps_fix::STATUS_STD; break;
+      case 2: merged.status = gps_fix::STATUS_DGPS; break;
+      case 6: merged.status = gps_fix::STATUS_EST; break;
+      default: merged.status = gps_fix::STATUS_NONE; break;
+    }
+    merged.valid.status = true;
+    if (fields[7][0]) {
+      merged.satellites = atoi(fields[7]);
+      merged.valid.satellites = true;
+    }
+    if (fields[9][0]) {
+      merged.alt_cm = (int32_t)(atof(fields[9]) * 100.0 + ((fields[9][0] == '-') ? -0.5 : 0.5));
+      merged.valid.altitude = true;
+    }
+    return true;
+  }
+
+  if (strcmp(&fields[0][2], "RMC") == 0) {
+    if (count < 10) return false;
+    nmea_time(&merged, fields[1]);
+    if (fields[2][0] == 'A') {
+      if (merged.status < gps_fix::STATUS_STD) merged.status = gps_fix::STATUS_STD;
+    }
+    else
+      merged.status = gps_fix::STATUS_NONE;
+    merged.valid.status = true;
+    if (fields[3][0] && fields[5][0]) {
+      merged.lat = nmea_degrees(fields[3], fields[4]);
+      merged.lon = nmea_degrees(fields[5], fields[6]);
+      merged.valid.location = true;
+    }
+    if (fields[7][0]) {
+      merged.spd_mkn = (uint32_t)(atof(fields[7]) * 1000.0 + 0.5);
+      merged.valid.speed = true;
+    }
+    if (strlen(fields[9]) >= 6) {
+      merged.dateTime.date = (fields[9][0] - '0') * 10 + (fields[9][1] - '0');
+      merged.dateTime.month = (fields[9][2] - '0') * 10 + (fields[9][3] - '0');
+      merged.dateTime.year = (fields[9][4] - '0') * 10 + (fields[9][5] - '0');
+      merged.valid.date = true;
+    }
+
+    // RMC is the last sentence of the interval
+    ready = merged;
+    fix_ready = true;
+    memset(&merged, 0, sizeof(merged));
+    return true;
+  }
+
+  return true; // A sentence that isn't parsed
+}
+
+NMEAGPS::decode_t NMEAGPS::decode(char c) {
+  uint8_t sum = 0;
+  char *star;
+  int hi, lo;
+
+  statistics.chars++;
+
+  if (c == '$') {
+    receiving = true;
+    length = 0;
+    return DECODE_CHR_OK;
+  }
+  if (!receiving) return DECODE_CHR_INVALID;
+
+  if ((c != '\r') && (c != '\n')) {
+    if (length == sizeof(sentence) - 1) {
+      receiving = false;
+      statistics.errors++;
+      return DECODE_CHR_INVALID;
+    }
+    sentence[length++] = c;
+    return DECODE_CHR_OK;
+  }
+
+  // End of the sentence, check the checksum
+  receiving = false;
+  sentence[length] = '\0';
+  star = strrchr(sentence, '*');
+  if ((star == NULL) || (strlen(star) != 3)) {
+    statistics.errors++;
+    return DECODE_CHR_INVALID;
+  }
+  for (char *p = sentence; p < star; p++) sum ^= (uint8_t)*p;
+  hi = hex_digit(star[1]);
+  lo = hex_digit(star[2]);
+  *star = '\0';
+  if ((hi < 0) || (lo < 0) || (sum != ((hi << 4) | lo)) || !parse_sentence()) {
+    statistics.errors++;
+    return DECODE_CHR_INVALID;
+  }
+
+  statistics.ok++;
+  return DECODE_COMPLETED;
+}
+
+gps_fix NMEAGPS::read() {
+  fix_ready = false;
+  return ready;
+}
@@ -0,0 +1,85 @@
+#ifndef NMEAGPS_H
+#define NMEAGPS_H
+/*
+    NMEAGPS.h - NeoGPS shim for the host build of the firmware (see tools/host/sim_board.cpp)
+
+   The part of NeoGPS that OrionWspr.ino uses, with the default NeoGPS configuration : GGA and RMC are parsed, a
+   sentence with a bad checksum is dropped and counted as an error, and the fields of the sentences of each one second
+   interval are merged into one fix, which is available when the last sentence of the interval (RMC) arrives. Only the
+   newest fix is kept. dateTime.year is the year of the century, as in NeoGPS.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+
+#define NMEAGPS_STATS
+
+class gps_fix {
+  public:
+    enum status_t {STATUS_NONE, STATUS_EST, STATUS_TIME_ONLY, STATUS_STD, STATUS_DGPS};
+
+    struct {
+      bool status, location, altitude, speed, satellites, time, date;
+    } valid;
+    uint8_t status;
+    uint8_t satellites;
+    struct {
+      uint8_t hours, minutes, seconds, date, month, year;
+    } dateTime;
+
+    float latitude() const { return lat; }
+    float longitude() const { return lon; }
+    int32_t altitude_cm() const { return alt_cm; }
+    uint32_t speed_mkn() const { return spd_mkn; }
+
+    float lat;
+    float lon;
+    int32_t alt_cm;
+    uint32_t spd_mkn;
+};
+
+class NMEAGPS {
+  public:
+    enum decode_t {DECODE_CHR_INVALID, DECODE_CHR_OK, DECODE_COMPLETED};
+
+    NMEAGPS();
+    decode_t decode(char c);
+
+    // Process everything the port has received, true if a fix is waiting to be read
+    template <class Port> bool available(Port &port) {
+      while (port.available()) decode(port.read());
+      return fix_ready;
+    }
+
+    gps_fix read();
+
+    struct statistics_t {
+      uint32_t ok;        // Sentences
+      uint32_t errors;    // Checksum and format errors
+      uint32_t chars;
+      void init() { ok = errors = chars = 0; }
+    } statistics;
+
+  private:
+    bool parse_sentence();
+    char sentence[100];
+    uint8_t length;
+    bool receiving;
+    gps_fix merged;        // The interval so far
+    gps_fix ready;         // The last complete interval
+    bool fix_ready;
+};
+#endif
@@ -0,0 +1,36 @@
+#ifndef NEOSWSERIAL_H
+#define NEOSWSERIAL_H
+/*
+    NeoSWSerial.h - NeoSWSerial library shim for the host build, output to stdout like Serial
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+
+class NeoSWSerial : public Print {
+  public:
+    NeoSWSerial(uint8_t rx_pin, uint8_t tx_pin);
+    void begin(unsigned long baud);
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t c);
+    using Print::write;
+    static void rxISR(uint8_t port_input);
+
+    HostSerialRx host_rx;               // See Arduino.h
+};
+#endif
@@ -0,0 +1,46 @@
+#ifndef TIMELIB_H
+#define TIMELIB_H
+/*
+    TimeLib.h - Time library shim for the host build, system time kept in seconds on the host millis()
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+
+enum timeStatus_t {timeNotSet, timeNeedsSync, timeSet};
+
+timeStatus_t timeStatus();
+void setTime(time_t t);
+void setTime(int hr, int min, int sec, int day, int month, int yr);
+void adjustTime(long adjustment);
+time_t now();
+int year();
+int month();
+int day();
+int hour();
+int minute();
+int second();
+int year(time_t t);
+int month(time_t t);
+int day(time_t t);
+int hour(time_t t);
+int minute(time_t t);
+int second(time_t t);
+
+// Not part of the Time library : the host clock (see host_time_us()) when now() next moves on to a new second, for
+// the board simulator to run loop() at the start of each second like the firmware would. Never if the time isn't set.
+unsigned long long host_next_second_us();
+#endif
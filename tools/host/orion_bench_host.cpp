@@ -0,0 +1,298 @@
+/*
+   orion_bench_host.cpp - Host benchmark of the Orion WSPR Beacon hot functions (see CMakeLists.txt)
+
+   Runs the benchmarks of the "bench" serial monitor command (bench_table in OrionBenchmark.cpp) on the host and
+   reports, for each benchmarked function :
+
+     - instructions : the instructions executed by one call, counted by single stepping the call in a traced child
+                      process. Only the instructions in this executable are counted, not the ones in the C library,
+                      so the figure doesn't depend on which memcpy() or strlen() the C library picked for the CPU.
+     - stack        : the stack used by one call, including the return address, from the lowest stack pointer seen
+                      while single stepping. The firmware is built without the x86-64 red zone so that a leaf
+                      function can't use stack below the stack pointer.
+     - flash        : the size of the function's code, from the symbol table of this executable (nm)
+     - ns           : the time per call, the best of BENCH_TIMING_RUNS runs, for reference only
+
+   Host instructions aren't AVR cycles, but they are exact and repeatable, which a regression test needs and a host
+   time or cycle count isn't. With -b the instructions, stack and flash of each function are compared with a baseline
+   file, and the exit status is 1 if any of them is more than BENCH_THRESHOLD_PCT worse, or a benchmark isn't in the
+   baseline. The figures depend on the host compiler, save a new baseline with -s after a compiler change or a change
+   to the firmware that is meant to change them, and check the difference.
+
+   Options :
+     -b file           compare with the baseline in file
+     -s file           save the results as a new baseline
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#include "OrionXConfig.h"
+#include "OrionBenchmark.h"
+#include "OrionParameters.h"
+
+#if !defined (__x86_64__)
+#error "orion_bench_host single steps x86-64 code"
+#endif
+
+#define BENCH_TIMING_RUNS   5
+#define BENCH_MAX           32
+#define BENCH_KEY_LEN       32
+
+// The code of this executable, from the linker
+extern char __executable_start[];
+extern char etext[];
+
+struct BenchFigures {
+  char key[BENCH_KEY_LEN];       // The benchmark name up to the first space, the function it measures
+  long instructions;
+  long stack_bytes;
+  long flash_bytes;
+};
+
+static struct BenchFigures results[BENCH_MAX];
+static struct BenchFigures baseline[BENCH_MAX];
+static int num_baseline = 0;
+
+static void usage() {
+  fprintf(stderr, "usage: orion_bench_host [-b baseline] [-s new_baseline]\n");
+  exit(2);
+}
+
+// Single step one call of fn in a child process, counting its instructions and the lowest stack pointer
+static bool bench_trace(void (*fn)(), long *instructions, long *stack_bytes) {
+  struct user_regs_struct regs;
+  unsigned long long entry_sp;
+  unsigned long long min_sp;
+  int status;
+  long count = 0;
+  pid_t pid;
+
+  fflush(NULL);
+  pid = fork();
+  if (pid < 0) return false;
+  if (pid == 0) {
+    fn(); // Warm up, like the firmware does, then the call that is measured
+    ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+    raise(SIGSTOP);
+    fn();
+    _exit(0);
+  }
+
+  if ((waitpid(pid, &status, 0) != pid) || !WIFSTOPPED(status)) return false;
+
+  // Step through the end of raise() to the first instruction of fn
+  do {
+    if ((ptrace(PTRACE_SINGLESTEP, pid, NULL, NULL) < 0) || (waitpid(pid, &status, 0) != pid) ||
+        !WIFSTOPPED(status) || (ptrace(PTRACE_GETREGS, pid, NULL, &regs) < 0)) return false;
+  } while (regs.rip != (unsigned long long)fn);
+
+  // The return address is at the stack pointer on entry, fn has returned once the stack pointer is above it
+  entry_sp = regs.rsp;
+  min_sp = entry_sp;
+  while (regs.rsp <= entry_sp) {
+    if ((regs.rip >= (unsigned long long)__executable_start) && (regs.rip < (unsigned long long)etext)) count++;
+    if ((ptrace(PTRACE_SINGLESTEP, pid, NULL, NULL) < 0) || (waitpid(pid, &status, 0) != pid) ||
+        !WIFSTOPPED(status) || (ptrace(PTRACE_GETREGS, pid, NULL, &regs) < 0)) return false;
+    if (regs.rsp < min_sp) min_sp = regs.rsp;
+  }
+
+  kill(pid, SIGKILL);
+  waitpid(pid, &status, 0);
+
+  *instructions = count;
+  *stack_bytes = (long)(entry_sp + sizeof(void *) - min_sp);
+  return true;
+}
+
+static long bench_ns_per_call(void (*fn)(), uint16_t iterations) {
+  struct timespec start, end;
+  long best = -1;
+  long ns;
+
+  fn();
+  for (int run = 0; run < BENCH_TIMING_RUNS; run++) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint16_t i = 0; i < iterations; i++) fn();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ns = ((end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec)) / iterations;
+    if ((best < 0) || (ns < best)) best = ns;
+  }
+  return best;
+}
+
+// The qualified name of a demangled symbol, without its return type and arguments, like orion_flash_report.py
+static void symbol_base_name(char *name) {
+  char *p = strchr(name, '(');
+  char *space;
+
+  if (p != NULL) *p = '\0';
+  while ((p = name + strlen(name)) > name && (p[-1] == ' ')) p[-1] = '\0';
+  space = strrchr(name, ' ');
+  if (space != NULL) memmove(name, space + 1, strlen(space + 1) + 1);
+}
+
+// Code size of a function, over all of its overloads, -1 if it isn't in the symbol table
+static long bench_flash_bytes(const char *function) {
+  char line[512];
+  char type;
+  char name[400];
+  unsigned long long addr, size;
+  char exe[256];
+  char cmd[300];
+  long total = -1;
+  ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+  FILE *nm;
+
+  if (len <= 0) return -1;
+  exe[len] = '\0';
+  snprintf(cmd, sizeof(cmd), "nm --print-size -C '%s' 2>/dev/null", exe);
+  if ((nm = popen(cmd, "r")) == NULL) return -1;
+  while (fgets(line, sizeof(line), nm) != NULL) {
+    if (sscanf(line, "%llx %llx %c %399[^\n]", &addr, &size, &type, name) != 4) continue;
+    if (strchr("TtWw", type) == NULL) continue;
+    symbol_base_name(name);
+    if (strcmp(name, function) == 0) total = (total < 0) ? (long)size : total + (long)size;
+  }
+  pclose(nm);
+  return total;
+}
+
+// The function whose code a benchmark measures
+static const char *bench_function(const char *key) {
+  if (strcmp(key, "nmea_parse") == 0) return "NMEAGPS::decode";
+  return key;
+}
+
+static bool read_baseline(const char *path) {
+  char line[256];
+  FILE *f = fopen(path, "r");
+
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  while ((fgets(line, sizeof(line), f) != NULL) && (num_baseline < BENCH_MAX)) {
+    struct BenchFigures *b = &baseline[num_baseline];
+
+    if (line[0] == '#') continue;
+    if (sscanf(line, "%31s %ld %ld %ld", b->key, &b->instructions, &b->stack_bytes, &b->flash_bytes) == 4)
+      num_baseline++;
+  }
+  fclose(f);
+  return true;
+}
+
+static bool write_baseline(const char *path, int count) {
+  FILE *f = fopen(path, "w");
+
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  fprintf(f, "# orion_bench_host baseline : function, instructions, stack bytes and flash bytes per call\n");
+  for (int i = 0; i < count; i++)
+    fprintf(f, "%s %ld %ld %ld\n", results[i].key, results[i].instructions, results[i].stack_bytes,
+            results[i].flash_bytes);
+  fclose(f);
+  return true;
+}
+
+static const struct BenchFigures *find_baseline(const char *key) {
+  for (int i = 0; i < num_baseline; i++)
+    if (strcmp(baseline[i].key, key) == 0) return &baseline[i];
+  return NULL;
+}
+
+// True if result is more than BENCH_THRESHOLD_PCT worse than base, the same test as the firmware
+static bool bench_exceeds(long result, long base) {
+  return (result * 100L) > (base * (100L + BENCH_THRESHOLD_PCT));
+}
+
+int main(int argc, char **argv) {
+  const char *baseline_path = NULL;
+  const char *save_path = NULL;
+  struct OrionBenchmark bench;
+  struct BenchFigures *r;
+  const struct BenchFigures *b;
+  bool failed;
+  bool all_passed = true;
+  long ns;
+  int count;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "b:s:")) != -1) {
+    switch (opt) {
+      case 'b':
+        baseline_path = optarg;
+        break;
+      case 's':
+        save_path = optarg;
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind != argc) usage();
+  if ((baseline_path != NULL) && !read_baseline(baseline_path)) return 2;
+
+  params_set_defaults(); // The callsign for wspr_encode()
+
+  count = (bench_count() < BENCH_MAX) ? bench_count() : BENCH_MAX;
+
+  printf("function                      instructions  stack  flash      ns  baseline instructions/stack/flash\n");
+  for (int i = 0; i < count; i++) {
+    r = &results[i];
+    bench_get(i, &bench);
+    snprintf(r->key, sizeof(r->key), "%.*s", (int)strcspn(bench.name, " "), bench.name);
+
+    if (!bench_trace(bench.fn, &r->instructions, &r->stack_bytes)) {
+      printf("%s : couldn't single step the call\n", r->key);
+      return 2;
+    }
+    r->flash_bytes = bench_flash_bytes(bench_function(r->key));
+    ns = bench_ns_per_call(bench.fn, bench.iterations);
+
+    printf("%-30s%12ld  %5ld  %5ld  %6ld", r->key, r->instructions, r->stack_bytes, r->flash_bytes, ns);
+
+    if (baseline_path != NULL) {
+      b = find_baseline(r->key);
+      if (b == NULL) {
+        printf("  -  FAIL (not in the baseline)");
+        all_passed = false;
+      }
+      else {
+        failed = bench_exceeds(r->instructions, b->instructions) || bench_exceeds(r->stack_bytes, b->stack_bytes) ||
+                 bench_exceeds(r->flash_bytes, b->flash_bytes);
+        if (failed) all_passed = false;
+        printf("  %ld/%ld/%ld%s", b->instructions, b->stack_bytes, b->flash_bytes, failed ? "  FAIL" : "");
+      }
+    }
+    printf("\n");
+  }
+
+  if ((save_path != NULL) && write_baseline(save_path, count)) printf("Baseline saved to %s\n", save_path);
+  if (baseline_path != NULL) printf("Threshold %d%% : %s\n", BENCH_THRESHOLD_PCT, all_passed ? "PASS" : "FAIL");
+
+  return all_passed ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+/*
+   orion_host_sim.cpp - Command line front end of the host board simulator (see sim_board.cpp)
+
+   Runs the sketch on a simulated board and writes a text trace of the Si5351a register writes, the serial monitor
+   output and the state changes, and optionally a VCD trace of the pins and interrupts for orion_sim_report.py or
+   gtkwave. A summary of the run (the WSPR transmissions, the final state and correction factor) is printed at the end.
+
+   Options :
+     -s seconds        simulated time to run for (900)
+     -T hhmmss         UTC at power up, on 2019-06-01 (000050)
+     -f seconds        time to the first GPS fix (20)
+     -x ppb            error of the Si5351a crystal (SI5351A_CLK_FREQ_CORRECTION + 1200)
+     -p ppb            error of the processor clock (20000)
+     -L lat,lon        position reported by the GPS
+     -C callsign       callsign parameter, saved to EEPROM before the first boot
+     -F fault          a fault, class@start+seconds[=value] (see sim_board.h), e.g. pps-missing@700+2400
+     -M text@seconds   a serial monitor command, e.g. "l@1" turns on the TX log
+     -t file           text trace (stdout)
+     -o file           VCD trace
+
+   Run fifteen minutes from power up, the startup calibration, telemetry and the primary and secondary transmissions :
+        orion_host_sim -s 900 -M l@1 -o orion.vcd
+        python3 tools/orion_sim/orion_sim_report.py orion.vcd
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim_board.h"
+
+#define SIM_DAY_UTC_MS 1559347200000LL      // 2019-06-01 00:00:00 UTC
+
+static void usage() {
+  fprintf(stderr, "usage: orion_host_sim [-s seconds] [-T hhmmss] [-f seconds] [-x ppb] [-p ppb] [-L lat,lon]\n"
+                  "                      [-C callsign] [-F class@start+seconds[=value]] [-M text@seconds]\n"
+                  "                      [-t trace] [-o vcd]\n");
+  exit(2);
+}
+
+static struct SimConfig cfg;
+static struct SimResults res;    // Too big for the stack
+
+int main(int argc, char **argv) {
+  int opt;
+  long hhmmss;
+  const char *at;
+
+  sim_config_defaults(&cfg);
+  snprintf(cfg.trace_path, sizeof(cfg.trace_path), "/dev/stdout");
+
+  while ((opt = getopt(argc, argv, "s:T:f:x:p:L:C:F:M:t:o:")) != -1) {
+    switch (opt) {
+      case 's':
+        cfg.run_s = atof(optarg);
+        break;
+      case 'T':
+        hhmmss = atol(optarg);
+        cfg.start_utc_ms = SIM_DAY_UTC_MS + ((hhmmss / 10000) * 3600 + ((hhmmss / 100) % 100) * 60 + hhmmss % 100) * 1000LL;
+        break;
+      case 'f':
+        cfg.fix_s = atof(optarg);
+        break;
+      case 'x':
+        cfg.xtal_ppb = atol(optarg);
+        break;
+      case 'p':
+        cfg.cpu_ppb = atol(optarg);
+        break;
+      case 'L':
+        if (sscanf(optarg, "%lf,%lf", &cfg.lat, &cfg.lon) != 2) usage();
+        break;
+      case 'C':
+        snprintf(cfg.callsign, sizeof(cfg.callsign), "%s", optarg);
+        break;
+      case 'F':
+        if ((cfg.num_faults == SIM_MAX_FAULTS) || !sim_parse_fault(optarg, &cfg.faults[cfg.num_faults])) usage();
+        cfg.num_faults++;
+        break;
+      case 'M':
+        at = strrchr(optarg, '@');
+        if ((at == NULL) || (cfg.num_monitor == SIM_MAX_MONITOR)) usage();
+        snprintf(cfg.monitor[cfg.num_monitor].text, sizeof(cfg.monitor[0].text), "%.*s", (int)(at - optarg), optarg);
+        cfg.monitor[cfg.num_monitor].t_s = atof(at + 1);
+        if ((cfg.num_monitor > 0) && (cfg.monitor[cfg.num_monitor].t_s < cfg.monitor[cfg.num_monitor - 1].t_s)) usage();
+        cfg.num_monitor++;
+        break;
+      case 't':
+        snprintf(cfg.trace_path, sizeof(cfg.trace_path), "%s", optarg);
+        break;
+      case 'o':
+        snprintf(cfg.vcd_path, sizeof(cfg.vcd_path), "%s", optarg);
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind != argc) usage();
+
+  if (!sim_run(&cfg, &res)) return 1;
+
+  printf("# %u boots, %u PPS pulses, %u NMEA sentences, %u NMEA errors, %u characters lost\n", res.boots,
+         res.pps_pulses, res.nmea_sentences, res.gps_errors, res.serial_overruns);
+  for (uint32_t i = 0; i < res.num_tx; i++) {
+    const struct SimTx *tx = &res.tx[i];
+    printf("# TX %s at %.3f s for %.3f s, tone 0 %.3f Hz (%+.3f Hz), %u tone changes\n", sim_state_name(tx->state),
+           tx->on_s, tx->off_s - tx->on_s, tx->tone0_hz, tx->tone0_hz - tx->target_hz, tx->tone_changes);
+  }
+  printf("# %u QRSS key downs, end at %.3f s in %s, correction %d\n", res.qrss_keydowns, res.end_s,
+         sim_state_name(res.final_state), res.final_correction);
+  return 0;
+}
@@ -0,0 +1,961 @@
+/*
+   sim_board.cpp - Host simulator of an Orion WSPR Beacon board (see sim_board.h)
+
+   The sketch runs unchanged on the mock HAL and the Arduino shims in tools/host. Simulated time only moves when the
+   firmware lets it, through delay(), the busy waits for an interrupt (hal_spin() and hal_sleep_idle()) and between
+   two passes of loop(), and sim_advance() is the only place where it moves. It steps from one board event to the
+   next, calling the interrupt handlers the way the AVR would :
+
+     - the GPS : a 1PPS pulse (100 ms long) at the start of each UTC second once it has a fix, followed by the GGA and
+       RMC sentences for that second at 9600 baud on the GPS serial port. Before the fix the sentences are empty.
+     - Timer2 : the compare match interrupt every (OCR2A + 1) x 1024 processor clocks while it runs (WSPR symbols)
+     - Timer1 : the compare match B interrupt in CTC mode (QRSS keyer), or as a counter, the CAL clock edges on D5
+       and the overflow interrupt every 65536 of them
+     - the Si5351a : the I2C writes are applied to a register image, from which the frequencies of the CAL and TX
+       clocks follow (crystal x PLLA / multisynth / R divider). The CAL clock feeds Timer1, the TX clock is recorded.
+
+   There are two clocks. The processor clock (millis(), micros(), the Timer2 and Timer1 prescalers) is host_time_us(),
+   cpu_ppb fast and reset to zero by a reset like on the AVR. Everything outside the processor runs on true time, in
+   nanoseconds since the first power up. The Si5351a crystal is xtal_ppb fast, which the self-calibration has to find.
+
+   A board reset (SIM_VOLTAGE_SAG) throws SimReset out of sim_advance() to the top of the boot, which saves the
+   EEPROM and the orion_noinit section (HAL_NOINIT, see OrionHal.h) and ends the child process running the boot.
+   sim_run() then starts the next boot in a new child, forked from a process where the sketch has never run, so the
+   sketch gets fresh static data like after a real reset. The end of the run throws SimStop the same way.
+
+   The text trace has a line per event, each starting with the simulated time in seconds :
+     <t> i2c 0x60 reg <n> : <bytes>     a write to the Si5351a, at the end of the I2C transaction
+     <t> mon <text>                     a line written to the serial monitor
+     <t> state <name>                   the Orion state machine changed state
+     <t> boot reset 0x<flags>           the processor started, with its hal_reset_flags()
+   The VCD trace has the PPS pin, the probe pins (see ORION_TIMING_PROBES in OrionBoardConfig.h) and a zero width
+   pulse for each interrupt, the run time of the code isn't simulated.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+#include "OrionBoardConfig.h"
+#include "OrionHal.h"
+#include "OrionParameters.h"
+#include "OrionPerfCounters.h"
+#include "OrionSi5351.h"
+#include "OrionStateMachine.h"
+#include <TimeLib.h>
+#include <Chrono.h>
+#include <NeoSWSerial.h>
+#include <math.h>
+#include <stdarg.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "sim_board.h"
+
+// The sketch, see sim_firmware.cpp
+void setup();
+void loop();
+extern Chrono g_chrono_GPS_LOS;
+extern unsigned long g_beacon_freq_hz;
+
+// Interrupt handlers, ordinary functions in the host build (see OrionHal.h)
+void TIMER1_OVF_vect();
+void TIMER1_COMPB_vect();
+void TIMER2_COMPA_vect();
+#if !defined (GPS_PPS_ON_D2_OR_D3)
+void PCINT1_vect();
+#endif
+
+#if defined (GPS_USES_HW_SERIAL)
+#define sim_gps_rx Serial.host_rx
+#else
+extern NeoSWSerial gpsPort;
+#define sim_gps_rx gpsPort.host_rx
+#endif
+
+#if defined (DEBUG_USES_SW_SERIAL)
+extern NeoSWSerial debugSerial;
+#define sim_monitor_rx debugSerial.host_rx
+#else
+#define sim_monitor_rx Serial.host_rx
+#endif
+
+// The orion_noinit section, if there is anything in it
+extern char __start_orion_noinit[] __attribute__ ((weak));
+extern char __stop_orion_noinit[] __attribute__ ((weak));
+
+#define SIM_NOINIT_MAX        256
+#define SIM_SERIAL_CHAR_US    1042          // 10 bits at 9600 baud, the GPS and the serial monitor
+#define SIM_PPS_WIDTH_NS      100000000LL
+#define SIM_PPS_DOUBLE_MS     300           // Defaults of the fault values
+#define SIM_NMEA_DELAY_MS     800
+#define SIM_PPS_DOUBLE_WIDTH_NS 10000000LL
+#define SIM_I2C_BIT_US        10            // 100 kHz, 9 clocks per byte
+#define SIM_LOOP_STEP_US      250000ULL     // Longest time between two passes of loop()
+#define SIM_LOOP_RX_STEP_US   50000ULL      // ... while the GPS is sending, 48 characters
+#define SIM_SPIN_STEP_US      10000ULL      // Longest busy wait step, the firmware checks its guard timers in the wait
+#define SIM_XTAL_HZ           (SI5351BX_XTAL / 100.0L)
+#define SIM_TEMP_ADC          350           // About 21 C for read_processor_temperature()
+#define SIM_VCC_V             3.3
+
+static const uint64_t timer_tick_us = (1024ULL * 1000000ULL) / F_CPU;  // Timer1 and Timer2 prescalers
+
+// Everything that outlives a boot, in memory shared with the sim_run() process
+struct SimShared {
+  struct SimConfig cfg;
+  struct SimResults res;
+  long long boot_ns;               // True time at the start of the current boot
+  uint8_t reset_flags;
+  uint8_t eeprom[HAL_MOCK_EEPROM_SIZE];
+  uint8_t noinit[SIM_NOINIT_MAX];
+  long long vcd_us;                // Last time written to the VCD trace
+};
+
+enum SimExit {SIM_EXIT_DONE = 0, SIM_EXIT_RESET = 3, SIM_EXIT_ERROR = 4};
+
+struct SimStop {};
+struct SimReset {};
+
+static struct SimShared *sh;
+static const struct SimConfig *cfg;
+static struct SimResults *res;
+static FILE *trace;
+static FILE *vcd;
+
+// ---- Time ----
+
+// True time of a host (processor) time in this boot, and the first host time at or after a true time
+static long long true_ns(unsigned long long host) {
+  return sh->boot_ns + (long long)(((__int128)host * 1000000000000LL) / (1000000000LL + cfg->cpu_ppb));
+}
+
+static unsigned long long host_at(long long t_ns) {
+  __int128 d = t_ns - sh->boot_ns;
+
+  if (d <= 0) return 0;
+  return (unsigned long long)((d * (1000000000LL + cfg->cpu_ppb) + 999999999999LL) / 1000000000000LL);
+}
+
+static long long now_ns() {
+  return true_ns(host_time_us());
+}
+
+static const char *time_text(long long t_ns) {
+  static char buf[32];
+
+  snprintf(buf, sizeof(buf), "%lld.%06lld", t_ns / 1000000000LL, (t_ns / 1000LL) % 1000000LL);
+  return buf;
+}
+
+// ---- Faults ----
+
+static bool fault_active(uint8_t fault_class, long long t_ns, double *value) {
+  double t_s = t_ns / 1e9;
+
+  for (uint8_t i = 0; i < cfg->num_faults; i++) {
+    const struct SimFault *f = &cfg->faults[i];
+    if ((f->fault_class == fault_class) && (t_s >= f->start_s) && (t_s < f->start_s + f->length_s)) {
+      if (value != NULL) *value = f->value;
+      return true;
+    }
+  }
+  return false;
+}
+
+// ---- Traces ----
+
+enum VcdSignal {VCD_PPS, VCD_PROBE_SYMBOL, VCD_PROBE_CAL, VCD_PROBE_I2C, VCD_ISR_PPS, VCD_ISR_TIMER2_COMPA,
+                VCD_ISR_TIMER1_COMPB, VCD_ISR_TIMER1_OVF, VCD_NUM_SIGNALS
+               };
+static const char *const vcd_names[VCD_NUM_SIGNALS] = {"pps", "probe_symbol", "probe_cal", "probe_i2c", "isr_pps",
+                                                       "isr_timer2_compa", "isr_timer1_compb", "isr_timer1_ovf"
+                                                      };
+static uint8_t probes_seen;
+
+static void vcd_change(uint8_t signal, bool level) {
+  long long t_us = now_ns() / 1000;
+
+  if (vcd == NULL) return;
+  if (t_us != sh->vcd_us) {
+    fprintf(vcd, "#%lld\n", t_us);
+    sh->vcd_us = t_us;
+  }
+  fprintf(vcd, "%d%c\n", level ? 1 : 0, '!' + signal);
+}
+
+static void vcd_begin(bool first_boot) {
+  if (cfg->vcd_path[0] == '\0') return;
+  vcd = fopen(cfg->vcd_path, first_boot ? "w" : "a");
+  if (vcd == NULL) {
+    perror(cfg->vcd_path);
+    return;
+  }
+  if (!first_boot) return;
+
+  fprintf(vcd, "$timescale 1us $end\n$scope module orion $end\n");
+  for (uint8_t i = 0; i < VCD_NUM_SIGNALS; i++) fprintf(vcd, "$var wire 1 %c %s $end\n", '!' + i, vcd_names[i]);
+  fprintf(vcd, "$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+  for (uint8_t i = 0; i < VCD_NUM_SIGNALS; i++) fprintf(vcd, "0%c\n", '!' + i);
+  fprintf(vcd, "$end\n");
+  sh->vcd_us = 0;
+}
+
+// The probe pins are only looked at when the simulation gets control back, between two events
+static void vcd_probes() {
+  static const uint8_t bits[3] = {PROBE_BIT_SYMBOL, PROBE_BIT_CAL, PROBE_BIT_I2C};
+  uint8_t changed = g_hal_mock.probes ^ probes_seen;
+
+  for (uint8_t i = 0; i < 3; i++)
+    if (changed & (1 << bits[i])) vcd_change(VCD_PROBE_SYMBOL + i, (g_hal_mock.probes >> bits[i]) & 1);
+  probes_seen = g_hal_mock.probes;
+}
+
+static void trace_line(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
+static void trace_line(const char *fmt, ...) {
+  va_list ap;
+
+  if (trace == NULL) return;
+  fprintf(trace, "%s ", time_text(now_ns()));
+  va_start(ap, fmt);
+  vfprintf(trace, fmt, ap);
+  va_end(ap);
+  fputc('\n', trace);
+}
+
+// Serial monitor output, a trace line per line of text
+static char mon_line[128];
+static uint8_t mon_len;
+
+static void sim_serial_write(uint8_t c) {
+  if (c == '\n') {
+    mon_line[mon_len] = '\0';
+    trace_line("mon %s", mon_line);
+    mon_len = 0;
+  }
+  else if ((c != '\r') && (mon_len < sizeof(mon_line) - 1))
+    mon_line[mon_len++] = c;
+}
+
+// ---- State machine ----
+
+static uint8_t state_seen;
+
+static void note_state() {
+  uint8_t state = orion_sm_get_state();
+  bool los = g_chrono_GPS_LOS.isRunning();
+
+  if (state == state_seen) return;
+  state_seen = state;
+  trace_line("state %s", sim_state_name(state));
+
+  if (res->num_states < SIM_MAX_STATES) {
+    struct SimStateChange *s = &res->states[res->num_states++];
+    s->t_s = now_ns() / 1e9;
+    s->state = state;
+    s->gps_los = los;
+  }
+  else
+    res->states_dropped++;
+}
+
+// ---- Si5351a ----
+
+static uint8_t si_regs[256];
+
+static void si5351_power_on() {
+  memset(si_regs, 0, sizeof(si_regs));
+  si_regs[3] = 0xFF;                                   // All outputs disabled
+  for (uint8_t i = 16; i < 24; i++) si_regs[i] = 0x80;  // and powered down
+}
+
+// a + b / c of the PLL or multisynth whose 8 parameter registers start at base
+static long double si5351_ratio(uint8_t base) {
+  const uint8_t *r = &si_regs[base];
+  uint32_t p3 = ((uint32_t)(r[5] >> 4) << 16) | ((uint32_t)r[0] << 8) | r[1];
+  uint32_t p1 = ((uint32_t)(r[2] & 3) << 16) | ((uint32_t)r[3] << 8) | r[4];
+  uint32_t p2 = ((uint32_t)(r[5] & 0x0F) << 16) | ((uint32_t)r[6] << 8) | r[7];
+
+  return (p1 + 512 + (long double)p2 / (p3 ? p3 : 1)) / 128.0L;
+}
+
+// Output frequency of clock n in Hz, 0 if it is off
+static long double si5351_freq(uint8_t n) {
+  uint8_t ctrl = si_regs[16 + n];
+  uint8_t ms = n;
+  long double xtal = SIM_XTAL_HZ * (1.0L + cfg->xtal_ppb * 1e-9L);
+  long double ms_ratio;
+
+  if ((si_regs[3] & (1 << n)) || (ctrl & 0x80)) return 0;
+
+  switch ((ctrl >> 2) & 3) {
+    case 0: return xtal;                          // The crystal
+    case 2: ms = 0; break;                        // Multisynth 0
+    case 3: break;                                // Its own multisynth
+    default: return 0;                            // CLKIN, there is none on the Si5351a
+  }
+  ms_ratio = si5351_ratio(42 + 8 * ms);
+  if (ms_ratio <= 0) return 0;
+  return xtal * si5351_ratio((si_regs[16 + ms] & 0x20) ? 34 : 26) / ms_ratio / (1 << ((si_regs[44 + 8 * n] >> 4) & 7));
+}
+
+// ---- The CAL clock and Timer1 as its counter ----
+
+static long double cal_hz;          // Frequency at D5
+static long double cal_cycles;      // CAL clock cycles since power up at cal_ns
+static long long cal_ns;
+
+static bool t1_counting;
+static uint64_t t1_total;           // Timer1 count at t1_edges, not wrapped
+static long long t1_edges;          // CAL clock edges at the last change of Timer1
+static unsigned long t1_clears;
+static bool t1_ovf_valid;
+static unsigned long long t1_ovf_at;
+
+static long long cal_edges(long long t_ns) {
+  return (long long)floorl(cal_cycles + (t_ns - cal_ns) * cal_hz * 1e-9L);
+}
+
+static void cal_set_freq(long double hz) {
+  long long t = now_ns();
+
+  if (hz == cal_hz) return;
+  cal_cycles += (t - cal_ns) * cal_hz * 1e-9L;
+  cal_ns = t;
+  cal_hz = hz;
+  t1_ovf_valid = false;
+}
+
+static uint64_t t1_count() {
+  if (!t1_counting) return t1_total;
+  return t1_total + (cal_edges(now_ns()) - t1_edges);
+}
+
+// When the count next reaches a multiple of 65536
+static unsigned long long t1_next_overflow() {
+  long long target;
+
+  if (!t1_ovf_valid) {
+    t1_ovf_valid = true;
+    t1_ovf_at = ~0ULL;
+    if (t1_counting && (cal_hz > 0)) {
+      target = t1_edges + (long long)(0x10000 - (t1_total & 0xFFFF));
+      t1_ovf_at = host_at(cal_ns + (long long)ceill((target - cal_cycles) / (cal_hz * 1e-9L)));
+    }
+  }
+  return t1_ovf_at;
+}
+
+static void t1_overflow() {
+  uint64_t count = t1_count();
+
+  // Rounding can leave the count a hair short of the overflow
+  if ((count & 0xFFFF) > 0x8000) count = (count | 0xFFFF) + 1;
+  t1_total = count;
+  t1_edges = cal_edges(now_ns());
+  t1_ovf_valid = false;
+}
+
+// ---- The TX clock ----
+
+static long double tx_hz;
+static bool tx_recording;
+
+static void tx_set_freq(long double hz) {
+  struct SimTx *tx = &res->tx[res->num_tx];
+  uint8_t state = orion_sm_get_state();
+
+  if (hz == tx_hz) return;
+
+  if ((tx_hz == 0) && (hz > 0)) {
+    if (state == QRSS_TX_ST) res->qrss_keydowns++;
+    if ((state == TX_PRIMARY_WSPR_ST) || (state == TX_SECONDARY_WSPR_ST)) {
+      if (res->num_tx < SIM_MAX_TX) {
+        memset(tx, 0, sizeof(*tx));
+        tx->on_s = now_ns() / 1e9;
+        tx->on_utc_s = cfg->start_utc_ms / 1e3 + tx->on_s;
+        tx->tone0_hz = hz;
+        tx->target_hz = g_beacon_freq_hz;
+        tx->state = state;
+        tx_recording = true;
+      }
+      else
+        res->tx_dropped++;
+    }
+  }
+  else if (tx_recording && (hz > 0)) {
+    tx->tone_changes++;
+    if (hz < tx->tone0_hz) tx->tone0_hz = hz;
+  }
+  else if (tx_recording && (hz == 0)) {
+    tx->off_s = now_ns() / 1e9;
+    res->num_tx++;
+    tx_recording = false;
+  }
+  tx_hz = hz;
+}
+
+static void sim_i2c_write(uint8_t addr, uint8_t reg, const uint8_t *vals, uint8_t count) {
+  char text[3 * 256 + 1];
+
+  HAL_PROBE_HIGH(PROBE_BIT_I2C);
+  vcd_probes();
+  host_advance_us((2 + count) * 9 * SIM_I2C_BIT_US);
+
+  for (uint8_t i = 0; i < count; i++) snprintf(&text[3 * i], 4, " %02x", vals[i]);
+  text[3 * count] = '\0';
+  trace_line("i2c 0x%02x reg %3d :%s", addr, reg, text);
+
+  if (addr == SI5351BX_ADDR) {
+    memcpy(&si_regs[reg], vals, count);
+    cal_set_freq(si5351_freq(SI5351A_CAL_CLK_NUM));
+    tx_set_freq(si5351_freq(SI5351A_WSPRTX_CLK_NUM));
+  }
+
+  HAL_PROBE_LOW(PROBE_BIT_I2C);
+  vcd_probes();
+}
+
+// ---- The GPS ----
+
+struct PpsEdge {
+  unsigned long long at;
+  bool level;
+};
+
+static long long gps_sec;                   // UTC of the next second, seconds since 1970
+static unsigned long long gps_sec_at;
+static struct PpsEdge pps_edges[4];         // Pending, in time order
+static uint8_t pps_num_edges;
+static unsigned long long gps_rx_end;       // When the last NMEA character arrives
+
+static long long utc_ns(long long utc_s) {
+  return utc_s * 1000000000LL - cfg->start_utc_ms * 1000000LL;
+}
+
+static void pps_add_edge(long long t_ns, bool level) {
+  uint8_t i = pps_num_edges;
+
+  if (pps_num_edges == sizeof(pps_edges) / sizeof(pps_edges[0])) return;
+  while ((i > 0) && (pps_edges[i - 1].at > host_at(t_ns))) {
+    pps_edges[i] = pps_edges[i - 1];
+    i--;
+  }
+  pps_edges[i].at = host_at(t_ns);
+  pps_edges[i].level = level;
+  pps_num_edges++;
+}
+
+static void nmea_coord(char *buf, size_t size, double deg, bool lat) {
+  double a = fabs(deg);
+  int d = (int)a;
+
+  snprintf(buf, size, lat ? "%02d%08.5f,%c" : "%03d%08.5f,%c", d, (a - d) * 60.0,
+           lat ? ((deg < 0) ? 'S' : 'N') : ((deg < 0) ? 'W' : 'E'));
+}
+
+// Add the checksum and CR LF to a sentence that starts with '$'
+static size_t nmea_finish(char *s, size_t size) {
+  uint8_t sum = 0;
+  size_t len = strlen(s);
+
+  for (size_t i = 1; i < len; i++) sum ^= (uint8_t)s[i];
+  return len + snprintf(&s[len], size - len, "*%02X\r\n", sum);
+}
+
+// The sentences of UTC second utc_s
+static size_t nmea_sentences(char *buf, size_t size, long long utc_s, bool fix) {
+  time_t t = (time_t)utc_s;
+  struct tm tm;
+  char lat[24];
+  char lon[24];
+  size_t len;
+
+  gmtime_r(&t, &tm);
+  nmea_coord(lat, sizeof(lat), cfg->lat, true);
+  nmea_coord(lon, sizeof(lon), cfg->lon, false);
+
+  if (fix)
+    snprintf(buf, size, "$GPGGA,%02d%02d%02d.00,%s,%s,1,08,1.0,%.1f,M,0.0,M,,", tm.tm_hour, tm.tm_min, tm.tm_sec,
+             lat, lon, cfg->alt_m);
+  else
+    snprintf(buf, size, "$GPGGA,,,,,,0,00,99.99,,,,,,");
+  len = nmea_finish(buf, size);
+
+  if (fix)
+    snprintf(&buf[len], size - len, "$GPRMC,%02d%02d%02d.00,A,%s,%s,0.010,,%02d%02d%02d,,,A", tm.tm_hour, tm.tm_min,
+             tm.tm_sec, lat, lon, tm.tm_mday, tm.tm_mon + 1, tm.tm_year % 100);
+  else
+    snprintf(&buf[len], size - len, "$GPRMC,,V,,,,,,,,,,N");
+  return len + nmea_finish(&buf[len], size - len);
+}
+
+// The start of UTC second gps_sec : its 1PPS pulse and NMEA sentences
+static void gps_second() {
+  long long t = utc_ns(gps_sec);
+  bool fix = (t / 1e9 >= cfg->fix_s);
+  double value = 0;
+  char nmea[200];
+  size_t len;
+  unsigned long long start;
+
+  if (fix && !fault_active(SIM_PPS_MISSING, t, NULL)) {
+    pps_add_edge(t, true);
+    pps_add_edge(t + SIM_PPS_WIDTH_NS, false);
+    res->pps_pulses++;
+  }
+  if (fix && fault_active(SIM_PPS_DOUBLE, t, &value)) {
+    long long extra = t + (long long)(((value > 0) ? value : SIM_PPS_DOUBLE_MS) * 1e6);
+    pps_add_edge(extra, true);
+    pps_add_edge(extra + SIM_PPS_DOUBLE_WIDTH_NS, false);
+  }
+
+  len = nmea_sentences(nmea, sizeof(nmea), gps_sec, fix);
+  res->nmea_sentences += 2;
+  if (fault_active(SIM_NMEA_CORRUPT, t, NULL)) {
+    // A digit of the time in each sentence, the checksum no longer matches
+    for (char *s = nmea; (s = strchr(s, '$')) != NULL; s++)
+      s[8] = (s[8] == '0') ? '1' : '0';
+  }
+
+  value = 0;
+  if (fault_active(SIM_NMEA_DELAY, t, &value) && (value == 0)) value = SIM_NMEA_DELAY_MS;
+  start = host_at(t + (long long)((cfg->nmea_ms + value) * 1e6));
+  sim_gps_rx.receive(nmea, len, start, SIM_SERIAL_CHAR_US);
+  gps_rx_end = start + len * SIM_SERIAL_CHAR_US;
+
+  gps_sec++;
+  gps_sec_at = host_at(utc_ns(gps_sec));
+}
+
+static void pps_edge() {
+  bool level = pps_edges[0].level;
+
+  memmove(&pps_edges[0], &pps_edges[1], (pps_num_edges - 1) * sizeof(pps_edges[0]));
+  pps_num_edges--;
+
+  host_pin_levels[GPS_PPS_PIN] = level;
+  vcd_change(VCD_PPS, level);
+
+#if defined (GPS_PPS_ON_D2_OR_D3)
+  if (!level || !g_hal_mock.pps_irq_enabled || (host_ext_isr[digitalPinToInterrupt(GPS_PPS_PIN)] == NULL)) return;
+  vcd_change(VCD_ISR_PPS, true);
+  vcd_change(VCD_ISR_PPS, false);
+  host_ext_isr[digitalPinToInterrupt(GPS_PPS_PIN)]();
+#else
+  if (!g_hal_mock.pps_irq_enabled) return;
+  vcd_change(VCD_ISR_PPS, true);
+  vcd_change(VCD_ISR_PPS, false);
+  PCINT1_vect();
+#endif
+}
+
+// ---- Keeping up with the firmware ----
+
+static bool t2_running;
+static unsigned long long t2_next;
+static bool t1_ctc;
+static uint16_t t1_ctc_top;
+static unsigned long long t1_ctc_next;
+
+// Pick up what the firmware has done to the timers since the simulation last had control. Nothing happens to the
+// time in between, so it all happened now.
+static void sim_sync() {
+  unsigned long long now = host_time_us();
+  bool counting = (g_hal_mock.timer1_mode == HAL_T1_COUNTER);
+  bool ctc = (g_hal_mock.timer1_mode == HAL_T1_CTC);
+
+  if (g_hal_mock.timer1_clears != t1_clears) {
+    t1_clears = g_hal_mock.timer1_clears;
+    t1_total = 0;
+    t1_edges = cal_edges(now_ns());
+    t1_ovf_valid = false;
+  }
+  if (counting != t1_counting) {
+    if (counting)
+      t1_edges = cal_edges(now_ns());
+    else
+      t1_total = t1_count();
+    t1_counting = counting;
+    t1_ovf_valid = false;
+  }
+  if (ctc && (!t1_ctc || (g_hal_mock.timer1_top != t1_ctc_top))) {
+    t1_ctc_top = g_hal_mock.timer1_top;
+    t1_ctc_next = now + (t1_ctc_top + 1) * timer_tick_us;
+  }
+  t1_ctc = ctc;
+
+  if (g_hal_mock.timer2_running && !t2_running) t2_next = now + (g_hal_mock.timer2_top + 1) * timer_tick_us;
+  t2_running = g_hal_mock.timer2_running;
+
+  vcd_probes();
+  note_state();
+}
+
+// What the firmware reads back from the timers
+static void sim_sync_out() {
+  if (!t1_ctc) g_hal_mock.timer1_count = (uint16_t)t1_count();
+  g_hal_mock.timer1_overflow = false;
+}
+
+static void run_isr(void (*isr)(), uint8_t signal) {
+  sim_sync_out();
+  vcd_change(signal, true);
+  vcd_change(signal, false);
+  isr();
+  sim_sync();
+}
+
+// ---- Events ----
+
+enum SimEvent {EV_RUN_END, EV_RESET, EV_GPS_SECOND, EV_PPS_EDGE, EV_TIMER2, EV_TIMER1_CTC, EV_TIMER1_OVF,
+               EV_MONITOR, EV_NONE
+              };
+
+static unsigned long long run_end_at;
+static unsigned long long reset_at;
+static double reset_length_s;
+static uint8_t monitor_next;
+
+static unsigned long long monitor_at() {
+  if (monitor_next >= cfg->num_monitor) return ~0ULL;
+  return host_at((long long)(cfg->monitor[monitor_next].t_s * 1e9));
+}
+
+static unsigned long long next_event(uint8_t *event) {
+  unsigned long long t = run_end_at;
+
+  *event = EV_RUN_END;
+  if (reset_at < t) {
+    t = reset_at;
+    *event = EV_RESET;
+  }
+  if (gps_sec_at < t) {
+    t = gps_sec_at;
+    *event = EV_GPS_SECOND;
+  }
+  if ((pps_num_edges > 0) && (pps_edges[0].at < t)) {
+    t = pps_edges[0].at;
+    *event = EV_PPS_EDGE;
+  }
+  if (t2_running && (t2_next < t)) {
+    t = t2_next;
+    *event = EV_TIMER2;
+  }
+  if (t1_ctc && (t1_ctc_next < t)) {
+    t = t1_ctc_next;
+    *event = EV_TIMER1_CTC;
+  }
+  if (t1_next_overflow() < t) {
+    t = t1_next_overflow();
+    *event = EV_TIMER1_OVF;
+  }
+  if (monitor_at() < t) {
+    t = monitor_at();
+    *event = EV_MONITOR;
+  }
+  return t;
+}
+
+static void dispatch(uint8_t event) {
+  char text[sizeof(cfg->monitor[0].text) + 1];
+
+  switch (event) {
+    case EV_RUN_END:
+      throw SimStop();
+
+    case EV_RESET:
+      throw SimReset();
+
+    case EV_GPS_SECOND:
+      gps_second();
+      break;
+
+    case EV_PPS_EDGE:
+      sim_sync_out();
+      pps_edge();
+      sim_sync();
+      break;
+
+    case EV_TIMER2:
+      run_isr(TIMER2_COMPA_vect, VCD_ISR_TIMER2_COMPA);
+      t2_next += (g_hal_mock.timer2_top + 1) * timer_tick_us;   // The ISR sets the length of the next period
+      break;
+
+    case EV_TIMER1_CTC:
+      t1_ctc_next += (t1_ctc_top + 1) * timer_tick_us;
+      run_isr(TIMER1_COMPB_vect, VCD_ISR_TIMER1_COMPB);
+      break;
+
+    case EV_TIMER1_OVF:
+      t1_overflow();
+      run_isr(TIMER1_OVF_vect, VCD_ISR_TIMER1_OVF);
+      break;
+
+    case EV_MONITOR:
+      snprintf(text, sizeof(text), "%s\r", cfg->monitor[monitor_next++].text);
+      sim_monitor_rx.receive(text, strlen(text), host_time_us(), SIM_SERIAL_CHAR_US);
+      break;
+  }
+}
+
+// host_advance_hook, run the board up to until
+static void sim_advance(unsigned long long until) {
+  uint8_t event;
+  unsigned long long t;
+
+  sim_sync();
+  while ((t = next_event(&event)) <= until) {
+    if (t > host_time_us()) host_set_time_us(t);
+    dispatch(event);
+  }
+  host_set_time_us(until);
+  sim_sync_out();
+}
+
+// g_hal_mock.wait_hook, the firmware is waiting for an interrupt
+static void sim_wait() {
+  uint8_t event;
+  unsigned long long now = host_time_us();
+  unsigned long long t = next_event(&event);
+
+  if (t > now + SIM_SPIN_STEP_US) t = now + SIM_SPIN_STEP_US;
+  host_advance_us((t > now) ? t - now : 1);
+}
+
+// ---- A boot ----
+
+static void noinit_copy(bool save) {
+  size_t size = __stop_orion_noinit - __start_orion_noinit;
+
+  if ((__start_orion_noinit == NULL) || (size > SIM_NOINIT_MAX)) return;
+  if (save)
+    memcpy(sh->noinit, __start_orion_noinit, size);
+  else
+    memcpy(__start_orion_noinit, sh->noinit, size);
+}
+
+static void boot_end() {
+  long long t = now_ns();
+
+  if (tx_recording) {
+    res->tx[res->num_tx].off_s = t / 1e9;
+    res->num_tx++;
+    tx_recording = false;
+  }
+  res->gps_errors += g_perf.gps_errors;
+  res->timer1_overflows += g_isr_counts.timer1_ovf;
+  res->serial_overruns += sim_gps_rx.overruns;
+  res->final_state = orion_sm_get_state();
+  res->final_gps_los = g_chrono_GPS_LOS.isRunning();
+  res->final_correction = si5351bx_get_correction();
+  res->end_s = t / 1e9;
+  res->cpu_end_s = host_time_us() / 1e6;
+  memcpy(sh->eeprom, g_hal_mock.eeprom, sizeof(sh->eeprom));
+  noinit_copy(true);
+}
+
+// Run one boot of the firmware, in a child process. The return value is its exit status.
+static int sim_boot() {
+  bool first_boot = (res->boots == 0);
+  int status = SIM_EXIT_DONE;
+
+  res->boots++;
+  trace = NULL;
+  if (cfg->trace_path[0] != '\0') {
+    trace = fopen(cfg->trace_path, first_boot ? "w" : "a");
+    if (trace == NULL) perror(cfg->trace_path);
+  }
+  vcd_begin(first_boot);
+
+  // The processor, just out of reset
+  hal_mock_reset();
+  host_set_time_us(0);
+  g_hal_mock.reset_flags = sh->reset_flags;
+  g_hal_mock.adc_internal_temp = SIM_TEMP_ADC;
+  g_hal_mock.i2c_hook = sim_i2c_write;
+  g_hal_mock.wait_hook = sim_wait;
+  host_analog_values[Vpwerbus - A0] = (int)(SIM_VCC_V / (0.00322 * VpwerDivider));
+  host_serial_hook = sim_serial_write;
+  host_advance_hook = sim_advance;
+  state_seen = 0xFF;
+
+  if (first_boot) {
+    memset(sh->eeprom, 0xFF, sizeof(sh->eeprom));
+    if (cfg->callsign[0] != '\0') {
+      memcpy(g_hal_mock.eeprom, sh->eeprom, sizeof(sh->eeprom));
+      params_set_defaults();
+      snprintf(g_params.callsign, sizeof(g_params.callsign), "%.*s", (int)sizeof(g_params.callsign) - 1, cfg->callsign);
+      params_save();
+      memcpy(sh->eeprom, g_hal_mock.eeprom, sizeof(sh->eeprom));
+    }
+  }
+  else
+    noinit_copy(false);
+  memcpy(g_hal_mock.eeprom, sh->eeprom, sizeof(sh->eeprom));
+
+  // The board
+  si5351_power_on();
+  cal_hz = 0;
+  cal_cycles = 0;
+  cal_ns = sh->boot_ns;
+  gps_sec = (cfg->start_utc_ms * 1000000LL + sh->boot_ns + 999999999LL) / 1000000000LL;
+  gps_sec_at = host_at(utc_ns(gps_sec));
+  run_end_at = host_at((long long)(cfg->run_s * 1e9));
+  reset_at = ~0ULL;
+  for (uint8_t i = 0; i < cfg->num_faults; i++) {
+    long long start = (long long)(cfg->faults[i].start_s * 1e9);
+    if ((cfg->faults[i].fault_class == SIM_VOLTAGE_SAG) && (start > sh->boot_ns) && (host_at(start) < reset_at)) {
+      reset_at = host_at(start);
+      reset_length_s = cfg->faults[i].length_s;
+    }
+  }
+  monitor_next = 0;
+  while ((monitor_next < cfg->num_monitor) && (cfg->monitor[monitor_next].t_s * 1e9 < sh->boot_ns)) monitor_next++;
+
+  trace_line("boot reset 0x%02x", sh->reset_flags);
+  try {
+    setup();
+    for (;;) {
+      unsigned long long now;
+      unsigned long long next;
+      uint8_t event;
+
+      loop();
+      sim_sync();
+
+      // The next pass of loop() that could do something different
+      now = host_time_us();
+      next = next_event(&event);
+      if (host_next_second_us() < next) next = host_next_second_us();
+      if (now + SIM_LOOP_STEP_US < next) next = now + SIM_LOOP_STEP_US;
+      if ((now < gps_rx_end) && (now + SIM_LOOP_RX_STEP_US < next)) next = now + SIM_LOOP_RX_STEP_US;
+      host_advance_us((next > now) ? next - now : 1);
+    }
+  }
+  catch (SimStop &) {
+  }
+  catch (SimReset &) {
+    long long t = now_ns();
+
+    status = SIM_EXIT_RESET;
+    boot_end();
+    trace_line("reset brown-out for %.3f s", reset_length_s);
+    sh->boot_ns = t + (long long)(reset_length_s * 1e9);
+    sh->reset_flags = HAL_RESET_BROWN_OUT;
+  }
+
+  if (status == SIM_EXIT_DONE) boot_end();
+  if (trace != NULL) fclose(trace);
+  if (vcd != NULL) fclose(vcd);
+  return status;
+}
+
+// ---- The simulation ----
+
+void sim_config_defaults(struct SimConfig *c) {
+  memset(c, 0, sizeof(*c));
+  c->run_s = 900;
+  c->start_utc_ms = 1559347250000LL;     // 2019-06-01 00:00:50 UTC
+  c->fix_s = 20;
+  c->nmea_ms = 60;
+  c->cpu_ppb = 20000;                    // A 20 ppm processor crystal
+  c->xtal_ppb = SI5351A_CLK_FREQ_CORRECTION + 1200;
+  c->lat = 45.4215;
+  c->lon = -75.6972;
+  c->alt_m = 12000;
+}
+
+static const char *const fault_names[SIM_NUM_FAULT_CLASSES] = {"pps-missing", "pps-double", "nmea-corrupt",
+                                                               "nmea-delay", "voltage-sag"
+                                                              };
+
+const char *sim_fault_name(uint8_t fault_class) {
+  return (fault_class < SIM_NUM_FAULT_CLASSES) ? fault_names[fault_class] : "?";
+}
+
+bool sim_parse_fault(const char *spec, struct SimFault *fault) {
+  const char *at = strchr(spec, '@');
+  char *end;
+
+  if (at == NULL) return false;
+  memset(fault, 0, sizeof(*fault));
+  fault->fault_class = SIM_NUM_FAULT_CLASSES;
+  for (uint8_t i = 0; i < SIM_NUM_FAULT_CLASSES; i++)
+    if ((strlen(fault_names[i]) == (size_t)(at - spec)) && (strncmp(spec, fault_names[i], at - spec) == 0))
+      fault->fault_class = i;
+  if (fault->fault_class == SIM_NUM_FAULT_CLASSES) return false;
+
+  fault->start_s = strtod(at + 1, &end);
+  if ((end == at + 1) || (*end != '+')) return false;
+  fault->length_s = strtod(end + 1, &end);
+  if (*end == '=') fault->value = strtod(end + 1, &end);
+  return (*end == '\0') && (fault->length_s > 0);
+}
+
+static const char *const state_names[] = {"POWERUP", "WAIT_OP_VOLTAGE", "CALIBRATE", "WAIT_TELEMETRY", "TELEMETRY",
+                                          "WAIT_TX_PRIMARY_WSPR", "TX_PRIMARY_WSPR", "WAIT_TX_SECONDARY_WSPR",
+                                          "TX_SECONDARY_WSPR", "SHUTDOWN", "QRSS_TX", "QRSS_HOLDOFF"
+                                         };
+static_assert(sizeof(state_names) / sizeof(state_names[0]) == QRSS_HOLDOFF_ST + 1, "state_names must match OrionState");
+
+const char *sim_state_name(uint8_t state) {
+  return (state <= QRSS_HOLDOFF_ST) ? state_names[state] : "?";
+}
+
+bool sim_run(const struct SimConfig *config, struct SimResults *results) {
+  bool ok = true;
+
+  sh = (struct SimShared *)mmap(NULL, sizeof(*sh), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (sh == MAP_FAILED) {
+    perror("mmap");
+    return false;
+  }
+  memset(sh, 0, sizeof(*sh));
+  sh->cfg = *config;
+  sh->reset_flags = HAL_RESET_POWER_ON;
+  cfg = &sh->cfg;
+  res = &sh->res;
+
+  for (;;) {
+    int status;
+    pid_t pid;
+
+    fflush(NULL);
+    pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      ok = false;
+      break;
+    }
+    if (pid == 0) {
+      status = sim_boot();
+      fflush(NULL);
+      _exit(status);
+    }
+
+    if ((waitpid(pid, &status, 0) != pid) || !WIFEXITED(status)) {
+      fprintf(stderr, "sim_run: the firmware crashed at %.6f s\n", res->end_s);
+      ok = false;
+      break;
+    }
+    if (WEXITSTATUS(status) == SIM_EXIT_RESET) continue;
+    ok = (WEXITSTATUS(status) == SIM_EXIT_DONE);
+    break;
+  }
+
+  memcpy(results, res, sizeof(*results));
+  munmap(sh, sizeof(*sh));
+  sh = NULL;
+  return ok;
+}
@@ -0,0 +1,125 @@
+#ifndef SIM_BOARD_H
+#define SIM_BOARD_H
+/*
+    sim_board.h - Host simulator of an Orion WSPR Beacon board
+
+   Runs the sketch (sim_firmware.cpp) on the mock HAL against a simulated board : the GPS (1PPS and NMEA on the GPS
+   serial port), the Si5351a (an output frequency model fed by the I2C writes), the calibration clock on Timer1,
+   the WSPR symbol clock on Timer2 and the QRSS keyer on Timer1, with faults injected at chosen times. See
+   sim_board.cpp for how the simulation works and orion_host_sim.cpp for the command line front end.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdint.h>
+
+#define SIM_MAX_FAULTS      8
+#define SIM_MAX_MONITOR     8
+#define SIM_MAX_TX          20000     // More than 60 days of transmissions
+#define SIM_MAX_STATES      4096      // State changes kept, the rest are only counted
+#define SIM_PATH_LEN        256
+
+// The fault classes. Each fault lasts from start_s to start_s + length_s of simulated time.
+enum SimFaultClass {
+  SIM_PPS_MISSING,       // No 1PPS pulses, the NMEA sentences still arrive
+  SIM_PPS_DOUBLE,        // A second 10 ms pulse value ms after each 1PPS pulse (default 300)
+  SIM_NMEA_CORRUPT,      // One character of every NMEA sentence is changed, so the checksums fail
+  SIM_NMEA_DELAY,        // The NMEA sentences arrive value ms later than usual (default 800)
+  SIM_VOLTAGE_SAG,       // The supply drops below the brown-out level, the board is held in reset for length_s
+  SIM_NUM_FAULT_CLASSES
+};
+
+struct SimFault {
+  uint8_t fault_class;   // SimFaultClass
+  double start_s;        // Seconds of simulated time from power up
+  double length_s;
+  double value;          // Depends on the class, 0 for the default
+};
+
+// A monitor command, typed at t_s seconds
+struct SimMonitorInput {
+  double t_s;
+  char text[40];
+};
+
+struct SimConfig {
+  double run_s;                  // Simulated time to run for
+  long long start_utc_ms;        // UTC at power up, in milliseconds since 1970
+  double fix_s;                  // Time to first fix, the GPS has no 1PPS or position before it
+  double nmea_ms;                // Start of the NMEA sentences of a second, after its 1PPS pulse
+  int32_t cpu_ppb;               // Error of the processor clock (millis(), micros() and Timer2)
+  int32_t xtal_ppb;              // Error of the Si5351a crystal, the correction factor that would be exact
+  double lat, lon, alt_m;        // Position reported by the GPS
+  char callsign[12];             // Saved as the callsign parameter before the first boot, "" for the default
+  struct SimFault faults[SIM_MAX_FAULTS];
+  uint8_t num_faults;
+  struct SimMonitorInput monitor[SIM_MAX_MONITOR];
+  uint8_t num_monitor;
+  char trace_path[SIM_PATH_LEN]; // Text trace (I2C writes, monitor output and state changes), "" for none
+  char vcd_path[SIM_PATH_LEN];   // VCD trace of the pins and interrupts, "" for none
+};
+
+// A WSPR transmission, from the TX clock being turned on to it being turned off
+struct SimTx {
+  double on_s;                   // Simulated time
+  double off_s;
+  double on_utc_s;               // UTC of on_s, seconds since 1970
+  double tone0_hz;               // The lowest output frequency seen, the frequency of tone 0
+  double target_hz;              // The frequency the firmware was aiming for (g_beacon_freq_hz)
+  uint16_t tone_changes;
+  uint8_t state;                 // TX_PRIMARY_WSPR_ST or TX_SECONDARY_WSPR_ST
+};
+
+struct SimStateChange {
+  double t_s;
+  uint8_t state;                 // OrionState
+  bool gps_los;                  // The GPS LOS timer was running
+};
+
+struct SimResults {
+  uint32_t boots;
+  uint32_t num_tx;               // Transmissions in tx[], any more are only counted in tx_dropped
+  uint32_t tx_dropped;
+  struct SimTx tx[SIM_MAX_TX];
+  uint32_t qrss_keydowns;        // TX clock turned on during QRSS_TX_ST
+  uint32_t num_states;
+  uint32_t states_dropped;
+  struct SimStateChange states[SIM_MAX_STATES];
+  uint32_t pps_pulses;
+  uint32_t nmea_sentences;       // Sent by the GPS
+  uint32_t serial_overruns;      // GPS characters lost to a full receive buffer
+  uint32_t gps_errors;           // NMEA errors counted by the firmware (g_perf.gps_errors), over all the boots
+  uint32_t timer1_overflows;     // Timer1 overflow interrupts counted by the firmware (g_isr_counts), over all the boots
+  double cpu_end_s;              // The processor clock (host_time_us()) at the end of the run, millis() wraps at 2^32 ms
+  uint8_t final_state;           // OrionState at the end of the run
+  bool final_gps_los;            // The GPS LOS timer was running at the end of the run
+  int32_t final_correction;      // Si5351a correction factor at the end of the run
+  double end_s;
+};
+
+void sim_config_defaults(struct SimConfig *cfg);
+
+// Parse a fault "class@start+length[=value]", e.g. "pps-missing@700+2400", times in seconds
+bool sim_parse_fault(const char *spec, struct SimFault *fault);
+
+// Run the simulation, false if it couldn't be run. Each boot of the firmware runs in a child process, so that a
+// simulated reset starts it again with fresh static data (except for the EEPROM and .noinit) and so that
+// sim_run() can be called more than once.
+bool sim_run(const struct SimConfig *cfg, struct SimResults *res);
+
+const char *sim_state_name(uint8_t state);
+const char *sim_fault_name(uint8_t fault_class);
+
+#endif
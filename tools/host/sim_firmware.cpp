@@ -0,0 +1,22 @@
+/*
+   sim_firmware.cpp - The Orion WSPR Beacon sketch, compiled for the host board simulator (see sim_board.cpp)
+
+   The sketch itself, unchanged. Its setup() and loop() are run by sim_board.cpp on the mock HAL and the host
+   Arduino shims in tools/host, the Orion modules come from the orion_host library.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionWspr.ino"
@@ -0,0 +1,146 @@
+/*
+   test_fw_faults.cpp - Fault recovery tests of the sketch on the host board simulator (see CMakeLists.txt)
+
+   One test per fault class, named on the command line (pps-missing, pps-double, nmea-corrupt, nmea-delay or
+   voltage-sag). Each injects its fault once the beacon is on its schedule and checks :
+
+     - the recovery time, from the end of the fault to the start of the first good WSPR transmission. A good
+       transmission starts in its slot (at most SLOT_LATE_MAX_S after second 1 of an even minute), on the right
+       frequency (tone 0 within TONE_ERR_MAX_HZ of the frequency the firmware aimed for) and isn't cut short.
+     - the final state, at the end of the run : the state machine state, the GPS LOS timer stopped and the
+       correction factor within CORRECTION_ERR_MAX_PPB of the Si5351a crystal error
+     - that the fault took the path it was meant to take : a state it must have gone through, the number of boots
+       and the number of bad transmissions from the start of the fault
+
+   The run ends at hh:m8:50 UTC, between the calibration of a cycle and the telemetry of the next one, so the final
+   state is WAIT_TELEMETRY_ST unless the beacon hasn't recovered.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "OrionXConfig.h"
+#include "OrionStateMachine.h"
+#include "sim_board.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+#define SLOT_LATE_MAX_S         1.0
+#define TONE_ERR_MAX_HZ         0.5
+#define TX_MIN_S                110.0     // 162 symbols of 8192 / 12000 s
+#define CORRECTION_ERR_MAX_PPB  30
+#define NO_STATE                0xFF
+
+struct FaultTest {
+  const char *name;
+  const char *fault;
+  double run_s;                  // Ends at hh:m8:50 UTC, see sim_config_defaults() for the start
+  double max_recovery_s;
+  uint8_t must_visit;            // A state the fault must lead to, or NO_STATE
+  uint32_t boots;
+  uint32_t bad_tx;               // Transmissions from the start of the fault that aren't good
+};
+
+static const struct FaultTest tests[] = {
+  // No PPS during a calibration. The calibration fails and the beacon carries on with the last correction factor,
+  // in GPS LOS. After GPS_LOS_GUARD_TMO_MS it falls back to the QRSS beacon, which sends its whole message before
+  // looking for the PPS again, then calibrates and waits for the next cycle.
+  {"pps-missing", "pps-missing@800+3600", 7080, 2400, QRSS_TX_ST, 1, 0},
+
+  // A second pulse 300 ms after each PPS pulse during a calibration. The gates are half as long as they should be,
+  // so they are ignored (CALIBRATION_MAX_GATE_ERROR_PPM) and the correction factor doesn't move.
+  {"pps-double", "pps-double@790+120", 1680, 300, NO_STATE, 1, 0},
+
+  // Corrupted NMEA sentences over the start of a cycle. The clock isn't reset from the stale fix (GPS_FIX_MAX_AGE_MS)
+  // and the cycle goes ahead on the processor clock.
+  {"nmea-corrupt", "nmea-corrupt@450+200", 1680, 60, NO_STATE, 1, 0},
+
+  // Late NMEA sentences over the start of a cycle. The clock is reset from the fix of the previous second, so the
+  // transmissions of that cycle are a second late, until the next cycle resets the clock.
+  {"nmea-delay", "nmea-delay@450+200", 1680, 600, NO_STATE, 1, 2},
+
+  // A brown-out reset during the Primary transmission, which is cut short and counts as bad. The beacon resumes from
+  // its checkpoint without calibrating and is back on the next cycle.
+  {"voltage-sag", "voltage-sag@600+5", 1680, 600, NO_STATE, 2, 1},
+};
+
+static struct SimConfig cfg;
+static struct SimResults res;    // Too big for the stack
+
+// A whole transmission that starts in its slot on the right frequency
+static bool tx_good(const struct SimTx *tx) {
+  double late = fmod(tx->on_utc_s, 120.0) - 1.0;
+
+  return (late >= 0) && (late <= SLOT_LATE_MAX_S) && (fabs(tx->tone0_hz - tx->target_hz) <= TONE_ERR_MAX_HZ) &&
+         (tx->off_s - tx->on_s >= TX_MIN_S);
+}
+
+static void run_test(const struct FaultTest *t) {
+  struct SimFault fault;
+  double fault_end_s;
+  double recovery_s = -1;
+  bool visited = (t->must_visit == NO_STATE);
+  uint32_t bad_tx = 0;
+
+  sim_config_defaults(&cfg);
+  cfg.run_s = t->run_s;
+  CHECK(sim_parse_fault(t->fault, &fault));
+  cfg.faults[cfg.num_faults++] = fault;
+  fault_end_s = fault.start_s + fault.length_s;
+
+  CHECK(sim_run(&cfg, &res));
+
+  for (uint32_t i = 0; i < res.num_tx; i++) {
+    if ((res.tx[i].on_s >= fault_end_s) && tx_good(&res.tx[i]) && (recovery_s < 0))
+      recovery_s = res.tx[i].on_s - fault_end_s;
+    if ((res.tx[i].off_s >= fault.start_s) && !tx_good(&res.tx[i])) bad_tx++;
+  }
+  for (uint32_t i = 0; i < res.num_states; i++)
+    if ((res.states[i].state == t->must_visit) && (res.states[i].t_s >= fault.start_s)) visited = true;
+
+  printf("%s : %u boots, %u transmissions (%u bad), recovered after %.1f s (limit %.0f), end in %s, correction %d "
+         "(crystal %d)\n", t->fault, res.boots, res.num_tx, bad_tx, recovery_s, t->max_recovery_s,
+         sim_state_name(res.final_state), res.final_correction, cfg.xtal_ppb);
+
+  CHECK(recovery_s >= 0);
+  CHECK(recovery_s <= t->max_recovery_s);
+  CHECK(res.final_state == WAIT_TELEMETRY_ST);
+  CHECK(!res.final_gps_los);
+  CHECK(abs(res.final_correction - cfg.xtal_ppb) <= CORRECTION_ERR_MAX_PPB);
+  CHECK(visited);
+  CHECK(res.boots == t->boots);
+  CHECK(bad_tx == t->bad_tx);
+}
+
+int main(int argc, char **argv) {
+  const struct FaultTest *test = NULL;
+
+  for (unsigned i = 0; (argc == 2) && (i < sizeof(tests) / sizeof(tests[0])); i++)
+    if (strcmp(argv[1], tests[i].name) == 0) test = &tests[i];
+  if (test == NULL) {
+    printf("usage: test_fw_faults pps-missing|pps-double|nmea-corrupt|nmea-delay|voltage-sag\n");
+    return 2;
+  }
+
+  run_test(test);
+
+  printf("%s, %d failed checks\n", failures ? "FAIL" : "PASS", failures);
+  return failures;
+}
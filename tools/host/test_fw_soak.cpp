@@ -0,0 +1,140 @@
+/*
+   test_fw_soak.cpp - Long run of the sketch on the host board simulator (see CMakeLists.txt)
+
+   Runs the beacon for SOAK_DAYS days of simulated time, with the TX frequency monitor on, and checks that it never
+   misses a slot and doesn't drift. The run crosses the rollovers that a bench test of a few hours never sees :
+
+     - millis(), 32 bits, after 49.7 days. The Time library, the Chronos and the scheduler all work from it.
+     - micros(), every 71.6 minutes
+     - Timer1 : TCNT1 every 65536 counts, and the count the TX monitor keeps across its gates, overflowCounter as
+       16 bits with TCNT1 below it, which wraps at 2^32 counts (about 22 minutes of the CAL clock)
+
+   The checks :
+     - every Primary and Secondary slot from the first cycle after the startup calibration to the end of the run has
+       one good transmission (see tx_good() in test_fw_faults.cpp), in order, with no reset
+     - no drift : the mean start of the transmissions in their slots and the mean error of tone 0 over the last day
+       are within DRIFT_MAX_S and DRIFT_MAX_HZ of the first day, and the correction factor still matches the crystal
+
+   The run ends at hh:m8:50 UTC, like the fault tests, so the final state is WAIT_TELEMETRY_ST.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "OrionXConfig.h"
+#include "OrionStateMachine.h"
+#include "sim_board.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+#define SOAK_DAYS               61
+#define SOAK_RUN_S              (SOAK_DAYS * 86400.0 + 480)   // Ends at hh:m8:50 UTC, see sim_config_defaults()
+#define SLOT_LATE_MAX_S         1.0
+#define TONE_ERR_MAX_HZ         0.5
+#define TX_MIN_S                110.0     // 162 symbols of 8192 / 12000 s
+#define CYCLE_S                 600.0     // A Primary and a Secondary transmission every ten minutes
+#define TX_PER_DAY              (2 * 86400 / 600)
+#define DRIFT_MAX_S             0.05      // A transmission starts on the first pass of loop() after its second
+#define DRIFT_MAX_HZ            0.05
+#define CORRECTION_ERR_MAX_PPB  30
+
+static struct SimConfig cfg;
+static struct SimResults res;    // Too big for the stack
+
+static double tx_late(const struct SimTx *tx) {
+  return fmod(tx->on_utc_s, 120.0) - 1.0;
+}
+
+static bool tx_good(const struct SimTx *tx) {
+  double late = tx_late(tx);
+
+  return (late >= 0) && (late <= SLOT_LATE_MAX_S) && (fabs(tx->tone0_hz - tx->target_hz) <= TONE_ERR_MAX_HZ) &&
+         (tx->off_s - tx->on_s >= TX_MIN_S);
+}
+
+// Mean start in the slot and mean tone 0 error of count transmissions from first
+static void tx_means(uint32_t first, uint32_t count, double *late, double *err_hz) {
+  *late = 0;
+  *err_hz = 0;
+  for (uint32_t i = first; i < first + count; i++) {
+    *late += tx_late(&res.tx[i]) / count;
+    *err_hz += (res.tx[i].tone0_hz - res.tx[i].target_hz) / count;
+  }
+}
+
+int main() {
+  double first_slot_utc;
+  double expected_utc;
+  uint32_t expected_tx;
+  uint32_t missed = 0;
+  double first_late, first_err_hz, last_late, last_err_hz;
+
+  sim_config_defaults(&cfg);
+  cfg.run_s = SOAK_RUN_S;
+  snprintf(cfg.monitor[0].text, sizeof(cfg.monitor[0].text), "set txmon 1");
+  cfg.monitor[0].t_s = 1;
+  cfg.num_monitor = 1;
+
+  CHECK(sim_run(&cfg, &res));
+
+  // From the first cycle after the startup calibration to the last one with both its transmissions over by m4:00
+  first_slot_utc = (floor((cfg.start_utc_ms / 1e3) / CYCLE_S) + 1) * CYCLE_S;
+  expected_tx = 2 * ((uint32_t)floor((cfg.start_utc_ms / 1e3 + cfg.run_s - first_slot_utc - 240) / CYCLE_S) + 1);
+
+  for (uint32_t i = 0; i < res.num_tx; i++) {
+    const struct SimTx *tx = &res.tx[i];
+
+    expected_utc = first_slot_utc + (i / 2) * CYCLE_S + (i % 2) * 120.0 + 1.0;
+    if (!tx_good(tx) || (floor(tx->on_utc_s) != expected_utc) ||
+        (tx->state != ((i % 2) ? TX_SECONDARY_WSPR_ST : TX_PRIMARY_WSPR_ST))) {
+      if (missed++ < 10)
+        printf("transmission %u at %.3f s is bad : %s %.3f s late for %.3f s, tone 0 %+.3f Hz\n", i, tx->on_s,
+               sim_state_name(tx->state), tx->on_utc_s - expected_utc, tx->off_s - tx->on_s,
+               tx->tone0_hz - tx->target_hz);
+    }
+  }
+
+  tx_means(0, TX_PER_DAY, &first_late, &first_err_hz);
+  tx_means(res.num_tx - TX_PER_DAY, TX_PER_DAY, &last_late, &last_err_hz);
+
+  printf("%.1f days (processor clock %.1f days), %u boots, %u transmissions (%u expected, %u bad), "
+         "%u Timer1 overflows\n", res.end_s / 86400, res.cpu_end_s / 86400, res.boots, res.num_tx, expected_tx, missed,
+         res.timer1_overflows);
+  printf("first day %.4f s late, tone 0 %+.4f Hz, last day %.4f s late, tone 0 %+.4f Hz\n", first_late,
+         first_err_hz, last_late, last_err_hz);
+  printf("end in %s, correction %d (crystal %d)\n", sim_state_name(res.final_state), res.final_correction,
+         cfg.xtal_ppb);
+
+  // The run crossed the rollovers it is meant to
+  CHECK(res.cpu_end_s * 1000 > 4294967296.0);
+  CHECK(res.timer1_overflows > 2 * 65536);
+
+  CHECK(res.boots == 1);
+  CHECK(res.tx_dropped == 0);
+  CHECK(res.num_tx == expected_tx);
+  CHECK(missed == 0);
+  CHECK(fabs(last_late - first_late) <= DRIFT_MAX_S);
+  CHECK(fabs(last_err_hz - first_err_hz) <= DRIFT_MAX_HZ);
+  CHECK(res.final_state == WAIT_TELEMETRY_ST);
+  CHECK(!res.final_gps_los);
+  CHECK(abs(res.final_correction - cfg.xtal_ppb) <= CORRECTION_ERR_MAX_PPB);
+
+  printf("%s, %d failed checks\n", failures ? "FAIL" : "PASS", failures);
+  return failures;
+}
@@ -0,0 +1,194 @@
+/*
+   test_hal_mock.cpp - Host tests of the Orion modules on the mock HAL (see CMakeLists.txt)
+
+   Each test starts from hal_mock_reset() (power up, erased EEPROM) and checks what the module asked of the hardware
+   through g_hal_mock, or what it did with the values injected there. Exits with the number of failed checks.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+#include "OrionBoardConfig.h"
+#include "OrionHal.h"
+#include "OrionParameters.h"
+#include "OrionCheckpoint.h"
+#include "OrionSi5351.h"
+#include "OrionPerfCounters.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+// ---- EEPROM parameters ----
+
+static void test_params_eeprom() {
+  int call = params_find("call");
+  int drive = params_find("drive");
+  unsigned long writes;
+
+  hal_mock_reset();
+  CHECK(!params_begin());                        // Erased EEPROM, defaults
+  CHECK(strcmp(g_params.callsign, BEACON_CALLSIGN_6CHAR) == 0);
+
+  CHECK(call >= 0);
+  CHECK(drive >= 0);
+  CHECK(params_set_value(call, "g/ve3wmb"));
+  CHECK(params_set_value(drive, "1"));
+  params_save();
+  CHECK(g_hal_mock.eeprom_writes > 0);
+
+  // Saving the same values again doesn't wear the EEPROM
+  writes = g_hal_mock.eeprom_writes;
+  params_save();
+  CHECK(g_hal_mock.eeprom_writes == writes);
+
+  params_set_defaults();
+  CHECK(params_begin());
+  CHECK(strcmp(g_params.callsign, "G/VE3WMB") == 0);
+  CHECK(g_params.tx_drive == 1);
+  CHECK(si5351bx_drive[SI5351A_WSPRTX_CLK_NUM] == 1);
+
+  // A corrupted byte fails the CRC and we go back to the defaults
+  g_hal_mock.eeprom[EEPROM_PARAMS_ADDR + 2] ^= 0x01;
+  CHECK(!params_begin());
+  CHECK(strcmp(g_params.callsign, BEACON_CALLSIGN_6CHAR) == 0);
+}
+
+static void test_params_callsign() {
+  int call = params_find("call");
+  const char *good[] = {"VE3WMB", "K1A", "VE3WMB/P", "VE3WMB/7", "VE3WMB/12", "G/VE3WMB", "VP2/VE3WMB", "VE3/VE3WMB"};
+  const char *bad[] = {"", "VE3WMBX", "/VE3WMB", "VE3WMB/", "G/VE3WMB/P", "VE3WMB//P", "ABCD/VE3WMB", "VE3WMB/AB",
+                       "VE3/VE3WMBX", "VE3WMB-1", "VE3 WMB"};
+
+  hal_mock_reset();
+  params_set_defaults();
+
+  for (unsigned i = 0; i < sizeof(good) / sizeof(good[0]); i++) {
+    if (!params_set_value(call, good[i])) printf("  rejected %s\n", good[i]);
+    CHECK(params_set_value(call, good[i]));
+  }
+
+  for (unsigned i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    if (params_set_value(call, bad[i])) printf("  accepted %s\n", bad[i]);
+    CHECK(!params_set_value(call, bad[i]));
+  }
+
+  CHECK(strcmp(g_params.callsign, "VE3/VE3WMB") == 0);   // The last good one
+}
+
+// ---- Reset checkpoint ----
+
+static void test_checkpoint() {
+  struct OrionCheckpoint cp;
+  struct OrionCheckpoint loaded;
+
+  hal_mock_reset();
+  memset(&cp, 0, sizeof(cp));
+  cp.time_s = 1560000000UL;
+  cp.correction = -1234;
+  cp.resumes = 1;
+  checkpoint_save(&cp);
+
+  g_hal_mock.reset_flags = HAL_RESET_WATCHDOG;
+  CHECK(checkpoint_load(&loaded));
+  CHECK(loaded.time_s == cp.time_s);
+  CHECK(loaded.correction == cp.correction);
+
+  g_hal_mock.reset_flags = HAL_RESET_BROWN_OUT | HAL_RESET_EXTERNAL;
+  CHECK(checkpoint_load(&loaded));
+
+  // SRAM doesn't survive a power on
+  g_hal_mock.reset_flags = HAL_RESET_POWER_ON | HAL_RESET_BROWN_OUT;
+  CHECK(!checkpoint_load(&loaded));
+
+  // Nor can we trust it when the bootloader didn't tell us why we were reset
+  g_hal_mock.reset_flags = 0;
+  CHECK(!checkpoint_load(&loaded));
+
+  checkpoint_clear();
+  g_hal_mock.reset_flags = HAL_RESET_WATCHDOG;
+  CHECK(!checkpoint_load(&loaded));
+}
+
+// ---- Si5351a over the mock I2C ----
+
+static uint8_t i2c_last_reg;
+static uint8_t i2c_last_vals[8];
+static uint8_t i2c_last_count;
+
+static void i2c_capture(uint8_t addr, uint8_t reg, const uint8_t *vals, uint8_t count) {
+  (void)addr;
+  if (count == 8) {
+    i2c_last_reg = reg;
+    memcpy(i2c_last_vals, vals, count);
+    i2c_last_count = count;
+  }
+}
+
+static void test_si5351() {
+  uint8_t vals[8];
+
+  hal_mock_reset();
+  memset(&g_perf, 0, sizeof(g_perf));
+  g_hal_mock.i2c_hook = i2c_capture;
+  i2c_last_count = 0;
+
+  si5351bx_init();
+  CHECK(g_hal_mock.i2c_transactions > 0);
+  CHECK(g_perf.i2c_transactions == g_hal_mock.i2c_transactions);
+
+  // The multisynth registers written for a frequency are the ones si5351bx_calc_msynth() calculates
+  si5351bx_setfreq(SI5351A_WSPRTX_CLK_NUM, 1409710000ULL, SI5351_CLK_OFF);
+  si5351bx_calc_msynth(1409710000ULL, vals);
+  CHECK(i2c_last_count == 8);
+  CHECK(i2c_last_reg == 42 + (8 * SI5351A_WSPRTX_CLK_NUM));
+  CHECK(memcmp(i2c_last_vals, vals, 8) == 0);
+
+  // A tone change is diffed against the registers last written, so the same image writes nothing
+  g_hal_mock.i2c_transactions = 0;
+  si5351bx_update_msynth(SI5351A_WSPRTX_CLK_NUM, vals);
+  CHECK(g_hal_mock.i2c_transactions == 0);
+  si5351bx_calc_msynth(1409710000ULL + 146, vals);
+  si5351bx_update_msynth(SI5351A_WSPRTX_CLK_NUM, vals);
+  CHECK(g_hal_mock.i2c_transactions == 1);
+  si5351bx_calc_msynth(1409710000ULL, vals);
+  si5351bx_update_msynth(SI5351A_WSPRTX_CLK_NUM, vals);
+  CHECK(g_hal_mock.i2c_transactions == 2);
+
+  // Only CLK1 and CLK2 can be driven from the CLK0 multisynth
+  g_hal_mock.i2c_transactions = 0;
+  si5351bx_clk_from_ms0(0, 3, SI5351_CLK_ON);
+  si5351bx_clk_from_ms0(3, 3, SI5351_CLK_ON);
+  CHECK(g_hal_mock.i2c_transactions == 0);
+  si5351bx_clk_from_ms0(1, 3, SI5351_CLK_ON);
+  CHECK(g_hal_mock.i2c_transactions == 3);
+
+  // A NACK is retried SI5351_I2C_RETRIES times and then counted as a failure
+  g_hal_mock.i2c_status = 2;
+  g_hal_mock.i2c_transactions = 0;
+  si5351bx_enable_clk(SI5351A_WSPRTX_CLK_NUM, SI5351_CLK_OFF);
+  CHECK(g_hal_mock.i2c_transactions == SI5351_I2C_RETRIES + 1);
+  CHECK(g_perf.i2c_failures == 1);
+}
+
+int main() {
+  test_params_eeprom();
+  test_params_callsign();
+  test_checkpoint();
+  test_si5351();
+
+  printf("%s, %d failed checks\n", failures ? "FAIL" : "PASS", failures);
+  return failures;
+}
@@ -0,0 +1,253 @@
+/*
+   test_qrss_trace.cpp - Host test of the QRSS keyer timing against the keyer it replaced (see CMakeLists.txt)
+
+   The CW modes (QRSS, FSKCW and DFCW) used to decode the message at run time with charCode() and key the Si5351a from
+   a segment generator in the Timer1 ISR. They now walk a Morse element stream, encoded at compile time for QRSS_MESSAGE
+   and by qrss_encode_stream() for messages composed from telemetry. This test keeps a copy of the old keyer as the
+   reference and checks that the new one produces the same output trace.
+
+   The new keyer is run on the mock HAL by calling ISR(TIMER1_COMPB_vect) once per Timer1 period and qrss_service()
+   after each one, as loop() would. The trace is what the Si5351a is actually told to do, rebuilt from the I2C writes :
+   the TX clock off, or on with the multisynth of tone 0 (QRSS frequency) or tone 1 (QRSS frequency + FSK offset).
+   Each change is timestamped in Timer1 ticks and both traces must match change for change and tick for tick.
+
+   Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "OrionXConfig.h"
+#include "OrionBoardConfig.h"
+#include "OrionHal.h"
+#include "OrionParameters.h"
+#include "OrionSi5351.h"
+#include "OrionQrss.h"
+#include "OrionTxMode.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+void TIMER1_COMPB_vect();          // ISR(TIMER1_COMPB_vect) in OrionQrss.cpp, an ordinary function in the host build
+
+static const unsigned int ref_speeds[] = {1, 30, 60, 100};   // speeds[] in OrionQrss.cpp, tenths of a second
+
+#define TRACE_MAX    512
+#define TONE_OFF     0xFF
+#define TONE_UNKNOWN 0xFE
+
+// An output trace, the state of the TX clock from each change until the next one, and when the message ended
+struct Trace {
+  uint8_t tone[TRACE_MAX];         // TONE_OFF, 0 or 1
+  unsigned long start[TRACE_MAX];  // Timer1 ticks from the start of the message
+  unsigned count;
+  unsigned long end;
+};
+
+static void trace_add(struct Trace *t, uint8_t tone, unsigned long tick) {
+  if ((t->count > 0) && (t->tone[t->count - 1] == tone)) return;
+  if (t->count == TRACE_MAX) return;
+  t->tone[t->count] = tone;
+  t->start[t->count] = tick;
+  t->count++;
+}
+
+// Timer1 ticks per keyer unit, as qrss_start() worked it out before and after the change
+static unsigned long unit_ticks(QrssMode mode, QrssSpeed speed, unsigned long *period) {
+  unsigned long unit_ms = ref_speeds[speed] * ((mode == MODE_DFCW) ? 33UL : 100UL);
+  unsigned long ticks = (unit_ms * (F_CPU / 1000UL)) / 1024UL;
+  unsigned long postscale = (ticks >> 16) + 1;
+
+  *period = ticks / postscale;
+  return *period * postscale;
+}
+
+// ---- The old keyer, from before the compile time encoding ----
+
+static uint8_t ref_char_code(char c) {
+  switch (c) {
+    case 'A': return B11111001;  case 'B': return B11101000;  case 'C': return B11101010;  case 'D': return B11110100;
+    case 'E': return B11111100;  case 'F': return B11100010;  case 'G': return B11110110;  case 'H': return B11100000;
+    case 'I': return B11111000;  case 'J': return B11100111;  case 'K': return B11110101;  case 'L': return B11100100;
+    case 'M': return B11111011;  case 'N': return B11111010;  case 'O': return B11110111;  case 'P': return B11100110;
+    case 'Q': return B11101101;  case 'R': return B11110010;  case 'S': return B11110000;  case 'T': return B11111101;
+    case 'U': return B11110001;  case 'V': return B11100001;  case 'W': return B11110011;  case 'X': return B11101001;
+    case 'Y': return B11101011;  case 'Z': return B11101100;
+    case '0': return B11011111;  case '1': return B11001111;  case '2': return B11000111;  case '3': return B11000011;
+    case '4': return B11000001;  case '5': return B11000000;  case '6': return B11010000;  case '7': return B11011000;
+    case '8': return B11011100;  case '9': return B11011110;
+    case ' ': return B11101111;  case '/': return B11010010;
+    default: return ref_char_code(' ');
+  }
+}
+
+// The old qrss_timing[] and qrss_apply_key(), indexed by QrssMode
+static const uint8_t ref_timing[][5] = {{1, 3, 1, 3, 4}, {1, 3, 1, 3, 4}, {1, 3, 1, 3, 4}, {3, 3, 1, 4, 4}};
+
+static uint8_t ref_output(QrssMode mode, bool key_down, bool dah) {
+  if (mode == MODE_FSKCW) return key_down ? 1 : 0;
+  if (mode == MODE_QRSS) return key_down ? 0 : TONE_OFF;
+  return key_down ? (dah ? 1 : 0) : TONE_OFF;
+}
+
+// The old qrss_next_segment(), run to the end of msg
+static void ref_trace(QrssMode mode, QrssSpeed speed, const char *msg, struct Trace *t) {
+  const uint8_t *timing = ref_timing[mode];
+  unsigned long period;
+  unsigned long unit = unit_ticks(mode, speed, &period);
+  unsigned long tick = 0;
+  uint8_t index = 0;
+  uint8_t character = 0;
+  uint8_t char_bit = 0;
+  bool in_gap = false;
+  uint8_t units;
+
+  memset(t, 0, sizeof(*t));
+
+  for (;;) {
+    if (in_gap) {
+      in_gap = false;
+      trace_add(t, ref_output(mode, false, false), tick);
+      units = (char_bit == 0) ? timing[3] : timing[2];
+    }
+    else {
+      if (char_bit == 0) {
+        if (!msg[index]) break;
+        character = ref_char_code(msg[index++]);
+        if (character == ref_char_code(' ')) {
+          trace_add(t, ref_output(mode, false, false), tick);
+          tick += timing[4] * unit;
+          continue;
+        }
+        char_bit = 7;
+        while (character & (1 << char_bit)) char_bit--;
+      }
+      char_bit--;
+      in_gap = true;
+      if (character & (1 << char_bit)) {
+        trace_add(t, ref_output(mode, true, true), tick);
+        units = timing[1];
+      }
+      else {
+        trace_add(t, ref_output(mode, true, false), tick);
+        units = timing[0];
+      }
+    }
+    tick += units * unit;
+  }
+
+  t->end = tick;
+}
+
+// ---- The new keyer on the mock HAL ----
+
+static uint8_t si5351_regs[256];
+
+static void i2c_shadow(uint8_t addr, uint8_t reg, const uint8_t *vals, uint8_t count) {
+  (void)addr;
+  memcpy(&si5351_regs[reg], vals, count);
+}
+
+static uint8_t si5351_tx_tone(const uint8_t tones[2][8]) {
+  const uint8_t *ms = &si5351_regs[42 + (8 * SI5351A_WSPRTX_CLK_NUM)];
+
+  if (si5351_regs[3] & (1 << SI5351A_WSPRTX_CLK_NUM)) return TONE_OFF;
+  if (memcmp(ms, tones[0], 8) == 0) return 0;
+  if (memcmp(ms, tones[1], 8) == 0) return 1;
+  return TONE_UNKNOWN;
+}
+
+static void keyer_trace(QrssMode mode, QrssSpeed speed, const char *message, struct Trace *t) {
+  uint8_t work_buf[WSPR2_SYMBOL_COUNT];   // The keyer gets g_tx_buffer in OrionWspr.ino
+  uint8_t tones[2][8];
+  unsigned long period;
+  unsigned long tick = 0;
+  unsigned long limit;
+
+  memset(t, 0, sizeof(*t));
+  hal_mock_reset();
+  params_set_defaults();
+  memset(si5351_regs, 0, sizeof(si5351_regs));
+  g_hal_mock.i2c_hook = i2c_shadow;
+  si5351bx_init();
+
+  si5351bx_calc_msynth(g_params.qrss_freq_hz * 100ULL, tones[0]);
+  si5351bx_calc_msynth((g_params.qrss_freq_hz + FSK_HIGH - FSK_LOW) * 100ULL, tones[1]);
+
+  unit_ticks(mode, speed, &period);
+  limit = 100000UL * period;   // A runaway keyer
+
+  qrss_start(mode, speed, message, work_buf, sizeof(work_buf));
+  CHECK(g_hal_mock.timer1_mode == HAL_T1_CTC);
+  CHECK(g_hal_mock.timer1_top + 1UL == period);
+
+  qrss_service();
+  trace_add(t, si5351_tx_tone(tones), tick);
+
+  while (tick < limit) {
+    TIMER1_COMPB_vect();
+    tick += g_hal_mock.timer1_top + 1UL;
+    if (qrss_service()) break;
+    trace_add(t, si5351_tx_tone(tones), tick);
+  }
+
+  t->end = tick;
+  CHECK(!qrss_is_active());
+  CHECK(g_hal_mock.timer1_mode == HAL_T1_OFF);
+  CHECK(si5351_tx_tone(tones) == TONE_OFF);
+  g_hal_mock.i2c_hook = NULL;
+}
+
+static void compare(QrssMode mode, QrssSpeed speed, const char *text, const char *message) {
+  static struct Trace want;
+  static struct Trace got;
+  unsigned i;
+
+  ref_trace(mode, speed, text, &want);
+  keyer_trace(mode, speed, message, &got);
+
+  CHECK(got.count == want.count);
+  CHECK(got.end == want.end);
+  for (i = 0; (i < got.count) && (i < want.count); i++) {
+    if ((got.tone[i] != want.tone[i]) || (got.start[i] != want.start[i])) {
+      printf("  mode %d speed %d \"%s\" change %u : tone %d at %lu ticks, expected tone %d at %lu ticks\n", mode, speed,
+             text, i, got.tone[i], got.start[i], want.tone[i], want.start[i]);
+      failures++;
+      break;
+    }
+  }
+}
+
+int main() {
+  const QrssMode modes[] = {MODE_QRSS, MODE_FSKCW, MODE_DFCW};
+  const QrssSpeed speeds_tested[] = {QRSS3, QRSS10};   // QRSS10 needs the Timer1 postscaler
+  const char *messages[] = {" K1ABC/9 0Z ", "VE3WMB FN25 12.3 45", "QRSS"};
+  unsigned long period;
+
+  // The QRSS10 figures in the comment in qrss_start()
+  if (F_CPU == 8000000UL) {
+    CHECK((unit_ticks(MODE_QRSS, QRSS10, &period) == 78124UL) && (period == 39062UL));
+  }
+
+  for (unsigned m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+    for (unsigned s = 0; s < sizeof(speeds_tested) / sizeof(speeds_tested[0]); s++) {
+      // QRSS_MESSAGE from the compile time stream, and messages encoded at run time
+      compare(modes[m], speeds_tested[s], QRSS_MESSAGE, NULL);
+      for (unsigned i = 0; i < sizeof(messages) / sizeof(messages[0]); i++)
+        compare(modes[m], speeds_tested[s], messages[i], messages[i]);
+    }
+  }
+
+  printf("%s, %d failed checks\n", failures ? "FAIL" : "PASS", failures);
+  return failures;
+}
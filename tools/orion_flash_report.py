@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""
+orion_flash_report.py - Flash size per function report for the Orion WSPR Beacon
+
+This is the flash part of the Orion microbenchmarks. The cycles per call and stack usage of the hot functions
+are measured on the target with the 'bench' serial monitor command (see OrionBenchmark.cpp), their flash size
+comes from the symbol table of the firmware ELF file.
+
+Usage:
+  1) Turn on verbose compile output in the Arduino IDE to find the build directory containing OrionWspr.ino.elf
+
+  2) Report the flash used by the benchmarked functions and the largest functions overall :
+        python3 orion_flash_report.py --elf OrionWspr.ino.elf
+
+  3) Save the sizes as the baseline, and later check a new build against it :
+        python3 orion_flash_report.py --elf OrionWspr.ino.elf --save-baseline flash_baseline.json
+        python3 orion_flash_report.py --elf OrionWspr.ino.elf --baseline flash_baseline.json
+
+     With --baseline the exit status is 1 if any function (or the total) grew by more than --threshold percent.
+
+avr-nm must be in the PATH (it is in the hardware/tools/avr/bin directory of the Arduino IDE), or use --nm.
+
+Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+"""
+import argparse
+import json
+import subprocess
+import sys
+
+# The functions timed by the 'bench' serial monitor command
+BENCH_FUNCTIONS = [
+    'si5351bx_calc_msynth', 'si5351bx_setfreq', 'wspr_encode', 'calculate_gridsquare_6char',
+    'encode_temperature', 'encode_voltage', 'encode_altitude', 'encode_gridloc_char5_char6',
+    'read_voltage_v_x10', 'NMEAGPS::decode',
+]
+
+TOTAL = '(total .text)'
+
+
+def base_name(name):
+    """Reduce a (demangled) function signature to its qualified name, without return type or arguments"""
+    name = name.split('(')[0].strip()
+    return name.split(' ')[-1]
+
+
+def read_symbols(nm, elf):
+    """Return a dict of function name to size in bytes for the code (text) symbols in elf"""
+    out = subprocess.run([nm, '--print-size', '--size-sort', '-C', elf],
+                         check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+    sizes = {}
+    for line in out.splitlines():
+        fields = line.split(None, 3)
+        if len(fields) < 4 or fields[2] not in ('T', 't', 'W', 'w'):
+            continue
+        name = base_name(fields[3])
+        sizes[name] = sizes.get(name, 0) + int(fields[1], 16)
+    sizes[TOTAL] = sum(sizes.values())
+    return sizes
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Flash size per function report for Orion')
+    parser.add_argument('--elf', required=True, help='Firmware ELF file')
+    parser.add_argument('--nm', default='avr-nm', help='avr-nm executable')
+    parser.add_argument('--top', type=int, default=15, help='Number of largest functions to list')
+    parser.add_argument('--save-baseline', metavar='FILE', help='Save the sizes to FILE')
+    parser.add_argument('--baseline', metavar='FILE', help='Compare the sizes with FILE')
+    parser.add_argument('--threshold', type=float, default=5.0, help='Allowed growth in percent (default 5)')
+    args = parser.parse_args()
+
+    sizes = read_symbols(args.nm, args.elf)
+    baseline = {}
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+    failed = False
+
+    def report(name):
+        nonlocal failed
+        size = sizes.get(name)
+        if size is None:
+            print('%-34s      -  (not found, inlined or not linked)' % name)
+            return
+        line = '%-34s %6d bytes' % (name, size)
+        if name in baseline:
+            old = baseline[name]
+            line += '  baseline %6d' % old
+            if old and size > old * (1.0 + args.threshold / 100.0):
+                line += '  FAIL'
+                failed = True
+        print(line)
+
+    print('Benchmarked functions')
+    print('-' * 80)
+    for name in BENCH_FUNCTIONS + [TOTAL]:
+        report(name)
+
+    print()
+    print('Largest functions')
+    print('-' * 80)
+    largest = sorted((n for n in sizes if n != TOTAL), key=lambda n: sizes[n], reverse=True)
+    for name in largest[:args.top]:
+        print('%-34s %6d bytes' % (name, sizes[name]))
+
+    if args.save_baseline:
+        with open(args.save_baseline, 'w') as f:
+            json.dump(sizes, f, indent=1, sort_keys=True)
+        print()
+        print('Baseline saved to', args.save_baseline)
+
+    if args.baseline:
+        print()
+        print('Threshold %.1f%% : %s' % (args.threshold, 'FAIL' if failed else 'PASS'))
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
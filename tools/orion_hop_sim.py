@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""
+orion_hop_sim.py - QRM Avoidance hopping plan of the Orion WSPR Beacon, reproduction and collision simulation
+
+With QRM Avoidance on, Orion picks the frequency of each transmission from a hash of its callsign and the 2 minute
+slot of the transmission (see get_tx_frequency() in OrionWspr.ino). This tool runs the same calculation on the ground,
+so that spots can be correlated with the frequency the beacon used, and simulates the probability that a transmission
+collides with one of the other beacons sharing the window, for the hopping plan and for the random offset used before.
+
+Usage:
+  1) Frequencies used by a beacon, one line per 2 minute slot :
+        python3 orion_hop_sim.py plan --call VE3WMB --start 2019-06-01T12:00 --slots 10
+
+  2) Collision probability against the number of co-channel beacons :
+        python3 orion_hop_sim.py collide --beacons 1 2 5 10 20 --trials 20000
+
+     A transmission collides when another beacon transmits in the same slot less than --separation Hz away.
+
+The defaults match OrionXConfig.h (BEACON_FREQ_HZ, QRM_HOP_SPAN_HZ, QRM_HOP_CHANNEL_HZ, QRM_HOP_CAL_UNCERTAINTY_PPB).
+
+Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+"""
+import argparse
+import calendar
+import random
+import string
+import sys
+import time
+
+SLOT_S = 120
+
+
+def fnv1a(h, data):
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def hop_offset(call, slot, args):
+    """Offset in Hz above the base frequency, as calculated by get_tx_frequency()"""
+    h = fnv1a(2166136261, call.encode('ascii'))
+    h = fnv1a(h, [(slot >> (8 * i)) & 0xFF for i in range(4)])
+    margin = (args.base * args.cal_ppb + 999999999) // 1000000000
+    channels = (args.span - 2 * margin) // args.channel + 1
+    return margin + (h % channels) * args.channel
+
+
+def plan(args):
+    start = calendar.timegm(time.strptime(args.start, '%Y-%m-%dT%H:%M'))
+    slot = start // SLOT_S
+    print('UTC               slot        frequency (Hz)')
+    print('-' * 50)
+    for s in range(slot, slot + args.slots):
+        utc = time.strftime('%Y-%m-%d %H:%M', time.gmtime(s * SLOT_S))
+        print('%s  %10d  %d' % (utc, s, args.base + hop_offset(args.call, s, args)))
+    return 0
+
+
+def random_call(rng):
+    # Callsign shaped strings (e.g. VE3WMB), only their hash matters
+    letters = string.ascii_uppercase
+    return (rng.choice(letters) + rng.choice(letters + string.digits) + rng.choice(string.digits) +
+            ''.join(rng.choice(letters) for _ in range(rng.randint(1, 3))))
+
+
+def collide(args):
+    rng = random.Random(args.seed)
+    print('Beacons   hopping plan   random 0 to %d Hz' % args.span)
+    print('-' * 50)
+    for n in args.beacons:
+        hop_hits = 0
+        rand_hits = 0
+        for _ in range(args.trials):
+            calls = [random_call(rng) for _ in range(n)]
+            slot = rng.randrange(1 << 24)
+            hop = [hop_offset(c, slot, args) for c in calls]
+            rand = [rng.randint(0, args.span) for _ in calls]
+            # Beacon 0 is the one we are watching
+            hop_hits += any(abs(hop[0] - f) < args.separation for f in hop[1:])
+            rand_hits += any(abs(rand[0] - f) < args.separation for f in rand[1:])
+        print('%7d   %11.2f%%   %16.2f%%' % (n, 100.0 * hop_hits / args.trials, 100.0 * rand_hits / args.trials))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Orion QRM Avoidance hopping plan')
+    parser.add_argument('--base', type=int, default=14097010, help='Base frequency in Hz (freq parameter)')
+    parser.add_argument('--span', type=int, default=180, help='QRM_HOP_SPAN_HZ')
+    parser.add_argument('--channel', type=int, default=6, help='QRM_HOP_CHANNEL_HZ')
+    parser.add_argument('--cal-ppb', type=int, default=100, help='QRM_HOP_CAL_UNCERTAINTY_PPB')
+    sub = parser.add_subparsers(dest='command')
+
+    p = sub.add_parser('plan', help='List the frequencies used by a beacon')
+    p.add_argument('--call', required=True, help='Beacon callsign (call parameter)')
+    p.add_argument('--start', required=True, help='First slot, UTC, as YYYY-MM-DDTHH:MM')
+    p.add_argument('--slots', type=int, default=30, help='Number of 2 minute slots')
+
+    c = sub.add_parser('collide', help='Simulate the collision probability')
+    c.add_argument('--beacons', type=int, nargs='+', default=[2, 3, 5, 10, 20], help='Numbers of co-channel beacons')
+    c.add_argument('--trials', type=int, default=10000, help='Slots simulated for each number of beacons')
+    c.add_argument('--separation', type=float, default=6.0, help='Separation in Hz below which two signals collide')
+    c.add_argument('--seed', type=int, default=1, help='Seed of the simulation')
+
+    args = parser.parse_args()
+    if args.command == 'plan':
+        return plan(args)
+    if args.command == 'collide':
+        return collide(args)
+    parser.print_help()
+    return 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,285 @@
+#!/usr/bin/env python3
+"""
+orion_osc_sim.py - Holdover simulation of the Orion oscillator model (OrionOscModel.cpp)
+
+Runs the fixed point Kalman filter of OrionOscModel.cpp, step for step in the same integer arithmetic, against a
+simulated crystal with a linear temperature coefficient and a constant drift rate, on the beacon schedule :
+
+  - every 10 minute cycle the telemetry reads the temperature (whole degrees C, like g_tx_data.temperature_c),
+  - the Primary and Telemetry transmissions at minutes 0 and 2 use the predicted correction (osc_model_correction()),
+  - outside of a GPS LOS a calibration follows with 24 gates of 10 seconds, each one a measurement of the correction
+    with the count quantization of do_calibration(), unless osc_model_skip_calibration() skips it.
+
+After --train-h hours with the GPS the simulation goes into a GPS LOS of --holdover-h hours, with no calibrations, and
+compares the correction predicted for every transmission with the true one. It passes if the worst prediction error in
+the LOS stays within --limit-ppb (QRM_HOP_CAL_UNCERTAINTY_PPB by default, the margin QRM Avoidance keeps at the ends of
+its span) and within 3 sigma of the model's own osc_model_sigma_ppb(). The exit status is 0 on a pass and 1 on a fail.
+
+Usage:
+  python3 orion_osc_sim.py                                  # 40 ppb/C, 6 ppb/h, 5 hour LOS
+  python3 orion_osc_sim.py --tempco 25 --drift 2 --holdover-h 12 -v
+
+The OSC_MODEL_* constants are read from OrionXConfig.h so the simulation follows the firmware configuration.
+
+Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+"""
+import argparse
+import math
+import os
+import random
+import re
+import sys
+
+OSC_X_SHIFT = 8
+OSC_P_SHIFT = 4
+OSC_K_SHIFT = 16
+INT32_MAX = 0x7FFFFFFF
+
+CAL_TARGET_FREQ = 320000000     # SI5351_CAL_TARGET_FREQ, hundredths of hertz
+CAL_GATES = 24                  # Gates of 10 seconds in do_calibration()
+
+CONFIG = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'OrionXConfig.h')
+
+
+def read_config(path):
+    cfg = {}
+    with open(path) as f:
+        for line in f:
+            m = re.match(r'#define\s+((?:OSC_MODEL|QRM_HOP)_\w+)\s+(-?\d+)', line)
+            if m:
+                cfg[m.group(1)] = int(m.group(2))
+    return cfg
+
+
+def cdiv(a, b):
+    """C integer division, which truncates towards zero"""
+    q = abs(a) // abs(b)
+    return q if (a < 0) == (b < 0) else -q
+
+
+def sat32(v):
+    return max(-INT32_MAX, min(INT32_MAX, v))
+
+
+def isqrt32(v):
+    root = 0
+    bit = 1 << 30
+    while bit > v:
+        bit >>= 2
+    while bit != 0:
+        if v >= root + bit:
+            v -= root + bit
+            root = (root >> 1) + bit
+        else:
+            root >>= 1
+        bit >>= 2
+    return root
+
+
+class OscModel:
+    """OrionOscModel.cpp, one method per function"""
+
+    def __init__(self, cfg):
+        self.cfg = cfg
+        self.x = [0, 0, 0]
+        self.p = [[0] * 3 for _ in range(3)]
+        self.time_min = 0
+        self.time_valid = False
+        self.temp_offset_c = 0
+        self.skipped_cals = 0
+
+    def reset(self, corr):
+        c = self.cfg
+        self.p = [[0] * 3 for _ in range(3)]
+        self.x = [corr * (1 << OSC_X_SHIFT), 0, 0]
+        self.p[0][0] = (c['OSC_MODEL_CORR_SIGMA_PPB'] ** 2) << OSC_P_SHIFT
+        self.p[1][1] = (c['OSC_MODEL_RATE_SIGMA_PPB_H'] ** 2) << OSC_P_SHIFT
+        self.p[2][2] = (c['OSC_MODEL_TEMPCO_SIGMA_PPB_C'] ** 2) << OSC_P_SHIFT
+        self.time_valid = False
+        self.skipped_cals = 0
+
+    def time_update(self, time_s, temperature_c):
+        c = self.cfg
+        p = self.p
+        time_min = time_s // 60
+        temperature_c = max(-100, min(100, temperature_c))
+        self.temp_offset_c = temperature_c - c['OSC_MODEL_REF_TEMP_C']
+
+        if not self.time_valid or time_min < self.time_min:
+            self.time_min = time_min
+            self.time_valid = True
+            return
+
+        dt = min(time_min - self.time_min, c['OSC_MODEL_MAX_STEP_MIN'])
+        self.time_min = time_min
+        if dt == 0:
+            return
+
+        self.x[0] = sat32(self.x[0] + cdiv(self.x[1] * dt, 60))
+        p[0][0] = sat32(p[0][0] + cdiv(2 * dt * p[0][1], 60) + cdiv(dt * dt * p[1][1], 3600) +
+                        cdiv((dt * c['OSC_MODEL_CORR_WALK_PPB2_H']) << OSC_P_SHIFT, 60))
+        p[0][1] = sat32(p[0][1] + cdiv(dt * p[1][1], 60))
+        p[0][2] = sat32(p[0][2] + cdiv(dt * p[1][2], 60))
+        p[1][1] = sat32(p[1][1] + cdiv((dt * c['OSC_MODEL_RATE_WALK']) << OSC_P_SHIFT, 60))
+        p[2][2] = sat32(p[2][2] + cdiv((dt * c['OSC_MODEL_TEMPCO_WALK']) << OSC_P_SHIFT, 60))
+        p[1][0] = p[0][1]
+        p[2][0] = p[0][2]
+
+    def measure(self, corr, variance):
+        d = self.temp_offset_c
+        p = self.p
+        x = self.x
+        ph = [p[i][0] + d * p[i][2] for i in range(3)]
+        s = ph[0] + d * ph[2] + (variance << OSC_P_SHIFT)
+        y = (corr << OSC_X_SHIFT) - x[0] - d * x[2]
+
+        k = [0, 0, 0]
+        for i in range(3):
+            k[i] = cdiv(ph[i] << OSC_K_SHIFT, s)
+            x[i] = sat32(x[i] + ((k[i] * y) >> OSC_K_SHIFT))
+
+        for i in range(3):
+            for j in range(i, 3):
+                p[i][j] = sat32(p[i][j] - ((k[i] * ph[j]) >> OSC_K_SHIFT))
+                p[j][i] = p[i][j]
+            if p[i][i] < 1:
+                p[i][i] = 1
+
+    def correction(self):
+        return (self.x[0] + self.temp_offset_c * self.x[2] + (1 << (OSC_X_SHIFT - 1))) >> OSC_X_SHIFT
+
+    def sigma_ppb(self):
+        d = self.temp_offset_c
+        p = self.p
+        var = (p[0][0] + 2 * d * p[0][2] + d * d * p[2][2]) >> OSC_P_SHIFT
+        if var < 0:
+            var = 0
+        if var > 0xFFFE0001:
+            return 0xFFFF
+        return isqrt32(var)
+
+    def skip_calibration(self):
+        c = self.cfg
+        if self.skipped_cals >= c['OSC_MODEL_MAX_SKIPPED_CALS'] or self.sigma_ppb() > c['OSC_MODEL_SKIP_CAL_PPB']:
+            self.skipped_cals = 0
+            return False
+        self.skipped_cals += 1
+        return True
+
+
+class Crystal:
+    """The simulated Si5351a reference, the correction factor it needs at a time and temperature"""
+
+    def __init__(self, args):
+        self.args = args
+
+    def temperature(self, t_s):
+        a = self.args
+        return a.temp_mid + a.temp_amp * math.sin(2 * math.pi * t_s / (a.temp_period_h * 3600.0))
+
+    def corr(self, t_s):
+        a = self.args
+        return a.corr0 + a.drift * t_s / 3600.0 + a.tempco * (self.temperature(t_s) - a.ref_temp)
+
+
+def gate_measurement(used_corr, true_corr, rng):
+    """One do_calibration() gate : the CAL clock counted for 10 seconds while used_corr was in use"""
+    freq_hz = CAL_TARGET_FREQ / 100.0 * (1.0 + (true_corr - used_corr) / 1e9)
+    counts = int(math.floor(freq_hz * 10.0 + rng.random()))   # Tenths of a hertz, the PPS phase is random
+    measured = counts * 10
+    return used_corr + cdiv((measured - CAL_TARGET_FREQ) * 1000000000, CAL_TARGET_FREQ)
+
+
+def simulate(args, cfg):
+    rng = random.Random(args.seed)
+    xtal = Crystal(args)
+    model = OscModel(cfg)
+    gate_res_ppb = 10000000000 // CAL_TARGET_FREQ
+    los_start_s = int(args.train_h * 3600)
+    end_s = los_start_s + int(args.holdover_h * 3600)
+    worst = (0, 0, 0)        # error, sigma, time
+    worst_sigma_ratio = 0.0
+    last_cal = 0
+    worst_no_model = 0
+    cals = 0
+    skipped = 0
+
+    model.reset(0)
+    used = 0
+    for cycle_s in range(0, end_s, 600):
+        in_los = cycle_s >= los_start_s
+        temp_c = int(round(xtal.temperature(cycle_s)))
+
+        # Primary and Telemetry transmissions with the predicted correction
+        for tx_s in (cycle_s, cycle_s + 120):
+            model.time_update(tx_s, temp_c)
+            used = model.correction()
+            if in_los:
+                err = used - xtal.corr(tx_s)
+                sigma = model.sigma_ppb()
+                if abs(err) > abs(worst[0]):
+                    worst = (err, sigma, tx_s)
+                worst_sigma_ratio = max(worst_sigma_ratio, abs(err) / max(sigma, 1))
+                worst_no_model = max(worst_no_model, abs(last_cal - xtal.corr(tx_s)))
+            if args.verbose:
+                print('%7.2f h  %4d C  %s  true %8.1f  predicted %6d  sigma %5d' %
+                      (tx_s / 3600.0, temp_c, 'LOS' if in_los else 'GPS', xtal.corr(tx_s), used, model.sigma_ppb()))
+
+        if in_los:
+            continue
+
+        # Calibration after the Telemetry transmission
+        cal_s = cycle_s + 240
+        model.time_update(cal_s, temp_c)
+        if model.skip_calibration():
+            skipped += 1
+            continue
+        cals += 1
+        for g in range(CAL_GATES):
+            gate_s = cal_s + 10 * g
+            model.measure(gate_measurement(used, xtal.corr(gate_s), rng), gate_res_ppb * gate_res_ppb)
+        last_cal = model.correction()
+
+    return worst, worst_sigma_ratio, worst_no_model, cals, skipped, model
+
+
+def main():
+    cfg = read_config(CONFIG)
+    parser = argparse.ArgumentParser(description='Orion oscillator model holdover simulation')
+    parser.add_argument('--tempco', type=float, default=40.0, help='Crystal temperature coefficient, ppb per degree C')
+    parser.add_argument('--drift', type=float, default=6.0, help='Crystal drift rate, ppb per hour')
+    parser.add_argument('--corr0', type=float, default=1500.0, help='Correction factor at the start, in ppb')
+    parser.add_argument('--temp-mid', type=float, default=5.0, help='Middle of the daily temperature swing, degrees C')
+    parser.add_argument('--temp-amp', type=float, default=20.0, help='Amplitude of the daily temperature swing, degrees C')
+    parser.add_argument('--temp-period-h', type=float, default=24.0, help='Period of the temperature swing, hours')
+    parser.add_argument('--train-h', type=float, default=24.0, help='Hours of calibrations before the GPS LOS')
+    parser.add_argument('--holdover-h', type=float, default=5.0, help='Hours of GPS LOS')
+    parser.add_argument('--limit-ppb', type=int, default=cfg['QRM_HOP_CAL_UNCERTAINTY_PPB'],
+                        help='Largest prediction error allowed in the LOS (QRM_HOP_CAL_UNCERTAINTY_PPB)')
+    parser.add_argument('--seed', type=int, default=1, help='Seed of the gate quantization')
+    parser.add_argument('-v', '--verbose', action='store_true', help='Print every transmission')
+    args = parser.parse_args()
+    args.ref_temp = cfg['OSC_MODEL_REF_TEMP_C']
+
+    worst, ratio, no_model, cals, skipped, model = simulate(args, cfg)
+    err, sigma, t_s = worst
+    print('Crystal : %.1f ppb/C, %.1f ppb/h, %.1f h LOS after %.1f h of calibrations (%d run, %d skipped)' %
+          (args.tempco, args.drift, args.holdover_h, args.train_h, cals, skipped))
+    print('Model   : tempco %.1f ppb/C, rate %.2f ppb/h' %
+          (model.x[2] / 256.0, model.x[1] / 256.0))
+    print('LOS     : worst prediction error %.1f ppb at %.2f h (sigma %d), worst error / sigma %.2f' %
+          (err, t_s / 3600.0, sigma, ratio))
+    print('          the last calibrated value alone would be off by up to %.1f ppb' % no_model)
+
+    ok = abs(err) <= args.limit_ppb and ratio <= 3.0
+    print('%s : limit %d ppb and 3 sigma' % ('PASS' if ok else 'FAIL', args.limit_ppb))
+    return 0 if ok else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
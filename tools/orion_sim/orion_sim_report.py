@@ -0,0 +1,231 @@
+#!/usr/bin/env python3
+"""
+orion_sim_report.py - Timing report from a VCD trace of the Orion WSPR Beacon
+
+Measures, from the trace written by the host board simulator (orion_host_sim -o, see tools/host/sim_board.cpp) :
+  - WSPR symbol / QRSS element period and jitter, from the probe_symbol pin (or the QRSS Timer1 compare interrupts)
+  - calibration counting gate length, from the probe_cal pin, which should be exactly 10 PPS seconds
+  - PPS interrupt latency (PPS edge to the interrupt handler starting) and the run time of each traced interrupt
+  - software I2C bit rate from the SCL line, if the trace has one, and the time taken by each I2C write, from the
+    probe_i2c pin
+
+Usage:
+    python3 orion_sim_report.py orion.vcd
+    python3 orion_sim_report.py orion.vcd --symbol-period 0.682667 --symbol-tol-ppm 200 --max-pps-latency-us 40
+
+The exit status is 1 if any measurement is outside its limit, so the report can be used as a regression test (see
+the sim_timing_report test in CMakeLists.txt). The simulator doesn't model the run time of the code, so its interrupts
+are zero width pulses and the PPS latency is zero, and it has no SCL line.
+
+Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+"""
+import argparse
+import bisect
+import sys
+
+TIMESCALE_UNITS = {'s': 1.0, 'ms': 1e-3, 'us': 1e-6, 'ns': 1e-9, 'ps': 1e-12, 'fs': 1e-15}
+
+WSPR_SYMBOL_PERIOD = 8192.0 / 12000.0      # Seconds
+
+
+def read_vcd(path):
+    """Return a dict of signal name to a list of (time in seconds, integer value) changes"""
+    ids = {}
+    changes = {}
+    scale = 1e-9
+    now = 0.0
+    with open(path) as f:
+        tokens = f.read().split()
+
+    i = 0
+    while i < len(tokens):
+        tok = tokens[i]
+        if tok == '$timescale':
+            spec = ''
+            i += 1
+            while tokens[i] != '$end':
+                spec += tokens[i]
+                i += 1
+            digits = ''.join(c for c in spec if c.isdigit())
+            unit = spec[len(digits):]
+            scale = int(digits or 1) * TIMESCALE_UNITS[unit]
+        elif tok == '$var':
+            # $var wire <size> <id> <name> $end
+            ident, name = tokens[i + 3], tokens[i + 4]
+            ids.setdefault(ident, []).append(name)
+            changes[name] = []
+            while tokens[i] != '$end':
+                i += 1
+        elif tok.startswith('$'):
+            if tok not in ('$dumpvars', '$end'):
+                while tokens[i] != '$end':
+                    i += 1
+        elif tok[0] == '#':
+            now = int(tok[1:]) * scale
+        elif tok[0] in 'bB':
+            value, ident = tok[1:], tokens[i + 1]
+            i += 1
+            for name in ids.get(ident, []):
+                changes[name].append((now, int(value.replace('x', '0').replace('z', '0'), 2)))
+        elif tok[0] in '01xzXZ':
+            value = 1 if tok[0] == '1' else 0
+            for name in ids.get(tok[1:], []):
+                changes[name].append((now, value))
+        i += 1
+    return changes
+
+
+def edges(changes, rising=True, falling=True):
+    """Times of the 0->1 and/or 1->0 transitions in a list of changes"""
+    out = []
+    last = None
+    for t, v in changes:
+        if last is not None and v != last:
+            if (v and rising) or (not v and falling):
+                out.append(t)
+        last = v
+    return out
+
+
+def pulses(changes):
+    """(start, width) of each high pulse"""
+    out = []
+    start = None
+    last = 0
+    for t, v in changes:
+        if v and not last:
+            start = t
+        elif not v and last and start is not None:
+            out.append((start, t - start))
+        last = v
+    return out
+
+
+def stats(values):
+    return min(values), sum(values) / len(values), max(values)
+
+
+class Report:
+    def __init__(self):
+        self.failed = False
+
+    def line(self, text, ok=True):
+        if not ok:
+            self.failed = True
+        print(text + ('' if ok else '  FAIL'))
+
+
+def symbol_timing(rep, sig, args):
+    # Each probe edge, or each QRSS keyer interrupt, is one symbol. Gaps longer than two symbols separate transmissions.
+    # The WSPR symbols need the probe, the Timer2 interrupt runs several times per symbol.
+    if sig.get('probe_symbol'):
+        times = edges(sig['probe_symbol'])
+        source = 'probe_symbol'
+    else:
+        times = edges(sig.get('isr_timer1_compb', []), falling=False)
+        source = 'Timer1 compare B interrupts'
+
+    periods = [b - a for a, b in zip(times, times[1:]) if (b - a) < 2 * args.symbol_period]
+    print('Symbol timing (%s)' % source)
+    print('-' * 80)
+    if not periods:
+        print('No symbols in the trace')
+        return
+
+    lo, mean, hi = stats(periods)
+    err_ppm = (mean - args.symbol_period) / args.symbol_period * 1e6
+    rep.line('%d periods  mean %.6f s  min %.6f  max %.6f  jitter %.1f us' % (len(periods), mean, lo, hi, (hi - lo) * 1e6))
+    rep.line('Error against %.6f s : %+.0f ppm (limit %.0f)' % (args.symbol_period, err_ppm, args.symbol_tol_ppm),
+             abs(err_ppm) <= args.symbol_tol_ppm)
+
+
+def calibration_gates(rep, sig, args):
+    print()
+    print('Calibration gates (probe_cal)')
+    print('-' * 80)
+    gates = pulses(sig.get('probe_cal', []))
+    if not gates:
+        print('No calibration gates in the trace')
+        return
+    for start, width in gates:
+        err_us = (width - 10.0) * 1e6
+        rep.line('%12.6f s  gate %.6f s  error %+.1f us' % (start, width, err_us), abs(err_us) <= args.cal_gate_tol_us)
+
+
+def interrupts(rep, sig, args):
+    print()
+    print('Interrupts')
+    print('-' * 80)
+    pps_edges = edges(sig.get('pps', []))
+    isr_starts = edges(sig.get('isr_pps', []), falling=False)
+    latencies = []
+    for t in isr_starts:
+        k = bisect.bisect_right(pps_edges, t) - 1
+        if k >= 0 and t - pps_edges[k] < 1e-3:
+            latencies.append(t - pps_edges[k])
+    if latencies:
+        lo, mean, hi = stats(latencies)
+        rep.line('PPS latency : %d interrupts  min %.1f us  mean %.1f us  max %.1f us (limit %.1f)' %
+                 (len(latencies), lo * 1e6, mean * 1e6, hi * 1e6, args.max_pps_latency_us),
+                 hi * 1e6 <= args.max_pps_latency_us)
+    else:
+        print('PPS latency : no PPS interrupts in the trace')
+
+    for name in ('isr_timer2_compa', 'isr_timer1_compa', 'isr_timer1_compb', 'isr_timer1_ovf', 'isr_pps'):
+        runs = [w for _, w in pulses(sig.get(name, []))]
+        if runs:
+            lo, mean, hi = stats(runs)
+            print('%-17s : %6d runs  mean %.1f us  max %.1f us' % (name, len(runs), mean * 1e6, hi * 1e6))
+
+
+def i2c(rep, sig, args):
+    print()
+    print('I2C')
+    print('-' * 80)
+    scl = edges(sig.get('scl', []), falling=False)
+    periods = [b - a for a, b in zip(scl, scl[1:]) if (b - a) < 1e-3]
+    writes = [w for _, w in pulses(sig.get('probe_i2c', []))]
+    if not periods and not writes:
+        print('No I2C traffic in the trace')
+        return
+    if periods:
+        periods.sort()
+        median = periods[len(periods) // 2]
+        rep.line('SCL : %d clocks  median %.1f kHz  fastest %.1f kHz  slowest %.1f kHz (limit %.1f kHz)' %
+                 (len(scl), 1e-3 / median, 1e-3 / periods[0], 1e-3 / periods[-1], args.i2c_min_khz),
+                 1e-3 / median >= args.i2c_min_khz)
+    if writes:
+        lo, mean, hi = stats(writes)
+        print('Writes : %d  mean %.1f us  max %.1f us' % (len(writes), mean * 1e6, hi * 1e6))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Timing report from an Orion VCD trace')
+    parser.add_argument('vcd', help='VCD trace written by orion_host_sim')
+    parser.add_argument('--symbol-period', type=float, default=WSPR_SYMBOL_PERIOD,
+                        help='Expected symbol period in seconds (default WSPR, %.6f)' % WSPR_SYMBOL_PERIOD)
+    parser.add_argument('--symbol-tol-ppm', type=float, default=1000.0, help='Allowed mean symbol period error (default 1000)')
+    parser.add_argument('--cal-gate-tol-us', type=float, default=100.0, help='Allowed calibration gate error (default 100)')
+    parser.add_argument('--max-pps-latency-us', type=float, default=100.0, help='Allowed PPS interrupt latency (default 100)')
+    parser.add_argument('--i2c-min-khz', type=float, default=20.0, help='Minimum median SCL rate (default 20)')
+    args = parser.parse_args()
+
+    sig = read_vcd(args.vcd)
+    rep = Report()
+    symbol_timing(rep, sig, args)
+    calibration_gates(rep, sig, args)
+    interrupts(rep, sig, args)
+    i2c(rep, sig, args)
+
+    print()
+    print('Result : %s' % ('FAIL' if rep.failed else 'PASS'))
+    return 1 if rep.failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,437 @@
+#!/usr/bin/env python3
+"""
+orion_wspr_demod.py - End to end check that the Si5351a register writes of the Orion WSPR Beacon decode as WSPR
+
+Takes the text trace of the host board simulator (orion_host_sim, see tools/host/sim_board.cpp), which has every
+Si5351a register write with its simulated time, and for a WSPR
+transmission on the TX clock :
+  1) replays the register writes into a model of the Si5351a (PLLA, the multisynth and R divider of the clock and the
+     output enables) to get the output frequency against time
+  2) synthesizes the complex baseband (I/Q) signal at 12000 samples per second, tone 0 at 0 Hz
+  3) demodulates it with a non-coherent 4-FSK demodulator, one DFT bin per tone and symbol, the symbols starting at
+     the first tone change after the clock is turned on and spaced 8192 / 12000 s apart like a WSPR receiver expects
+  4) deinterleaves the soft bits and decodes them with a Fano sequential decoder (K=32, rate 1/2, the same as wsprd)
+  5) unpacks the 50 bit message into callsign, locator and power (Type 1, 2 or 3)
+
+It then measures the decode margin : the lowest SNR (in 2500 Hz, the WSPR convention) at which half of the --trials
+noisy copies of the transmission still decode, for added timing jitter (Gaussian, on every tone change) and tone
+spacing error. The noise is added to the outputs of the tone DFTs, which is the same as adding white noise to the
+I/Q samples because the tone bins are orthogonal, and keeps a sweep fast enough for plain Python.
+
+Usage:
+  1) Simulate a transmission, the Primary message goes out at 00:10:01 after the startup calibration :
+        ./orion_host_sim -s 680 -T 000050 -t orion_tx.log
+
+  2) Decode it and check it against the expected message :
+        python3 orion_wspr_demod.py orion_tx.log --expect "VE3WMB FN25 13"
+
+  3) Decode margin against timing jitter and tone error :
+        python3 orion_wspr_demod.py orion_tx.log --jitter-ms 0 5 20 50 --tone-err-hz 0 0.05 0.1 0.2 --trials 8
+
+  --wav writes the transmission as 12000 samples per second audio at 1500 Hz (with noise at --wav-snr) for a
+  cross check with wsprd.
+
+The exit status is 1 if the transmission doesn't decode or doesn't match --expect.
+
+Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+"""
+import argparse
+import cmath
+import math
+import operator
+import random
+import re
+import struct
+import sys
+import wave
+
+FS = 12000.0
+NSPS = 8192                          # Samples per symbol
+SYMBOL_S = NSPS / FS
+TONE_SPACING = FS / NSPS
+NSYM = 162
+POLY1 = 0xF2D05351
+POLY2 = 0xE4613C47
+MSG_BITS = 81
+TAIL_BITS = 31
+SYNC = [1, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0,
+        1, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 0, 1, 1, 0, 1, 0, 0, 0, 0, 1, 1, 0, 1, 0, 1, 0,
+        1, 0, 1, 0, 0, 1, 0, 0, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0, 1, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1,
+        1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 1,
+        1, 0, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0, 0, 0]
+# Symbol number of each deinterleaved bit
+INTERLEAVE = [j for j in (int('{:08b}'.format(i)[::-1], 2) for i in range(256)) if j < NSYM]
+CHARS = '0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ '
+
+I2C_RE = re.compile(r'^\s*([\d.]+) i2c 0x([0-9A-Fa-f]{2}) reg\s+(\d+) :((?: [0-9A-Fa-f]{2})*)')
+
+
+# ---- Si5351a model ----
+
+def ratio(regs, base):
+    """a + b/c of the PLL or multisynth whose 8 parameter registers start at base"""
+    p3 = (regs[base] << 8) | regs[base + 1] | ((regs[base + 5] >> 4) << 16)
+    p1 = ((regs[base + 2] & 3) << 16) | (regs[base + 3] << 8) | regs[base + 4]
+    p2 = ((regs[base + 5] & 0x0F) << 16) | (regs[base + 6] << 8) | regs[base + 7]
+    return (p1 + 512 + float(p2) / max(p3, 1)) / 128.0
+
+
+def clock_frequency(regs, clk, xtal):
+    if regs[3] & (1 << clk):
+        return None                   # Output disabled
+    base = 42 + 8 * clk
+    if not any(regs[base:base + 8]):
+        return None
+    rdiv = (regs[base + 2] >> 4) & 7
+    return xtal * ratio(regs, 26) / ratio(regs, base) / (1 << rdiv)
+
+
+def read_transmissions(path, clk, xtal, addr):
+    """List of transmissions, each a list of (time, frequency) from the clock being turned on to it being turned off"""
+    regs = [0] * 256
+    regs[3] = 0xFF
+    txs = []
+    current = None
+    with open(path) as f:
+        for line in f:
+            m = I2C_RE.match(line)
+            if not m or int(m.group(2), 16) != addr:
+                continue
+            t = float(m.group(1))
+            reg = int(m.group(3))
+            for i, b in enumerate(m.group(4).split()):
+                regs[(reg + i) & 0xFF] = int(b, 16)
+            freq = clock_frequency(regs, clk, xtal)
+            if freq is None:
+                if current:
+                    current.append((t, None))
+                    txs.append(current)
+                current = None
+            elif current is None:
+                current = [(t, freq)]
+            elif freq != current[-1][1]:
+                current.append((t, freq))
+    return [tx for tx in txs if len(tx) > NSYM // 2]
+
+
+# ---- Signal ----
+
+def impair(tx, jitter_s, tone_err_hz, rng):
+    """Tone changes from symbol 0 on as (time, offset from tone 0 in Hz), with jitter and tone spacing error added"""
+    f0 = tx[0][1]
+    changes = []
+    for t, f in tx[1:]:
+        if f is None:
+            changes.append((t, None))
+            break
+        df = (f - f0) * (1.0 + tone_err_hz / TONE_SPACING)
+        changes.append((t + (rng.gauss(0.0, jitter_s) if jitter_s else 0.0), df))
+    changes.sort(key=lambda c: c[0])
+    return changes
+
+
+def synthesize(changes, t0, nsamples):
+    """Complex baseband samples at FS from t0, tone 0 at 0 Hz"""
+    iq = [0j] * nsamples
+    x = 1 + 0j
+    for i, (t, df) in enumerate(changes):
+        a = max(0, int(round((t - t0) * FS)))
+        b = nsamples if i + 1 == len(changes) else min(nsamples, max(a, int(round((changes[i + 1][0] - t0) * FS))))
+        if df is None:
+            break
+        w = cmath.exp(2j * math.pi * df / FS)
+        for n in range(a, b):
+            iq[n] = x
+            x *= w
+    return iq
+
+
+def tone_bins(iq):
+    """DFT of each symbol at each of the 4 tone frequencies, scaled to 1 for a full symbol of the tone"""
+    refs = [[cmath.exp(-2j * math.pi * k * TONE_SPACING * n / FS) / NSPS for n in range(NSPS)] for k in range(4)]
+    return [[sum(map(operator.mul, iq[s * NSPS:(s + 1) * NSPS], refs[k])) for k in range(4)] for s in range(NSYM)]
+
+
+def add_noise(bins, snr_db, rng):
+    """Add the noise for an SNR in 2500 Hz to the tone bins of a unit amplitude signal"""
+    # White noise of power 1 / SNR in 2500 Hz is FS / 2500 / SNR over the sample rate, and a DFT of NSPS samples
+    # scaled by 1 / NSPS leaves 1 / NSPS of it in each bin.
+    sigma = math.sqrt(FS / 2500.0 / 10 ** (snr_db / 10.0) / NSPS / 2.0)
+    return [[b + complex(rng.gauss(0.0, sigma), rng.gauss(0.0, sigma)) for b in sym] for sym in bins]
+
+
+def soft_bits(bins):
+    """Deinterleaved data bit log likelihood ratios, positive for a 1. The sync bit of each symbol is known."""
+    y = [abs(bins[s][SYNC[s] + 2]) - abs(bins[s][SYNC[s]]) for s in range(NSYM)]
+    a = sum(abs(v) for v in y) / NSYM
+    var = max(sum(v * v for v in y) / NSYM - a * a, 1e-9)
+    return [max(-50.0, min(50.0, 2.0 * a * y[j] / var)) for j in INTERLEAVE]
+
+
+# ---- Fano decoder ----
+
+def parity(x):
+    return bin(x).count('1') & 1
+
+
+def fano(llr, delta=60, max_cycles_per_bit=1000, scale=10.0, bias=0.45):
+    """Fano sequential decoder after Phil Karn's fano.c, as used by wsprd. Returns the message bits or None."""
+    def metric(l, bit):
+        # Fano bit metric log2(P(y|bit) / P(y)) - bias, P(y) being the average over both bits
+        return scale * (1.0 - math.log2(1.0 + math.exp(-l if bit else l)) - bias)
+
+    # Branch metrics of the 4 possible symbol pairs of each message bit, indexed by (POLY1 bit << 1) | POLY2 bit
+    metrics = []
+    for i in range(MSG_BITS):
+        m1 = (metric(llr[2 * i], 0), metric(llr[2 * i], 1))
+        m2 = (metric(llr[2 * i + 1], 0), metric(llr[2 * i + 1], 1))
+        metrics.append([m1[s >> 1] + m2[s & 1] for s in range(4)])
+
+    def encode(state):
+        return (parity(state & POLY1) << 1) | parity(state & POLY2)
+
+    def hypotheses(n, state):
+        # Best branch first. Both polynomials have bit 0 set so flipping the bit flips both symbols.
+        lsym = encode(state)
+        m0, m1 = metrics[n][lsym], metrics[n][lsym ^ 3]
+        if n >= MSG_BITS - TAIL_BITS:
+            return state, [m0, -1e9]
+        return (state, [m0, m1]) if m0 >= m1 else (state | 1, [m1, m0])
+
+    state = [0] * (MSG_BITS + 1)
+    gamma = [0.0] * (MSG_BITS + 1)
+    tm = [None] * (MSG_BITS + 1)
+    branch = [0] * (MSG_BITS + 1)
+    n = 0
+    t = 0.0
+    state[0], tm[0] = hypotheses(0, 0)
+
+    for _ in range(max_cycles_per_bit * MSG_BITS):
+        ngamma = gamma[n] + tm[n][branch[n]]
+        if ngamma >= t:
+            if gamma[n] < t + delta:           # First visit to this node, tighten the threshold
+                while ngamma >= t + delta:
+                    t += delta
+            gamma[n + 1] = ngamma
+            n += 1
+            if n == MSG_BITS:
+                return [state[i] & 1 for i in range(MSG_BITS)]
+            state[n], tm[n] = hypotheses(n, (state[n - 1] << 1) & 0xFFFFFFFF)
+            branch[n] = 0
+            continue
+        # Threshold violated, look back
+        while True:
+            if n == 0 or gamma[n - 1] < t:
+                t -= delta
+                if branch[n] != 0:
+                    branch[n] = 0
+                    state[n] ^= 1
+                break
+            n -= 1
+            if n < MSG_BITS - TAIL_BITS and branch[n] != 1:
+                branch[n] = 1
+                state[n] ^= 1
+                break
+    return None
+
+
+# ---- Message unpacking ----
+
+def unpack_call(n):
+    c = [''] * 6
+    for i in (5, 4, 3):
+        c[i] = CHARS[n % 27 + 10]
+        n //= 27
+    c[2] = CHARS[n % 10]
+    n //= 10
+    c[1] = CHARS[n % 36]
+    c[0] = CHARS[n // 36] if n // 36 < len(CHARS) else '?'
+    return ''.join(c)
+
+
+def unpack_affix(v):
+    if v < 60000:
+        p = ''
+        for _ in range(3):
+            p = CHARS[v % 37] + p
+            v //= 37
+        return p.strip() + '/'
+    if v < 60026:
+        return '/' + CHARS[v - 60000]
+    return '/%02d' % (v - 60026)
+
+
+def wspr_hash(call):
+    """15 bit callsign hash of Type 3 messages, lookup3 hashlittle() with seed 146"""
+    mask = 0xFFFFFFFF
+
+    def rot(x, k):
+        return ((x << k) | (x >> (32 - k))) & mask
+
+    key = call.encode('ascii')
+    a = b = c = (0xDEADBEEF + len(key) + 146) & mask
+    while len(key) > 12:
+        a = (a + int.from_bytes(key[0:4], 'little')) & mask
+        b = (b + int.from_bytes(key[4:8], 'little')) & mask
+        c = (c + int.from_bytes(key[8:12], 'little')) & mask
+        for x, y, z, k in ((0, 2, 1, 4), (1, 0, 2, 6), (2, 1, 0, 8), (0, 2, 1, 16), (1, 0, 2, 19), (2, 1, 0, 4)):
+            v = [a, b, c]
+            v[x] = (v[x] - v[y]) & mask
+            v[x] ^= rot(v[y], k)
+            v[y] = (v[y] + v[z]) & mask
+            a, b, c = v
+        key = key[12:]
+    if not key:
+        return c & 0x7FFF
+    key = key + bytes(12 - len(key))
+    a = (a + int.from_bytes(key[0:4], 'little')) & mask
+    b = (b + int.from_bytes(key[4:8], 'little')) & mask
+    c = (c + int.from_bytes(key[8:12], 'little')) & mask
+    for x, y, k in ((2, 1, 14), (0, 2, 11), (1, 0, 25), (2, 1, 16), (0, 2, 4), (1, 0, 14), (2, 1, 24)):
+        v = [a, b, c]
+        v[x] ^= v[y]
+        v[x] = (v[x] - rot(v[y], k)) & mask
+        a, b, c = v
+    return c & 0x7FFF
+
+
+def unpack(bits, calls):
+    n = int(''.join(map(str, bits[:28])), 2)
+    m = int(''.join(map(str, bits[28:50])), 2)
+    ntype = m % 128 - 64
+    n2 = m // 128
+    if ntype >= 0 and ntype % 10 in (0, 3, 7):
+        lon, lat = divmod(n2, 180)
+        lon = 179 - lon
+        grid = '%c%c%d%d' % (65 + lon // 10, 65 + lat // 10, lon % 10, lat % 10)
+        return '%s %s %d' % (unpack_call(n).strip(), grid, ntype)
+    if ntype < 0:
+        c = unpack_call(n)
+        names = [call for call in calls if wspr_hash(call) == n2]
+        return '<%s> %s %d' % (names[0] if names else '#%d' % n2, c[5] + c[:5], -(ntype + 1))
+    nu = ntype % 10
+    nadd = nu - 3 if nu > 3 else nu
+    nadd = nadd - 4 if nu > 7 else nadd
+    affix = unpack_affix(n2 + 32768 * (nadd - 1))
+    call = unpack_call(n).strip()
+    return '%s %d' % (affix + call if affix.endswith('/') else call + affix, ntype - nadd)
+
+
+# ---- Reports ----
+
+def decode(bins, calls, args):
+    bits = fano(soft_bits(bins), max_cycles_per_bit=args.max_cycles)
+    return unpack(bits, calls) if bits else None
+
+
+def threshold(tx, t0, jitter_s, tone_err_hz, expect, calls, args, rng):
+    """Lowest SNR, in 1 dB steps down from --snr-start, with at least half of the trials decoding"""
+    bins = tone_bins(synthesize(impair(tx, jitter_s, tone_err_hz, rng), t0, NSYM * NSPS))
+    best = None
+    snr = args.snr_start
+    while snr >= args.snr_stop:
+        ok = sum(decode(add_noise(bins, snr, rng), calls, args) == expect for _ in range(args.trials))
+        if 2 * ok < args.trials:
+            break
+        best = snr
+        snr -= 1
+    return best
+
+
+def write_wav(path, tx, t0, snr_db, rng):
+    """120 s of 12000 samples per second audio with symbol 0 starting at 1 s, tones centred on 1500 Hz"""
+    iq = synthesize(impair(tx, 0.0, 0.0, rng), t0, NSYM * NSPS)
+    lead = int(FS)
+    total = int(120 * FS)
+    f_audio = 1500.0 - 1.5 * TONE_SPACING
+    noise = 1000.0 if snr_db is not None else 0.0
+    # Real noise of variance noise^2 spreads over FS / 2, the signal power is amp^2 / 2
+    amp = math.sqrt(2.0 * noise * noise * 2500.0 / (FS / 2) * 10 ** (snr_db / 10.0)) if snr_db is not None else 10000.0
+    w = cmath.exp(2j * math.pi * f_audio / FS)
+    x = 1 + 0j
+    frames = bytearray()
+    for n in range(total):
+        s = iq[n - lead] if 0 <= n - lead < len(iq) else 0j
+        v = amp * (s * x).real + (rng.gauss(0.0, noise) if noise else 0.0)
+        x *= w
+        frames += struct.pack('<h', max(-32768, min(32767, int(round(v)))))
+    with wave.open(path, 'wb') as f:
+        f.setnchannels(1)
+        f.setsampwidth(2)
+        f.setframerate(int(FS))
+        f.writeframes(bytes(frames))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Demodulate and decode WSPR from the Si5351a register writes')
+    parser.add_argument('log', help='orion_host_sim trace with the i2c register writes')
+    parser.add_argument('--clk', type=int, default=0, help='TX clock, SI5351A_WSPRTX_CLK_NUM (default 0)')
+    parser.add_argument('--xtal', type=float, default=25e6, help='Si5351a crystal in Hz (default 25 MHz)')
+    parser.add_argument('--addr', type=lambda s: int(s, 0), default=0x60, help='Si5351a I2C address (default 0x60)')
+    parser.add_argument('--tx', type=int, default=0, help='Transmission to decode, 0 for the first (default 0)')
+    parser.add_argument('--expect', help='Expected message, e.g. "VE3WMB FN25 13" or "<VE3WMB> FN25DI 7"')
+    parser.add_argument('--call', action='append', default=[], help='Callsign to resolve Type 3 hashes')
+    parser.add_argument('--jitter-ms', type=float, nargs='*', default=[], help='Timing jitter (1 sigma) to sweep')
+    parser.add_argument('--tone-err-hz', type=float, nargs='*', default=[0.0], help='Tone spacing errors to sweep')
+    parser.add_argument('--trials', type=int, default=8, help='Noisy decodes per SNR step (default 8)')
+    parser.add_argument('--snr-start', type=float, default=-20.0, help='Highest SNR of the sweep in dB (default -20)')
+    parser.add_argument('--snr-stop', type=float, default=-36.0, help='Lowest SNR of the sweep in dB (default -36)')
+    parser.add_argument('--max-cycles', type=int, default=1000, help='Fano decoder cycles per bit (default 1000)')
+    parser.add_argument('--seed', type=int, default=1, help='Seed of the jitter and noise')
+    parser.add_argument('--wav', help='Write the transmission as 12 kHz audio for wsprd')
+    parser.add_argument('--wav-snr', type=float, help='SNR in 2500 Hz of the audio (default no noise)')
+    args = parser.parse_args()
+    rng = random.Random(args.seed)
+
+    txs = read_transmissions(args.log, args.clk, args.xtal, args.addr)
+    if args.tx >= len(txs):
+        print('Found %d transmissions on CLK%d, no transmission %d' % (len(txs), args.clk, args.tx))
+        return 1
+    tx = txs[args.tx]
+    calls = args.call + ([args.expect.split()[0].strip('<>')] if args.expect else [])
+
+    # Symbol 0 starts at the first tone change after the clock is turned on at tone 0, the first sync bit is a 1
+    t0 = tx[1][0]
+    tones = sorted(set(round(f - tx[0][1], 3) for _, f in tx if f is not None))
+    print('Transmission %d on CLK%d : on at %.6f s, %.3f s long, tone 0 at %.3f Hz' %
+          (args.tx, args.clk, tx[0][0], tx[-1][0] - t0, tx[0][1]))
+    print('Tones (Hz from tone 0)   : %s' % ' '.join('%.3f' % f for f in tones))
+    print('Mean symbol period       : %.6f s (WSPR %.6f s)' % ((tx[-1][0] - t0) / NSYM, SYMBOL_S))
+
+    msg = decode(tone_bins(synthesize(impair(tx, 0.0, 0.0, rng), t0, NSYM * NSPS)), calls, args)
+    print('Decoded                  : %s' % (msg if msg else 'nothing'))
+    failed = msg is None or (args.expect is not None and msg != args.expect)
+    if args.expect is not None:
+        print('Expected                 : %s  %s' % (args.expect, 'FAIL' if failed else 'PASS'))
+
+    if args.wav:
+        write_wav(args.wav, tx, t0, args.wav_snr, rng)
+        print('Wrote %s' % args.wav)
+
+    if args.jitter_ms and msg:
+        print()
+        print('Decode threshold in dB SNR (2500 Hz), %d trials per step, and margin lost to the impairments' % args.trials)
+        print('jitter ms \\ tone err Hz ' + ''.join('%14.3f' % e for e in args.tone_err_hz))
+        base = None
+        for j in args.jitter_ms:
+            row = []
+            for e in args.tone_err_hz:
+                th = threshold(tx, t0, j / 1000.0, e, msg, calls, args, rng)
+                if base is None:
+                    base = th
+                if th is None:
+                    row.append('%14s' % 'no decode')
+                else:
+                    row.append('%8.0f (%+3.0f)' % (th, (th - base) if base is not None else 0))
+            print('%22.1f ' % j + ''.join(row))
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
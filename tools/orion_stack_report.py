@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""
+orion_stack_report.py - Static worst case stack depth report for the Orion WSPR Beacon
+
+This complements the run-time stack high-water-mark ('p' command in the Orion Serial Monitor)
+by walking the call graph of the compiled firmware and adding up the stack frame of each function.
+
+Usage:
+  1) Build with per function stack usage enabled. For the Arduino IDE create a platform.local.txt
+     next to the AVR platform.txt containing :
+        compiler.c.extra_flags=-fstack-usage
+        compiler.cpp.extra_flags=-fstack-usage
+     and turn on verbose compile output to find the build directory.
+
+  2) Disassemble the ELF file with demangled names :
+        avr-objdump -d -C OrionWspr.ino.elf > orion.dis
+
+  3) Run this script :
+        python3 orion_stack_report.py --su-dir <build directory> --dis orion.dis
+
+The report lists the worst case stack depth of the main call paths (setup(), loop() and the
+functions that do the heavy lifting for each action) and of every interrupt handler. Because
+interrupts don't nest on the AVR, the worst case for the whole program is the deepest path from
+main() plus the deepest interrupt handler.
+
+Limitations : indirect calls (icall) are reported but can't be followed, and recursion is reported
+rather than followed. Both make the figure for the affected path a lower bound.
+
+Copyright (C) 2018-2019 Michael Babineau <mbabineau.ve3wmb@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+"""
+import argparse
+import os
+import re
+import sys
+
+CALL_RETURN_BYTES = 2        # Return address pushed by call/rcall on the ATmega328p
+ISR_ENTRY_BYTES = 2          # Return address pushed on interrupt entry
+
+# Functions that are reported in addition to setup(), loop() and the interrupt handlers
+MAIN_PATHS = [
+    'setup', 'loop', 'process_orion_sm_action', 'encode_and_tx_wspr_msg', 'prepare_telemetry',
+    'get_gps_fix_and_time', 'do_calibration', 'qrss_beacon', 'serial_monitor_interface',
+    'si5351bx_setfreq', 'wspr_encode', 'read_DS1820_temperature',
+]
+
+LABEL_RE = re.compile(r'^[0-9a-f]+ <(.+)>:$')
+CALL_RE = re.compile(r'\s(r?call|r?jmp)\s.*;\s*0x[0-9a-f]+ <(.+?)(\+0x[0-9a-f]+)?>')
+ICALL_RE = re.compile(r'\s(e?icall|e?ijmp)\b')
+
+
+def base_name(name):
+    """Reduce a (demangled) function signature to its qualified name, without return type or arguments"""
+    name = name.split('(')[0].strip()
+    return name.split(' ')[-1]
+
+
+def read_stack_usage(su_dir):
+    """Read all of the GCC .su files, returning a dict of function name to frame size in bytes"""
+    frames = {}
+    for root, _, files in os.walk(su_dir):
+        for f in files:
+            if not f.endswith('.su'):
+                continue
+            with open(os.path.join(root, f)) as su:
+                for line in su:
+                    fields = line.rstrip('\n').split('\t')
+                    if len(fields) < 2:
+                        continue
+                    name = base_name(fields[0].split(':', 3)[-1])
+                    frames[name] = max(frames.get(name, 0), int(fields[1]))
+    return frames
+
+
+def read_call_graph(dis_file):
+    """Build the call graph from avr-objdump -d -C output"""
+    calls = {}
+    indirect = set()
+    current = None
+    with open(dis_file) as dis:
+        for line in dis:
+            line = line.rstrip('\n')
+            m = LABEL_RE.match(line)
+            if m:
+                current = base_name(m.group(1))
+                calls.setdefault(current, set())
+                continue
+            if current is None:
+                continue
+            m = CALL_RE.search(line)
+            if m:
+                target = base_name(m.group(2))
+                is_jump = m.group(1).endswith('jmp')
+                # A jump into the middle of a function (or within itself) is a branch, not a (tail) call
+                if target != current and not (is_jump and m.group(3)):
+                    calls[current].add(target)
+                continue
+            if ICALL_RE.search(line):
+                indirect.add(current)
+    return calls, indirect
+
+
+class StackAnalyzer:
+    def __init__(self, frames, calls, indirect):
+        self.frames = frames
+        self.calls = calls
+        self.indirect = indirect
+        self.memo = {}
+
+    def worst(self, func, stack=()):
+        """Return (depth in bytes, worst path, notes) for func"""
+        if func in self.memo:
+            return self.memo[func]
+        if func in stack:
+            return 0, [func + ' (recursive)'], {'recursion'}
+
+        notes = set()
+        if func not in self.frames:
+            notes.add('no .su data for ' + func)
+        if func in self.indirect:
+            notes.add('indirect call in ' + func)
+
+        best_depth, best_path = 0, []
+        for callee in sorted(self.calls.get(func, ())):
+            depth, path, callee_notes = self.worst(callee, stack + (func,))
+            notes |= callee_notes
+            depth += CALL_RETURN_BYTES
+            if depth > best_depth:
+                best_depth, best_path = depth, path
+
+        result = (self.frames.get(func, 0) + best_depth, [func] + best_path, notes)
+        if 'recursion' not in notes:
+            self.memo[func] = result
+        return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Static worst case stack depth report for Orion')
+    parser.add_argument('--su-dir', required=True, help='Build directory containing the GCC .su files')
+    parser.add_argument('--dis', required=True, help='Output of avr-objdump -d -C for the firmware ELF file')
+    parser.add_argument('--verbose', action='store_true', help='Show the complete worst case call path')
+    args = parser.parse_args()
+
+    frames = read_stack_usage(args.su_dir)
+    calls, indirect = read_call_graph(args.dis)
+    analyzer = StackAnalyzer(frames, calls, indirect)
+
+    def report(func, extra=0):
+        depth, path, notes = analyzer.worst(func)
+        depth += extra
+        print('%-34s %5d bytes  %s' % (func, depth, ' -> '.join(path) if args.verbose else path[-1]))
+        for note in sorted(notes):
+            print('%-34s        note: %s' % ('', note))
+        return depth
+
+    print('Main call paths (bytes include return addresses, deepest function shown)')
+    print('-' * 80)
+    for func in MAIN_PATHS:
+        if func in calls:
+            report(func)
+
+    print()
+    print('Interrupt handlers')
+    print('-' * 80)
+    worst_isr = 0
+    for func in sorted(f for f in calls if f.startswith('__vector_')):
+        worst_isr = max(worst_isr, report(func, ISR_ENTRY_BYTES))
+
+    print()
+    if 'main' in calls:
+        main_depth = analyzer.worst('main')[0]
+        print('Worst case main() %d + interrupt %d = %d bytes' % (main_depth, worst_isr, main_depth + worst_isr))
+    else:
+        print('main() not found in the disassembly', file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()